@@ -134,8 +134,8 @@ inline bool axisTestX2(float a, float b, float fa, float fb, const glm::vec3& v0
 inline bool axisTestY02(float a, float b, float fa, float fb, const glm::vec3& v0, const glm::vec3& v2,
 	const glm::vec3& boxhalfsize)
 {
-	float p0 = -a * v0.x - b * v0.z;
-	float p2 = -a * v2.x - b * v2.z;
+	float p0 = -a * v0.x + b * v0.z;
+	float p2 = -a * v2.x + b * v2.z;
 	float min, max;
 	if (p0 < p2)
 	{
@@ -157,8 +157,8 @@ inline bool axisTestY02(float a, float b, float fa, float fb, const glm::vec3& v
 inline bool axisTestY1(float a, float b, float fa, float fb, const glm::vec3& v0, const glm::vec3& v1,
 	const glm::vec3& boxhalfsize)
 {
-	float p0 = -a * v0.x - b * v0.z;
-	float p1 = -a * v1.x - b * v1.z;
+	float p0 = -a * v0.x + b * v0.z;
+	float p1 = -a * v1.x + b * v1.z;
 	float min, max;
 	if (p0 < p1)
 	{
@@ -282,7 +282,7 @@ bool triBoxOverlap(glm::vec3 boxcenter, glm::vec3 boxhalfsize, glm::vec3 trivert
 		return false;
 	if (!axisTestY1(e2.z, e2.x, fez, fex, v0, v1, boxhalfsize))
 		return false;
-	if (!axisTestZ12(e2.y, e2.z, fey, fex, v1, v2, boxhalfsize))
+	if (!axisTestZ12(e2.y, e2.x, fey, fex, v1, v2, boxhalfsize))
 		return false;
 
 	/* Bullet 1: */
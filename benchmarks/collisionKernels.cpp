@@ -0,0 +1,334 @@
+//-------------------------------------------------------------------------------------
+// Google Benchmark suite for the collision kernels, each one measured on its own:
+// RayUtil::MTRayCheck, RayUtil::basicRayCheck, triBoxOverlap, TriangleOctantIntersection
+// and satTest. Every kernel runs over the same kinds of input:
+//   hit_heavy  - almost every test succeeds
+//   miss_heavy - almost every test fails, mostly on the early outs
+//   degenerate - zero area triangles and rays parallel to the triangle plane
+//   mesh       - triangles of a tessellated, slightly bumpy plane (like the targets),
+//                tested the way the simulation does (rays along the projectile path,
+//                boxes of a 8x8x8 leaf grid)
+// Inputs are generated from a fixed seed, so runs are comparable between machines.
+// Reports the time per test and tests per second (items_per_second) plus the ratio of tests that hit.
+// No GL context is created, the meshes stay CPU only, so it runs on machines without a GPU.
+// Build it as its own executable from this file, linked against Google Benchmark (and glad,
+// which the renderer parts of the included headers reference).
+//-------------------------------------------------------------------------------------
+
+#include<benchmark/benchmark.h>
+#include<glm\glm.hpp>
+
+#include<vector>
+#include<random>
+#include "../rayUtil.h"
+#include "../triangleOctree.h"
+
+enum Distribution
+{
+	HitHeavy,
+	MissHeavy,
+	Degenerate,
+	MeshGrid
+};
+
+const int caseCount = 4096; //tests per benchmark iteration
+
+struct RayCase
+{
+	glm::vec3 v0, v1, v2;
+	glm::vec3 rayOrigin, rayDir;
+};
+
+struct BoxCase
+{
+	glm::vec3 verts[3];
+	glm::vec3 boxCenter;
+	float halfSize;
+};
+
+glm::vec3 RandomPoint(std::mt19937& random, float extent)
+{
+	std::uniform_real_distribution<float> coord(-extent, extent);
+	return glm::vec3(coord(random), coord(random), coord(random));
+}
+
+glm::vec3 RandomDirection(std::mt19937& random)
+{
+	glm::vec3 direction;
+	do
+	{
+		direction = RandomPoint(random, 1.0f);
+	} while (glm::dot(direction, direction) < 0.01f || glm::dot(direction, direction) > 1.0f);
+	return glm::normalize(direction);
+}
+
+//Triangles of a size x size grid on the XZ plane, with a bit of height noise
+std::vector<glm::vec3> GridTriangles(std::mt19937& random, int size)
+{
+	std::uniform_real_distribution<float> height(-0.02f, 0.02f);
+	std::vector<glm::vec3> points((size + 1) * (size + 1));
+	for (int z = 0; z <= size; z++)
+		for (int x = 0; x <= size; x++)
+			points[z * (size + 1) + x] = glm::vec3(2.0f * x / size - 1.0f, height(random), 2.0f * z / size - 1.0f);
+
+	std::vector<glm::vec3> triangles;
+	for (int z = 0; z < size; z++)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			glm::vec3 p00 = points[z * (size + 1) + x], p10 = points[z * (size + 1) + x + 1];
+			glm::vec3 p01 = points[(z + 1) * (size + 1) + x], p11 = points[(z + 1) * (size + 1) + x + 1];
+			//counter clockwise seen from above, so rays going down hit the front face
+			triangles.insert(triangles.end(), { p00, p01, p10 });
+			triangles.insert(triangles.end(), { p10, p01, p11 });
+		}
+	}
+	return triangles;
+}
+
+//One ray and triangle of the distribution
+RayCase RandomRayCase(Distribution distribution, std::mt19937& random, const std::vector<glm::vec3>& grid)
+{
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	RayCase c;
+	if (distribution == MeshGrid)
+	{
+		//straight down from the projectile's side, against a triangle of the same 8x8 leaf cell,
+		//the same as the rays cast every step (most of the leaf's triangles miss)
+		int tri = std::uniform_int_distribution<int>(0, (int)grid.size() / 3 - 1)(random);
+		c.v0 = grid[tri * 3];
+		c.v1 = grid[tri * 3 + 1];
+		c.v2 = grid[tri * 3 + 2];
+		glm::vec3 centroid = (c.v0 + c.v1 + c.v2) / 3.0f;
+		glm::vec3 cellCorner = glm::vec3(floorf((centroid.x + 1.0f) * 4.0f), 0.0f, floorf((centroid.z + 1.0f) * 4.0f)) * 0.25f - glm::vec3(1.0f, 0.0f, 1.0f);
+		c.rayOrigin = cellCorner + glm::vec3(unit(random) * 0.25f, 1.0f, unit(random) * 0.25f);
+		c.rayDir = glm::vec3(0.0f, -1.0f, 0.0f);
+		return c;
+	}
+
+	c.v0 = RandomPoint(random, 1.0f);
+	c.v1 = RandomPoint(random, 1.0f);
+	c.v2 = RandomPoint(random, 1.0f);
+	c.rayDir = RandomDirection(random);
+	if (distribution == Degenerate)
+	{
+		if (unit(random) < 0.5f) //collinear vertices
+			c.v2 = c.v0 + unit(random) * (c.v1 - c.v0);
+		else //ray in the plane of the triangle
+			c.rayDir = glm::normalize((c.v1 - c.v0) + unit(random) * (c.v2 - c.v1));
+		c.rayOrigin = (c.v0 + c.v1 + c.v2) / 3.0f - c.rayDir;
+		return c;
+	}
+
+	//both kernels only accept front faces
+	if (glm::dot(glm::cross(c.v1 - c.v0, c.v2 - c.v0), c.rayDir) > 0.0f)
+		std::swap(c.v1, c.v2);
+	float u = unit(random), v = unit(random);
+	if (distribution == HitHeavy && u + v > 1.0f)
+	{
+		u = 1.0f - u;
+		v = 1.0f - v;
+	}
+	else if (distribution == MissHeavy)
+	{
+		//aim outside of the triangle
+		u += 1.0f;
+		v += 0.5f;
+	}
+	glm::vec3 target = c.v0 + u * (c.v1 - c.v0) + v * (c.v2 - c.v0);
+	c.rayOrigin = target - (0.5f + unit(random)) * c.rayDir;
+	return c;
+}
+
+//The kernels don't agree on every ray aimed inside a triangle (basicRayCheck measures the plane's distance with the
+//wrong sign, only planes through the origin come out right), so hit_heavy keeps the rays the measured kernel hits
+template<typename RayKernel>
+std::vector<RayCase> MakeRayCases(Distribution distribution, const RayKernel& kernel)
+{
+	std::mt19937 random(1234);
+	std::vector<glm::vec3> grid = GridTriangles(random, 64);
+
+	std::vector<RayCase> cases(caseCount);
+	for (RayCase& c : cases)
+	{
+		c = RandomRayCase(distribution, random, grid);
+		for (int tries = 1; distribution == HitHeavy && !kernel(c) && tries < 256; tries++)
+			c = RandomRayCase(distribution, random, grid);
+	}
+	return cases;
+}
+
+std::vector<BoxCase> MakeBoxCases(Distribution distribution)
+{
+	std::mt19937 random(4321);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<glm::vec3> grid = GridTriangles(random, 64);
+
+	std::vector<BoxCase> cases(caseCount);
+	for (BoxCase& c : cases)
+	{
+		if (distribution == MeshGrid)
+		{
+			//a random leaf of a depth 3 octree around the grid against a random triangle
+			int tri = std::uniform_int_distribution<int>(0, (int)grid.size() / 3 - 1)(random);
+			std::uniform_int_distribution<int> cell(0, 7);
+			c.verts[0] = grid[tri * 3];
+			c.verts[1] = grid[tri * 3 + 1];
+			c.verts[2] = grid[tri * 3 + 2];
+			c.halfSize = 0.125f;
+			c.boxCenter = glm::vec3(cell(random), cell(random), cell(random)) * 0.25f - glm::vec3(0.875f);
+			continue;
+		}
+
+		c.verts[0] = RandomPoint(random, 1.0f);
+		c.verts[1] = RandomPoint(random, 1.0f);
+		c.verts[2] = RandomPoint(random, 1.0f);
+		if (distribution == Degenerate)
+			c.verts[2] = c.verts[0] + unit(random) * (c.verts[1] - c.verts[0]);
+		c.halfSize = 0.1f + 0.4f * unit(random);
+		c.boxCenter = (c.verts[0] + c.verts[1] + c.verts[2]) / 3.0f;
+		if (distribution == MissHeavy) //far enough that no axis overlaps
+			c.boxCenter += RandomDirection(random) * 4.0f;
+	}
+	return cases;
+}
+
+//CPU only model holding every triangle of the cases separately, the Triangle indices go through the index buffer
+Model MakeBoxCaseModel(const std::vector<BoxCase>& cases, std::vector<Triangle>& tris)
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	for (const BoxCase& c : cases)
+	{
+		int first = (int)vertices.size();
+		for (int i = 0; i < 3; i++)
+		{
+			Vertex vertex = {};
+			vertex.Position = c.verts[i];
+			vertices.push_back(vertex);
+			indices.push_back(first + i);
+		}
+		tris.push_back(Triangle(first, first + 1, first + 2));
+	}
+	std::vector<Mesh> meshes;
+	meshes.push_back(Mesh(std::move(vertices), std::move(indices), std::vector<Texture>(), false, false));
+	return Model(std::move(meshes));
+}
+
+void ReportThroughput(benchmark::State& state, long long hits)
+{
+	long long tests = (long long)state.iterations() * caseCount;
+	state.SetItemsProcessed(tests);
+	state.counters["time/test"] = benchmark::Counter((double)tests, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+	state.counters["hit ratio"] = benchmark::Counter((double)hits / tests);
+}
+
+void BM_MTRayCheck(benchmark::State& state, Distribution distribution)
+{
+	std::vector<RayCase> cases = MakeRayCases(distribution, [](const RayCase& c)
+	{
+		float t = 0.0f;
+		return RayUtil::MTRayCheck(c.v0, c.v1, c.v2, c.rayOrigin, c.rayDir, t);
+	});
+	long long hits = 0;
+	for (auto _ : state)
+	{
+		for (const RayCase& c : cases)
+		{
+			float t = 0.0f;
+			bool hit = RayUtil::MTRayCheck(c.v0, c.v1, c.v2, c.rayOrigin, c.rayDir, t);
+			benchmark::DoNotOptimize(t);
+			hits += hit;
+		}
+	}
+	ReportThroughput(state, hits);
+}
+
+void BM_basicRayCheck(benchmark::State& state, Distribution distribution)
+{
+	std::vector<RayCase> cases = MakeRayCases(distribution, [](const RayCase& c)
+	{
+		return RayUtil::basicRayCheck(c.v0, c.v1, c.v2, c.rayOrigin, c.rayDir);
+	});
+	long long hits = 0;
+	for (auto _ : state)
+	{
+		for (const RayCase& c : cases)
+		{
+			bool hit = RayUtil::basicRayCheck(c.v0, c.v1, c.v2, c.rayOrigin, c.rayDir);
+			benchmark::DoNotOptimize(hit);
+			hits += hit;
+		}
+	}
+	ReportThroughput(state, hits);
+}
+
+void BM_triBoxOverlap(benchmark::State& state, Distribution distribution)
+{
+	std::vector<BoxCase> cases = MakeBoxCases(distribution);
+	long long hits = 0;
+	for (auto _ : state)
+	{
+		for (BoxCase& c : cases)
+		{
+			bool hit = triBoxOverlap(c.boxCenter, glm::vec3(c.halfSize), c.verts);
+			benchmark::DoNotOptimize(hit);
+			hits += hit;
+		}
+	}
+	ReportThroughput(state, hits);
+}
+
+void BM_TriangleOctantIntersection(benchmark::State& state, Distribution distribution)
+{
+	std::vector<BoxCase> cases = MakeBoxCases(distribution);
+	std::vector<Triangle> tris;
+	Model model = MakeBoxCaseModel(cases, tris);
+	long long hits = 0;
+	for (auto _ : state)
+	{
+		for (int i = 0; i < caseCount; i++)
+		{
+			bool hit = TriangleOctantIntersection(model, cases[i].halfSize * 2.0f, cases[i].boxCenter, tris[i]);
+			benchmark::DoNotOptimize(hit);
+			hits += hit;
+		}
+	}
+	ReportThroughput(state, hits);
+}
+
+//One separating axis per test, the edge x X axis one TriangleOctantIntersection starts with
+void BM_satTest(benchmark::State& state, Distribution distribution)
+{
+	std::vector<BoxCase> cases = MakeBoxCases(distribution);
+	glm::vec3 norm1(1.0f, 0.0f, 0.0f), norm2(0.0f, 1.0f, 0.0f), norm3(0.0f, 0.0f, 1.0f);
+	std::vector<glm::vec3> axes;
+	for (const BoxCase& c : cases)
+		axes.push_back(glm::cross(norm1, c.verts[1] - c.verts[0]));
+	long long hits = 0;
+	for (auto _ : state)
+	{
+		for (int i = 0; i < caseCount; i++)
+		{
+			const BoxCase& c = cases[i];
+			bool hit = satTest(c.verts[0] - c.boxCenter, c.verts[1] - c.boxCenter, c.verts[2] - c.boxCenter, axes[i], c.halfSize, norm1, norm2, norm3);
+			benchmark::DoNotOptimize(hit);
+			hits += hit;
+		}
+	}
+	ReportThroughput(state, hits);
+}
+
+#define COLLISION_BENCHMARK(kernel) \
+	BENCHMARK_CAPTURE(kernel, hit_heavy, HitHeavy); \
+	BENCHMARK_CAPTURE(kernel, miss_heavy, MissHeavy); \
+	BENCHMARK_CAPTURE(kernel, degenerate, Degenerate); \
+	BENCHMARK_CAPTURE(kernel, mesh, MeshGrid)
+
+COLLISION_BENCHMARK(BM_MTRayCheck);
+COLLISION_BENCHMARK(BM_basicRayCheck);
+COLLISION_BENCHMARK(BM_triBoxOverlap);
+COLLISION_BENCHMARK(BM_TriangleOctantIntersection);
+COLLISION_BENCHMARK(BM_satTest);
+
+BENCHMARK_MAIN();
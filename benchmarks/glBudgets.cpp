@@ -0,0 +1,213 @@
+//-------------------------------------------------------------------------------------
+// Headless check of the GL work the per frame paths do, run through the recording GL
+// backend (glRecorder.h) without a window or context. Every path has a budget of draws,
+// uploads and created objects per frame, a path that goes over it fails the check:
+//   debug lines   DebugLines::Flush draws every ray of a frame in one draw, with at most
+//                 two uploads (orphaning the buffer and the data), and creates no buffers
+//                 or vertex arrays after the first frame
+//   text          Text::renderText draws a string in one draw, a string drawn the frame
+//                 before needs no uploads, and the glyph atlas is the only texture,
+//                 uploaded once at setup
+//   target upload SimThread::Consume uploads one position (12 bytes) per vertex moved
+//                 since the snapshot the renderer took before, and never draws. After the
+//                 run the target's buffer holds the simulated positions. Run once more on
+//                 a target refined under the impact, whose new vertices sit at the end of
+//                 the buffer, far from the ones they were split from
+// Catches changes that quietly go back to a draw or buffer per ray, re-uploading text
+// or uploading the whole target every frame.
+//
+// Usage: glBudgets [assets directory]
+// The directory holds the shaders and arial.ttf, ../OpenGL_DeformProj/ by default like
+// the app. Exits with 1 if any budget is exceeded.
+// Build it as its own executable from this file, linked against glad and FreeType.
+//-------------------------------------------------------------------------------------
+
+#include "../glRecorder.h"
+
+#include<glm\glm.hpp>
+
+#include<iostream>
+#include<string>
+#include<vector>
+#include<set>
+#include<thread>
+#include<chrono>
+#include<string.h>
+#include "../proceduralMesh.h"
+#include "../optimalTarget.h"
+#include "../optimalProjectile.h"
+#include "../triangleOctree.h"
+#include "../simThread.h"
+#include "../debugLines.h"
+#include "../textRendering.h"
+#include "../shader.h"
+#include "../jobSystem.h"
+#include "../logger.h"
+
+const int frames = 4;
+const int raysPerFrame = 137; //as many as the sphere projectile of the app spawns
+const float stepSize = 0.0167f;
+
+int failures = 0;
+
+void Check(bool withinBudget, const std::string& what)
+{
+	std::cout << (withinBudget ? "  ok    " : "  OVER  ") << what << std::endl;
+	if (!withinBudget)
+		failures++;
+}
+
+std::string Counts(GLRecorder& recorder)
+{
+	return std::to_string(recorder.DrawCalls()) + " draws, " + std::to_string(recorder.UploadCalls()) + " uploads (" +
+		std::to_string(recorder.UploadBytes()) + " bytes)";
+}
+
+void CheckDebugLines(const std::string& assets)
+{
+	std::cout << "debug lines, " << raysPerFrame << " rays a frame" << std::endl;
+	GLRecorder& recorder = GLRecorder::Get();
+	Shader rayShader((assets + "ray.vert").c_str(), (assets + "ray.frag").c_str());
+	DebugLines lines;
+	glm::mat4 model = glm::mat4(1.0f);
+	for (int frame = 0; frame < frames; frame++)
+	{
+		recorder.Reset();
+		for (int i = 0; i < raysPerFrame; i++)
+			lines.AddRay(glm::vec3(0.01f * i, 1.0f, 0.0f), glm::vec3(0.0f, -1000000.0f, 0.0f), model);
+		lines.Flush(rayShader, model, model);
+		std::string frameName = "frame " + std::to_string(frame) + ": " + Counts(recorder);
+		Check(recorder.DrawCalls() == 1 && recorder.UploadCalls() <= 2, frameName);
+		if (frame > 0)
+			Check(recorder.Stats("glGenBuffers").calls == 0 && recorder.Stats("glGenVertexArrays").calls == 0,
+				"frame " + std::to_string(frame) + ": no buffers or vertex arrays created");
+	}
+}
+
+void CheckText(const std::string& assets)
+{
+	std::cout << "text" << std::endl;
+	GLRecorder& recorder = GLRecorder::Get();
+	recorder.Reset();
+	Text text((assets + "arial.ttf").c_str(), 0, 24, glm::vec3(1.0f));
+	Shader textShader((assets + "textShader.vert").c_str(), (assets + "textShader.frag").c_str());
+	Check(recorder.Stats("glGenTextures").calls == 1, "setup: " + std::to_string(recorder.Stats("glGenTextures").calls) +
+		" textures, " + std::to_string(recorder.Stats("glTexImage2D").bytes) + " texture bytes");
+
+	glm::mat4 projection = glm::mat4(1.0f);
+	for (int frame = 0; frame < frames; frame++)
+	{
+		recorder.Reset();
+		text.renderText(textShader, "FPS: 60", 0.0f, 576.0f, 1.0f, projection);
+		text.renderText(textShader, "Collision: true", 0.0f, 552.0f, 1.0f, projection);
+		std::string frameName = "frame " + std::to_string(frame) + ", two strings: " + Counts(recorder);
+		Check(recorder.DrawCalls() == 2 && (frame == 0 || recorder.UploadCalls() == 0), frameName);
+		Check(recorder.Stats("glTexImage2D").calls == 0 && recorder.Stats("glTexSubImage2D").calls == 0,
+			"frame " + std::to_string(frame) + ": no texture uploads");
+	}
+}
+
+void CheckSimUpload(bool refine)
+{
+	std::cout << "target upload" << (refine ? ", refined under the impact" : "") << std::endl;
+	GLRecorder& recorder = GLRecorder::Get();
+	OctreeTarget target(ProceduralMesh::Plane(40, 2.0f), 0.5f, 3.0f, 0.0f);
+	Mesh& targetMesh = target.targetModel.meshes[0];
+	int firstNewVertex = (int)targetMesh.vertices.size();
+	Model projectileModel = ProceduralMesh::Sphere(8, 16, 0.15f, false);
+	for (Vertex& vertex : projectileModel.meshes[0].vertices)
+		vertex.Position += glm::vec3(0.013f, 0.2f, 0.007f);
+	OctreeProjectile projectile(std::move(projectileModel), glm::vec3(0.0f, -0.03f, 0.0f));
+	Octree targetTree(target.targetModel, target.boundingBoxSize * 0.5f, 3, 3, 3, target.boundingBoxSize, target.boundingBoxCenter + glm::vec3(0, 0.001f, 0));
+	target.SetupTree(targetTree);
+	Octree projectileTree(projectile.projectileMesh, projectile.boundingBoxSize * 0.5f, 3, 3, 3, projectile.boundingBoxSize,
+		projectile.boundingBoxCenter + glm::vec3(0, 0.001f, 0));
+	projectile.SetupTree(projectileTree);
+	if (refine)
+		target.RefineAround(targetTree, glm::vec3(0.013f, 0.0f, 0.007f), 0.4f, 0.02f, 4000);
+
+	std::vector<glm::vec3> spawnPositions;
+	for (const Vertex& vertex : targetMesh.vertices)
+		spawnPositions.push_back(vertex.Position);
+
+	//the simulation runs in real time on its own thread, the render thread consumes at about twice the step rate
+	int frame = 0, overruns = 0, worstUploads = 0;
+	long long uploadedBytes = 0, rangeBytes = 0; //uploaded, and what one range over the moved vertices would have been
+	std::set<int> uploaded;
+	{
+		SimThread simThread(projectile, target, targetTree, projectileTree, stepSize, 8);
+		unsigned long long seenSequence = 0;
+		simThread.Start();
+		for (; frame < 2000; frame++)
+		{
+			recorder.Reset();
+			const SimSnapshot& snapshot = simThread.Consume(targetMesh);
+			bool isNew = snapshot.sequence != seenSequence;
+			seenSequence = snapshot.sequence;
+			size_t budget = isNew ? snapshot.movedVerts.size() : 0;
+			bool withinBudget = recorder.DrawCalls() == 0 && recorder.UploadCalls() <= (long long)budget &&
+				recorder.UploadBytes() == recorder.UploadCalls() * (long long)sizeof(glm::vec3);
+			if (!withinBudget)
+			{
+				if (overruns == 0)
+					Check(false, "frame " + std::to_string(frame) + ": " + Counts(recorder) + " for " + std::to_string(budget) + " moved vertices");
+				overruns++;
+			}
+			if (isNew && !snapshot.movedVerts.empty())
+			{
+				uploaded.insert(snapshot.movedVerts.begin(), snapshot.movedVerts.end());
+				rangeBytes += (long long)(snapshot.movedVerts.back() - snapshot.movedVerts.front() + 1) * sizeof(Vertex);
+			}
+			worstUploads = max(worstUploads, (int)recorder.UploadCalls());
+			uploadedBytes += recorder.UploadBytes();
+			if (snapshot.isDone)
+				break;
+			std::this_thread::sleep_for(std::chrono::duration<double>(stepSize * 0.5));
+		}
+	}
+	Check(overruns == 0, std::to_string(frame) + " frames, " + std::to_string(overruns) + " over budget, at most " + std::to_string(worstUploads) +
+		" uploads a frame (" + std::to_string(uploaded.size()) + " vertices moved in the run, " + std::to_string(targetMesh.vertices.size()) + " in the target)");
+	Check(!uploaded.empty(), "the projectile dented the target");
+	if (refine)
+	{
+		//the dent moves old and new vertices together, one range over them would span most of the buffer every frame
+		bool reachedNew = !uploaded.empty() && *uploaded.rbegin() >= firstNewVertex && *uploaded.begin() < firstNewVertex;
+		Check(reachedNew && uploadedBytes * 4 < rangeBytes, std::to_string(targetMesh.vertices.size() - firstNewVertex) + " vertices added, " +
+			std::to_string(uploadedBytes) + " bytes uploaded in the run, " + std::to_string(rangeBytes) + " as ranges of whole vertices");
+	}
+
+	//every vertex has to end up where the simulation left it, and only the ones that moved were uploaded
+	const std::vector<unsigned char>* contents = recorder.BufferContents(targetMesh.VertexBuffer());
+	int wrong = 0, stayedPut = 0;
+	for (int i = 0; contents != nullptr && i < targetMesh.vertices.size(); i++)
+	{
+		glm::vec3 position;
+		memcpy(&position, &(*contents)[i * sizeof(Vertex) + offsetof(Vertex, Position)], sizeof(glm::vec3));
+		if (position != targetMesh.vertices[i].Position)
+			wrong++;
+	}
+	for (int vert : uploaded)
+	{
+		if (targetMesh.vertices[vert].Position == spawnPositions[vert])
+			stayedPut++;
+	}
+	Check(contents != nullptr && wrong == 0, "buffer matches the simulated target, " + std::to_string(wrong) + " vertices off");
+	Check(stayedPut == 0, std::to_string(stayedPut) + " uploaded vertices that never moved");
+}
+
+int main(int argc, char** argv)
+{
+	std::string assets = argc > 1 ? argv[1] : "../OpenGL_DeformProj/";
+	if (!assets.empty() && assets.back() != '/' && assets.back() != '\\')
+		assets += '/';
+	GLRecorder::Get().Install(false);
+
+	CheckDebugLines(assets);
+	CheckText(assets);
+	CheckSimUpload(false);
+	CheckSimUpload(true);
+
+	GLRecorder::Get().Uninstall();
+	std::cout << (failures == 0 ? "all within budget" : std::to_string(failures) + " over budget") << std::endl;
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,210 @@
+//-------------------------------------------------------------------------------------
+// Headless end to end benchmark of the impact simulation. Builds procedural targets
+// (tessellated planes, spheres, noisy terrain) and projectiles at a range of sizes,
+// runs the whole OctreeTarget/OctreeProjectile pipeline on each until the projectile
+// comes to rest and reports how long every phase took: octree build, ray casting,
+// falloff and vertex update. Results are written as JSON, for tracking them over time.
+// Everything stays on the CPU, no window or GL context is created.
+//
+// Usage: impactBenchmark [--sizes 1000,10000,...] [--out file.json] [--max-steps n] [--trace trace.json] [--collision packed|float]
+// Sizes are target triangle counts (the generated meshes get as close as their grid allows).
+// --collision picks where the target's ray checks and falloff read positions from, its
+// quantised collision mirror (the default, like the app) or the mesh's vertices.
+// --trace also writes the profiling zones of all runs as a Chrome trace.
+// Build it as its own executable from this file, linked against glad (which the renderer
+// parts of the included headers reference).
+//-------------------------------------------------------------------------------------
+
+#include<glm\glm.hpp>
+
+#include<iostream>
+#include<fstream>
+#include<sstream>
+#include<string>
+#include<vector>
+#include<chrono>
+#include<math.h>
+#include "../proceduralMesh.h"
+#include "../optimalTarget.h"
+#include "../optimalProjectile.h"
+#include "../triangleOctree.h"
+#include "../jobSystem.h"
+#include "../profiler.h"
+#include "../logger.h"
+
+const float stepSize = 0.0167f; //same fixed step as the interactive app
+const glm::vec3 projectileAcceleration = glm::vec3(0.0f, -0.03f, 0.0f);
+
+struct ImpactResult
+{
+	std::string target;
+	std::string projectile;
+	bool collisionMirror;
+	int targetTriangles;
+	int targetVertices;
+	int projectileTriangles;
+	int steps;
+	bool reachedRest;
+	double octreeBuild;
+	SimPhaseTimes phases;
+	double total;
+};
+
+double SecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//Targets span 2 units across, centered on the origin
+Model MakeTarget(const std::string& kind, int triangles)
+{
+	if (kind == "sphere")
+	{
+		int rings = max((int)roundf(sqrtf(triangles / 4.0f)), 2);
+		return ProceduralMesh::Sphere(rings, rings * 2, 1.0f, false);
+	}
+	int quadsPerSide = max((int)roundf(sqrtf(triangles / 2.0f)), 1);
+	if (kind == "terrain")
+		return ProceduralMesh::Terrain(quadsPerSide, 2.0f, 0.1f, 1234, false);
+	return ProceduralMesh::Plane(quadsPerSide, 2.0f, false);
+}
+
+Model MakeProjectile(const std::string& kind)
+{
+	if (kind == "sphere_fine")
+		return ProceduralMesh::Sphere(24, 48, 0.15f, false);
+	return ProceduralMesh::Sphere(8, 16, 0.15f, false);
+}
+
+ImpactResult RunImpact(const std::string& targetKind, int triangles, const std::string& projectileKind, int maxSteps, bool collisionMirror)
+{
+	ImpactResult result;
+	result.target = targetKind;
+	result.projectile = projectileKind;
+	result.collisionMirror = collisionMirror;
+	std::chrono::steady_clock::time_point runStart = std::chrono::steady_clock::now();
+
+	OctreeTarget target(MakeTarget(targetKind, triangles), 0.5f, 3.0f, 1);
+	result.targetTriangles = (int)target.targetModel.meshes[0].indices.size() / 3;
+	result.targetVertices = (int)target.targetModel.meshes[0].vertices.size();
+
+	//projectile starts just above the middle of the target
+	float targetTop = -FLT_MAX;
+	for (const Vertex& vertex : target.targetModel.meshes[0].vertices)
+		targetTop = fmaxf(targetTop, vertex.Position.y);
+	Model projectileModel = MakeProjectile(projectileKind);
+	for (Vertex& vertex : projectileModel.meshes[0].vertices)
+		vertex.Position += glm::vec3(0.0f, targetTop + 0.2f, 0.0f);
+	OctreeProjectile projectile(std::move(projectileModel), projectileAcceleration);
+	result.projectileTriangles = (int)projectile.projectileMesh.meshes[0].indices.size() / 3;
+
+	std::chrono::steady_clock::time_point buildStart = std::chrono::steady_clock::now();
+	Octree targetTree(target.targetModel, target.boundingBoxSize * 0.5f, 3, 3, 3, target.boundingBoxSize, target.boundingBoxCenter + glm::vec3(0, 0.001f, 0));
+	target.SetupTree(targetTree);
+	if (collisionMirror)
+		targetTree.BuildCollisionMirror();
+	Octree projectileTree(projectile.projectileMesh, projectile.boundingBoxSize * 0.5f, 3, 3, 3, projectile.boundingBoxSize,
+		projectile.boundingBoxCenter + glm::vec3(0, 0.001f, 0));
+	projectile.SetupTree(projectileTree);
+	result.octreeBuild = SecondsSince(buildStart);
+
+	result.steps = 0;
+	while (!projectile.isDone && result.steps < maxSteps)
+	{
+		projectile.Update(targetTree, projectileTree, target, stepSize, glm::mat4(1.0f));
+		result.steps++;
+	}
+	result.reachedRest = projectile.isDone;
+	result.phases = projectile.phaseTimes;
+	result.total = SecondsSince(runStart);
+	return result;
+}
+
+void WriteJson(std::ostream& out, const std::vector<ImpactResult>& results)
+{
+	out << "{\n  \"threads\": " << Jobs().ThreadCount() << ",\n  \"stepSize\": " << stepSize << ",\n  \"results\": [\n";
+	for (int i = 0; i < results.size(); i++)
+	{
+		const ImpactResult& r = results[i];
+		out << "    {\"target\": \"" << r.target << "\", \"projectile\": \"" << r.projectile << "\", \"collision\": \"" << (r.collisionMirror ? "packed" : "float")
+			<< "\", \"targetTriangles\": " << r.targetTriangles
+			<< ", \"targetVertices\": " << r.targetVertices << ", \"projectileTriangles\": " << r.projectileTriangles
+			<< ", \"steps\": " << r.steps << ", \"reachedRest\": " << (r.reachedRest ? "true" : "false")
+			<< ", \"seconds\": {\"octreeBuild\": " << r.octreeBuild << ", \"rayCasting\": " << r.phases.rayCasting
+			<< ", \"falloff\": " << r.phases.falloff << ", \"vertexUpdate\": " << r.phases.vertexUpdate << ", \"total\": " << r.total << "}}"
+			<< (i + 1 < results.size() ? ",\n" : "\n");
+	}
+	out << "  ]\n}\n";
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<int> sizes = { 1000, 10000, 100000, 1000000, 10000000 };
+	std::string outPath = "impact_benchmark.json";
+	int maxSteps = 10000;
+	std::string tracePath;
+	bool collisionMirror = true;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		std::string option = argv[i];
+		if (option == "--sizes")
+		{
+			sizes.clear();
+			std::stringstream list(argv[i + 1]);
+			std::string size;
+			while (std::getline(list, size, ','))
+				sizes.push_back(std::stoi(size));
+		}
+		else if (option == "--out")
+			outPath = argv[i + 1];
+		else if (option == "--max-steps")
+			maxSteps = std::stoi(argv[i + 1]);
+		else if (option == "--trace")
+			tracePath = argv[i + 1];
+		else if (option == "--collision")
+			collisionMirror = std::string(argv[i + 1]) != "float";
+		else
+		{
+			std::cout << "Unknown option " << option << "\nUsage: impactBenchmark [--sizes 1000,10000,...] [--out file.json] [--max-steps n] [--trace trace.json] [--collision packed|float]\n";
+			return 1;
+		}
+	}
+
+#if DEFORM_PROFILING
+	if (!tracePath.empty())
+		Jobs().SetTimingHook(Profiler::RecordJob);
+#endif
+
+	std::vector<ImpactResult> results;
+	const char* targets[] = { "plane", "sphere", "terrain" };
+	const char* projectiles[] = { "sphere", "sphere_fine" };
+	for (int size : sizes)
+	{
+		for (const char* targetKind : targets)
+		{
+			for (const char* projectileKind : projectiles)
+			{
+				ImpactResult result = RunImpact(targetKind, size, projectileKind, maxSteps, collisionMirror);
+				Logger::Get().Flush(); //keeps the run's own log above its summary line
+				std::cout << result.target << " (" << result.targetTriangles << " tris) <- " << result.projectile << ": " << result.steps << " steps"
+					<< (result.reachedRest ? "" : " (didn't come to rest)") << ", build " << result.octreeBuild << "s, rays " << result.phases.rayCasting
+					<< "s, falloff " << result.phases.falloff << "s, vertices " << result.phases.vertexUpdate << "s, total " << result.total << "s\n";
+				results.push_back(result);
+			}
+		}
+	}
+
+	std::ofstream out(outPath);
+	if (!out)
+	{
+		std::cout << "Couldn't open " << outPath << " for writing\n";
+		return 1;
+	}
+	WriteJson(out, results);
+	std::cout << "Results written to " << outPath << "\n";
+#if DEFORM_PROFILING
+	if (!tracePath.empty() && Profiler::Get().WriteChromeTrace(tracePath))
+		std::cout << "Trace written to " << tracePath << "\n";
+#endif
+	return 0;
+}
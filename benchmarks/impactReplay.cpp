@@ -0,0 +1,236 @@
+//-------------------------------------------------------------------------------------
+// Headless replay of a recorded impact (the app writes impact_replay.bin when a run is
+// over, see replayLog.h). Loads the same models, sets the scene up the way the app did
+// and steps the simulation as fast as the CPU allows, no real time pacing. Every step
+// runs the relaxation iterations the recording ran, with no time budget, so the result
+// doesn't depend on how fast this machine is (even if the recording had one), and its
+// hash is checked against the recorded one. The first step that differs is reported
+// and the replay counts as failed.
+// Repeating the replay gives stable timings of one fixed workload, for comparing
+// optimisations and catching regressions on exactly the same impact.
+// Everything stays on the CPU, no window or GL context is created.
+//
+// Usage: impactReplay log.bin [--repeat n] [--out file.json] [--trace trace.json]
+// Model paths in the log are relative to where the app ran, run this from the same place.
+// Out of core runs leave the chunk file as it was (the dented mesh goes into a copy next
+// to it), so they replay from the same file.
+// Exits with 1 if the log can't be replayed or the replay goes different.
+// Build it as its own executable from this file, linked against glad (which the renderer
+// parts of the included headers reference) and Assimp.
+//-------------------------------------------------------------------------------------
+
+#include<glm\glm.hpp>
+
+#include<iostream>
+#include<fstream>
+#include<string>
+#include<vector>
+#include<chrono>
+#include<float.h>
+#include<algorithm>
+#include "../model.h"
+#include "../optimalTarget.h"
+#include "../optimalProjectile.h"
+#include "../triangleOctree.h"
+#include "../replayLog.h"
+#include "../jobSystem.h"
+#include "../profiler.h"
+#include "../logger.h"
+
+struct ReplayRun
+{
+	bool setupMatches; //same geometry and ray direction as the recording
+	std::string setupMismatch;
+	int steps;
+	int firstMismatch; //step index, -1 if every step matched
+	bool reachedRest;
+	double setup; //loading the target, building the trees, refining and packing the collision mirror
+	SimPhaseTimes phases;
+	double simulation;
+};
+
+double SecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//Sets the scene up from the log's setup, in the same order as main.cpp, and replays its steps
+//The target is loaded for every run, out of core targets load the chunks the projectile can reach again
+ReplayRun Replay(const ImpactLog& log, Model projectileModel)
+{
+	const ImpactSetup& impact = log.setup;
+	ReplayRun run;
+	run.steps = 0;
+	run.firstMismatch = -1;
+	run.reachedRest = false;
+	run.simulation = 0.0;
+	std::chrono::steady_clock::time_point setupStart = std::chrono::steady_clock::now();
+
+	OctreeProjectile projectile(std::move(projectileModel), impact.acceleration);
+	Octree projectileTree(projectile.projectileMesh, projectile.boundingBoxSize * 0.5f, impact.treeMaxVerts, impact.treeMaxTris, impact.treeDepth,
+		projectile.boundingBoxSize, projectile.boundingBoxCenter + glm::vec3(0, 0.001f, 0));
+	projectile.SetupTree(projectileTree);
+	projectile.relaxSettings = impact.relaxSettings;
+	projectile.relaxSettings.timeBudget = 0.0; //the recorded iteration counts stand in for it
+	ChunkedTarget chunkedTarget;
+	Model targetModel = impact.TargetModel(chunkedTarget, projectile, false);
+	run.setupMatches = false;
+	if (targetModel.meshes.empty() || targetModel.meshes[0].vertices.empty())
+	{
+		run.setupMismatch = "the target couldn't be loaded";
+		run.setup = SecondsSince(setupStart);
+		return run;
+	}
+	OctreeTarget target(std::move(targetModel), impact.falloff, impact.roughness, impact.threshold);
+	if (!impact.ApplyMaterial(target))
+	{
+		run.setupMismatch = "the material map couldn't be applied";
+		run.setup = SecondsSince(setupStart);
+		return run;
+	}
+	Octree targetTree(target.targetModel, target.boundingBoxSize * 0.5f, impact.treeMaxVerts, impact.treeMaxTris, impact.treeDepth, target.boundingBoxSize,
+		target.boundingBoxCenter + glm::vec3(0, 0.001f, 0));
+	target.SetupTree(targetTree);
+	impact.PrepareTarget(target, projectile, targetTree);
+	run.setup = SecondsSince(setupStart);
+
+	ImpactSetup replayed = impact;
+	replayed.Capture(target, projectile);
+	if (replayed.projectileHash != impact.projectileHash)
+		run.setupMismatch = "the projectile model differs";
+	else if (replayed.targetVertices != impact.targetVertices || replayed.targetTriangles != impact.targetTriangles)
+		run.setupMismatch = "the target has " + std::to_string(replayed.targetVertices) + " vertices and " + std::to_string(replayed.targetTriangles) +
+			" triangles, the recording had " + std::to_string(impact.targetVertices) + " and " + std::to_string(impact.targetTriangles);
+	else if (replayed.targetHash != impact.targetHash)
+		run.setupMismatch = "the target geometry differs";
+	else if (replayed.materialHash != impact.materialHash)
+		run.setupMismatch = "the target material differs";
+	else if (replayed.rayDirection != impact.rayDirection)
+		run.setupMismatch = "the ray direction differs";
+	else
+		run.setupMatches = true;
+	if (!run.setupMatches)
+		return run;
+
+	std::chrono::steady_clock::time_point simulationStart = std::chrono::steady_clock::now();
+	while (!projectile.isDone && run.steps < log.steps.size())
+	{
+		const ReplayStep& recorded = log.steps[run.steps];
+		projectile.relaxSettings.maxIterations = recorded.relaxIterations;
+		projectile.Update(targetTree, projectileTree, target, (float)impact.stepSize, glm::mat4(1.0f));
+		if (run.firstMismatch < 0 && ImpactLog::StepHash(projectile, target) != recorded.hash)
+			run.firstMismatch = run.steps;
+		run.steps++;
+	}
+	run.simulation = SecondsSince(simulationStart);
+	run.reachedRest = projectile.isDone;
+	run.phases = projectile.phaseTimes;
+	return run;
+}
+
+bool Passed(const ReplayRun& run, const ImpactLog& log)
+{
+	return run.setupMatches && run.firstMismatch < 0 && run.steps == log.steps.size();
+}
+
+void WriteJson(std::ostream& out, const std::string& logPath, const ImpactLog& log, const std::vector<ReplayRun>& runs)
+{
+	out << "{\n  \"log\": \"" << logPath << "\",\n  \"threads\": " << Jobs().ThreadCount() << ",\n  \"stepSize\": " << log.setup.stepSize
+		<< ",\n  \"recordedSteps\": " << log.steps.size() << ",\n  \"targetTriangles\": " << log.setup.targetTriangles << ",\n  \"runs\": [\n";
+	for (int i = 0; i < runs.size(); i++)
+	{
+		const ReplayRun& r = runs[i];
+		out << "    {\"passed\": " << (Passed(r, log) ? "true" : "false") << ", \"steps\": " << r.steps << ", \"firstMismatch\": " << r.firstMismatch
+			<< ", \"seconds\": {\"setup\": " << r.setup << ", \"rayCasting\": " << r.phases.rayCasting << ", \"falloff\": " << r.phases.falloff
+			<< ", \"vertexUpdate\": " << r.phases.vertexUpdate << ", \"relaxation\": " << r.phases.relaxation << ", \"simulation\": " << r.simulation << "}}"
+			<< (i + 1 < runs.size() ? ",\n" : "\n");
+	}
+	out << "  ]\n}\n";
+}
+
+int main(int argc, char** argv)
+{
+	const char* usage = "Usage: impactReplay log.bin [--repeat n] [--out file.json] [--trace trace.json]\n";
+	if (argc < 2)
+	{
+		std::cout << usage;
+		return 1;
+	}
+	std::string logPath = argv[1];
+	int repeat = 1;
+	std::string outPath = "impact_replay.json";
+	std::string tracePath;
+	for (int i = 2; i + 1 < argc; i += 2)
+	{
+		std::string option = argv[i];
+		if (option == "--repeat")
+			repeat = std::max(std::stoi(argv[i + 1]), 1);
+		else if (option == "--out")
+			outPath = argv[i + 1];
+		else if (option == "--trace")
+			tracePath = argv[i + 1];
+		else
+		{
+			std::cout << "Unknown option " << option << "\n" << usage;
+			return 1;
+		}
+	}
+
+#if DEFORM_PROFILING
+	if (!tracePath.empty())
+		Jobs().SetTimingHook(Profiler::RecordJob);
+#endif
+
+	ImpactLog log;
+	if (!log.Read(logPath))
+		return 1;
+	//CPU only, loaded once, every run starts from a copy
+	Model projectileModel(log.setup.projectilePath, true, false, false);
+	if (projectileModel.meshes.empty())
+	{
+		std::cout << "Couldn't load the projectile of the recording\n";
+		return 1;
+	}
+
+	Logger::Get().SetLevel(LogLevel::Warn); //every run logs its trees and refinement, only the replay matters here
+	std::vector<ReplayRun> runs;
+	bool allPassed = true;
+	double fastest = DBL_MAX;
+	for (int i = 0; i < repeat; i++)
+	{
+		ReplayRun run = Replay(log, projectileModel);
+		if (!run.setupMatches)
+		{
+			std::cout << "Can't replay " << logPath << ": " << run.setupMismatch << "\n";
+			return 1;
+		}
+		bool passed = Passed(run, log);
+		std::cout << (passed ? "MATCH " : "DIFFERS ") << run.steps << "/" << log.steps.size() << " steps";
+		if (run.firstMismatch >= 0)
+			std::cout << ", first different step " << run.firstMismatch;
+		else if (run.steps < log.steps.size())
+			std::cout << ", came to rest early";
+		std::cout << ", setup " << run.setup << "s, rays " << run.phases.rayCasting << "s, falloff " << run.phases.falloff << "s, vertices "
+			<< run.phases.vertexUpdate << "s, relaxation " << run.phases.relaxation << "s, simulation " << run.simulation << "s ("
+			<< run.simulation / std::max(run.steps, 1) * 1000.0 << "ms per step, recorded at " << log.setup.stepSize * 1000.0 << "ms)\n";
+		allPassed = allPassed && passed;
+		fastest = fmin(fastest, run.simulation);
+		runs.push_back(run);
+	}
+	if (repeat > 1)
+		std::cout << "Fastest simulation " << fastest << "s of " << repeat << " runs\n";
+
+	std::ofstream out(outPath);
+	if (!out)
+	{
+		std::cout << "Couldn't open " << outPath << " for writing\n";
+		return 1;
+	}
+	WriteJson(out, logPath, log, runs);
+	std::cout << "Results written to " << outPath << "\n" << (allPassed ? "Replay matches the recording" : "Replay differs from the recording") << "\n";
+#if DEFORM_PROFILING
+	if (!tracePath.empty() && Profiler::Get().WriteChromeTrace(tracePath))
+		std::cout << "Trace written to " << tracePath << "\n";
+#endif
+	return allPassed ? 0 : 1;
+}
@@ -0,0 +1,310 @@
+//-------------------------------------------------------------------------------------
+// Headless differential check of the octree pipeline (OctreeProjectile/OctreeTarget)
+// against the brute force one (Projectile/Target, projectile.h). Runs both on procedural
+// scenes until the projectile comes to rest, the brute force one through
+// Projectile::StepLikeOctree, which has the octree's dent model but finds everything
+// through hash grids and plain loops, then compares how far every target vertex got
+// dented by each. The octree pipeline also runs with every tree a single leaf, so each
+// query tries every triangle and vertex, and is compared with that too. A scene passes
+// when no vertex differs from either by more than the tolerance (a fraction of the
+// deepest dent of the brute force run).
+// The octree pipeline is also timed against the brute force one, it has to be at least
+// --min-speedup times as fast. On most of the default scenes it isn't yet (the tree
+// builds and the per ray leaf walks cost more than the hash grids do), that's tracked
+// by the speed check failing on its own, with a separate exit code.
+// Everything stays on the CPU, no window or GL context is created.
+//
+// Usage: pipelineComparison [--sizes 1000,10000,...] [--tolerance 0.01] [--min-speedup 1] [--max-steps n] [--out file.json]
+// Sizes are target triangle counts, like in impactBenchmark. Exits with 1 if the dents
+// of any scene don't match, otherwise with 2 if the octree pipeline is too slow on any.
+// Build it as its own executable from this file, linked against glad (which the renderer
+// parts of the included headers reference).
+//-------------------------------------------------------------------------------------
+
+#include<glm\glm.hpp>
+
+#include<iostream>
+#include<fstream>
+#include<sstream>
+#include<string>
+#include<vector>
+#include<chrono>
+#include<math.h>
+#include "../proceduralMesh.h"
+#include "../projectile.h"
+#include "../target.h"
+#include "../optimalTarget.h"
+#include "../optimalProjectile.h"
+#include "../triangleOctree.h"
+#include "../jobSystem.h"
+#include "../logger.h"
+
+const float stepSize = 0.0167f; //same fixed step as the interactive app
+const glm::vec3 projectileAcceleration = glm::vec3(0.0f, -0.03f, 0.0f);
+const float falloff = 0.5f, roughness = 3.0f;
+const float threshold = 0.0f; //the brute force pipeline has no yield model, all of them run as clay that gives way to any push
+
+struct PipelineRun
+{
+	std::vector<glm::vec3> displacement; //of every target vertex, final minus starting position
+	int steps;
+	bool reachedRest;
+	double seconds;
+};
+
+struct VertexDifference
+{
+	float maxDifference;
+	float rmsDifference;
+	int mismatched; //vertices differing by more than the tolerance
+};
+
+struct ComparisonResult
+{
+	std::string target;
+	int targetTriangles;
+	int targetVertices;
+	PipelineRun exhaustive; //octree pipeline with single leaf trees
+	PipelineRun octree;
+	PipelineRun brute;
+	float maxDent; //deepest dent of the brute force run, what the tolerance is relative to
+	VertexDifference fromBrute, fromExhaustive; //of the octree run
+	int dentedBrute, dentedOctree, dentedBoth;
+	float speedup; //octree run over the brute force one
+	bool matched;
+	bool fastEnough;
+};
+
+double SecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//Targets span 2 units across, centered on the origin
+Model MakeTarget(const std::string& kind, int triangles)
+{
+	if (kind == "sphere")
+	{
+		int rings = max((int)roundf(sqrtf(triangles / 4.0f)), 2);
+		return ProceduralMesh::Sphere(rings, rings * 2, 1.0f, false);
+	}
+	int quadsPerSide = max((int)roundf(sqrtf(triangles / 2.0f)), 1);
+	if (kind == "terrain")
+		return ProceduralMesh::Terrain(quadsPerSide, 2.0f, 0.1f, 1234, false);
+	return ProceduralMesh::Plane(quadsPerSide, 2.0f, false);
+}
+
+//Projectile just above the middle of the target, slightly off its axis so it doesn't line up with the grid
+Model MakeProjectile(const Model& target)
+{
+	float targetTop = -FLT_MAX;
+	for (const Vertex& vertex : target.meshes[0].vertices)
+		targetTop = fmaxf(targetTop, vertex.Position.y);
+	Model projectile = ProceduralMesh::Sphere(8, 16, 0.15f, false);
+	for (Vertex& vertex : projectile.meshes[0].vertices)
+		vertex.Position += glm::vec3(0.013f, targetTop + 0.2f, 0.007f);
+	return projectile;
+}
+
+VertexDifference Difference(const std::vector<glm::vec3>& a, const std::vector<glm::vec3>& b, float allowed)
+{
+	VertexDifference result;
+	double squaredSum = 0.0;
+	result.maxDifference = 0.0f;
+	result.mismatched = 0;
+	for (int i = 0; i < a.size(); i++)
+	{
+		float difference = glm::length(a[i] - b[i]);
+		result.maxDifference = fmaxf(result.maxDifference, difference);
+		squaredSum += (double)difference * difference;
+		if (difference > allowed)
+			result.mismatched++;
+	}
+	result.rmsDifference = a.empty() ? 0.0f : (float)sqrt(squaredSum / a.size());
+	return result;
+}
+
+std::vector<glm::vec3> Displacement(const std::vector<Vertex>& start, const std::vector<Vertex>& end)
+{
+	std::vector<glm::vec3> displacement(start.size());
+	for (int i = 0; i < start.size(); i++)
+		displacement[i] = end[i].Position - start[i].Position;
+	return displacement;
+}
+
+PipelineRun RunBruteForce(const Model& targetModel, const Model& projectileModel, int maxSteps)
+{
+	PipelineRun run;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	Target target(targetModel, falloff, roughness, threshold);
+	Projectile projectile(projectileModel, projectileAcceleration);
+
+	run.steps = 0;
+	while (!projectile.isDone && run.steps < maxSteps)
+	{
+		projectile.StepLikeOctree(target, stepSize);
+		run.steps++;
+	}
+	run.reachedRest = projectile.isDone;
+	run.seconds = SecondsSince(start);
+	run.displacement = Displacement(targetModel.meshes[0].vertices, target.targetModel.meshes[0].vertices);
+	return run;
+}
+
+//exhaustive builds both trees as a single leaf (depth 0), the queries then go through every triangle
+PipelineRun RunOctree(const Model& targetModel, const Model& projectileModel, int maxSteps, bool exhaustive)
+{
+	PipelineRun run;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	OctreeTarget target(targetModel, falloff, roughness, threshold);
+	OctreeProjectile projectile(projectileModel, projectileAcceleration);
+
+	int depth = exhaustive ? 0 : 3;
+	Octree targetTree(target.targetModel, target.boundingBoxSize * 0.5f, 3, 3, depth, target.boundingBoxSize, target.boundingBoxCenter + glm::vec3(0, 0.001f, 0));
+	target.SetupTree(targetTree);
+	Octree projectileTree(projectile.projectileMesh, projectile.boundingBoxSize * 0.5f, 3, 3, depth, projectile.boundingBoxSize,
+		projectile.boundingBoxCenter + glm::vec3(0, 0.001f, 0));
+	projectile.SetupTree(projectileTree);
+
+	run.steps = 0;
+	while (!projectile.isDone && run.steps < maxSteps)
+	{
+		projectile.Update(targetTree, projectileTree, target, stepSize, glm::mat4(1.0f));
+		run.steps++;
+	}
+	run.reachedRest = projectile.isDone;
+	run.seconds = SecondsSince(start);
+	run.displacement = Displacement(targetModel.meshes[0].vertices, targetTree.model.meshes[0].vertices);
+	return run;
+}
+
+ComparisonResult Compare(const std::string& targetKind, int triangles, float tolerance, float minSpeedup, int maxSteps)
+{
+	ComparisonResult result;
+	result.target = targetKind;
+	Model targetModel = MakeTarget(targetKind, triangles);
+	Model projectileModel = MakeProjectile(targetModel);
+	result.targetTriangles = (int)targetModel.meshes[0].indices.size() / 3;
+	result.targetVertices = (int)targetModel.meshes[0].vertices.size();
+
+	result.exhaustive = RunOctree(targetModel, projectileModel, maxSteps, true);
+	result.octree = RunOctree(targetModel, projectileModel, maxSteps, false);
+	result.brute = RunBruteForce(targetModel, projectileModel, maxSteps);
+
+	result.maxDent = 0.0f;
+	for (int i = 0; i < result.targetVertices; i++)
+		result.maxDent = fmaxf(result.maxDent, glm::length(result.brute.displacement[i]));
+	float allowed = tolerance * result.maxDent;
+	result.fromBrute = Difference(result.brute.displacement, result.octree.displacement, allowed);
+	result.fromExhaustive = Difference(result.exhaustive.displacement, result.octree.displacement, allowed);
+
+	float dentedThreshold = 0.001f * result.maxDent; //moved at all, not counting rounding
+	result.dentedBrute = result.dentedOctree = result.dentedBoth = 0;
+	for (int i = 0; i < result.targetVertices; i++)
+	{
+		bool dentedBrute = glm::length(result.brute.displacement[i]) > dentedThreshold;
+		bool dentedOctree = glm::length(result.octree.displacement[i]) > dentedThreshold;
+		result.dentedBrute += dentedBrute;
+		result.dentedOctree += dentedOctree;
+		result.dentedBoth += dentedBrute && dentedOctree;
+	}
+	result.matched = result.fromBrute.mismatched == 0 && result.fromExhaustive.mismatched == 0 && result.brute.reachedRest &&
+		result.exhaustive.reachedRest && result.octree.reachedRest && result.maxDent > 0.0f;
+	result.speedup = (float)(result.brute.seconds / result.octree.seconds);
+	result.fastEnough = result.speedup >= minSpeedup;
+	return result;
+}
+
+void WriteDifference(std::ostream& out, const VertexDifference& difference)
+{
+	out << "{\"max\": " << difference.maxDifference << ", \"rms\": " << difference.rmsDifference << ", \"mismatched\": " << difference.mismatched << "}";
+}
+
+void WriteJson(std::ostream& out, const std::vector<ComparisonResult>& results, float tolerance, float minSpeedup)
+{
+	out << "{\n  \"threads\": " << Jobs().ThreadCount() << ",\n  \"tolerance\": " << tolerance << ",\n  \"minSpeedup\": " << minSpeedup
+		<< ",\n  \"results\": [\n";
+	for (int i = 0; i < results.size(); i++)
+	{
+		const ComparisonResult& r = results[i];
+		out << "    {\"target\": \"" << r.target << "\", \"targetTriangles\": " << r.targetTriangles << ", \"targetVertices\": " << r.targetVertices
+			<< ", \"matched\": " << (r.matched ? "true" : "false") << ", \"fastEnough\": " << (r.fastEnough ? "true" : "false")
+			<< ", \"maxDent\": " << r.maxDent << ", \"differenceFromBruteForce\": ";
+		WriteDifference(out, r.fromBrute);
+		out << ", \"differenceFromExhaustive\": ";
+		WriteDifference(out, r.fromExhaustive);
+		out << ", \"dented\": {\"bruteForce\": " << r.dentedBrute << ", \"octree\": " << r.dentedOctree << ", \"both\": " << r.dentedBoth << "}"
+			<< ", \"steps\": {\"exhaustive\": " << r.exhaustive.steps << ", \"octree\": " << r.octree.steps << ", \"bruteForce\": " << r.brute.steps << "}"
+			<< ", \"seconds\": {\"exhaustive\": " << r.exhaustive.seconds << ", \"octree\": " << r.octree.seconds << ", \"bruteForce\": " << r.brute.seconds << "}"
+			<< ", \"speedupOverExhaustive\": " << r.exhaustive.seconds / r.octree.seconds << ", \"speedupOverBruteForce\": " << r.speedup << "}"
+			<< (i + 1 < results.size() ? ",\n" : "\n");
+	}
+	out << "  ]\n}\n";
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<int> sizes = { 1000, 10000, 50000 };
+	float tolerance = 0.01f; //the trees have matched both to within 0.5% of the deepest dent
+	float minSpeedup = 1.0f;
+	int maxSteps = 10000;
+	std::string outPath = "pipeline_comparison.json";
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		std::string option = argv[i];
+		if (option == "--sizes")
+		{
+			sizes.clear();
+			std::stringstream list(argv[i + 1]);
+			std::string size;
+			while (std::getline(list, size, ','))
+				sizes.push_back(std::stoi(size));
+		}
+		else if (option == "--tolerance")
+			tolerance = std::stof(argv[i + 1]);
+		else if (option == "--min-speedup")
+			minSpeedup = std::stof(argv[i + 1]);
+		else if (option == "--max-steps")
+			maxSteps = std::stoi(argv[i + 1]);
+		else if (option == "--out")
+			outPath = argv[i + 1];
+		else
+		{
+			std::cout << "Unknown option " << option << "\nUsage: pipelineComparison [--sizes 1000,10000,...] [--tolerance 0.01] [--min-speedup 1] [--max-steps n] [--out file.json]\n";
+			return 1;
+		}
+	}
+
+	Logger::Get().SetLevel(LogLevel::Warn); //every run logs the octrees it builds, only the comparison matters here
+	std::vector<ComparisonResult> results;
+	bool allMatched = true, allFastEnough = true;
+	const char* targets[] = { "plane", "sphere", "terrain" };
+	for (int size : sizes)
+	{
+		for (const char* targetKind : targets)
+		{
+			ComparisonResult result = Compare(targetKind, size, tolerance, minSpeedup, maxSteps);
+			std::cout << (!result.matched ? "FAIL " : result.fastEnough ? "PASS " : "SLOW ") << result.target << " (" << result.targetTriangles
+				<< " tris): max difference " << result.fromBrute.maxDifference << " of a " << result.maxDent << " dent, rms " << result.fromBrute.rmsDifference
+				<< ", " << result.fromBrute.mismatched << " verts over tolerance, dented " << result.dentedBrute << "/" << result.dentedOctree
+				<< " (both " << result.dentedBoth << "), brute force " << result.brute.seconds << "s (" << result.brute.steps << " steps), octree "
+				<< result.octree.seconds << "s (" << result.octree.steps << " steps), speedup " << result.speedup << "x\n"
+				<< "     exhaustive: max difference " << result.fromExhaustive.maxDifference << ", " << result.fromExhaustive.mismatched << " verts over tolerance, "
+				<< result.exhaustive.seconds << "s (" << result.exhaustive.steps << " steps), speedup " << result.exhaustive.seconds / result.octree.seconds << "x\n";
+			allMatched = allMatched && result.matched;
+			allFastEnough = allFastEnough && result.fastEnough;
+			results.push_back(result);
+		}
+	}
+
+	std::ofstream out(outPath);
+	if (!out)
+	{
+		std::cout << "Couldn't open " << outPath << " for writing\n";
+		return 1;
+	}
+	WriteJson(out, results, tolerance, minSpeedup);
+	std::cout << "Results written to " << outPath << "\n" << (allMatched ? "All scenes match" : "Some scenes don't match")
+		<< (allFastEnough ? "" : ", the octree pipeline isn't fast enough on some (see SLOW)") << "\n";
+	return !allMatched ? 1 : !allFastEnough ? 2 : 0;
+}
@@ -0,0 +1,593 @@
+#ifndef CHUNKED_TARGET_H
+#define CHUNKED_TARGET_H
+//-------------------------------------------------------------------------------------
+// Out of core targets, for meshes too big to keep in memory whole. The mesh is
+// preprocessed once into a chunk file: its vertices are sorted by the octree cell they
+// fall into (a fixed depth over the bounding cube, cells in Morton order, so chunks next
+// to each other in the file are next to each other in space), every non-empty cell is a
+// chunk, and every triangle belongs to the chunk of its lowest vertex.
+// A run loads one window when it's set up: the chunks the projectile can reach (within
+// a margin), as an ordinary model that the rest of the pipeline (octree, falloff,
+// relaxation...) works on as usual. How far it can get is worked out first: its rays are
+// cast through the chunks along its path, nearest first, until the first hit, and from
+// there it can only slow down (see OctreeProjectile::MaxTravel). Those chunks are paged
+// in by the OS as the rays touch them and dropped again afterwards. The window then stays
+// the same for the whole run, every per vertex structure of the pipeline (trees,
+// material, history, export stream, snapshots, GPU buffers) assumes a fixed vertex set.
+// If the window doesn't fit into the resident budget loading fails, a window cut short
+// would give a different dent. Triangles reaching into chunks outside the window are left
+// out, so the window has an open border. Chunks are memory mapped only while they're
+// read, so what stays resident is the window. The chunk file is only ever read, after the
+// run the dented mesh goes into a copy of it (see WriteDented), with the chunks whose
+// vertices moved patched. Vertices added to the window (refinement) have no place in the
+// file and aren't kept.
+//
+// File layout, all little endian, vertices as the Vertex struct is in memory:
+//   header: "DTCK", uint32 version, uint32 vertex count, uint32 triangle count, uint32 chunk count,
+//           material (diffuse, specular, ambient, shininess)
+//   chunk table: per chunk, bounds min and max (of its vertices and triangles), first vertex,
+//           vertex count, first triangle, triangle count
+//   vertices of all chunks, then the triangles of all chunks (3 uint32, file wide vertex indices)
+//-------------------------------------------------------------------------------------
+
+#include<glm\glm.hpp>
+
+#include<string>
+#include<vector>
+#include<fstream>
+#include<algorithm>
+#include<stdint.h>
+#include<string.h>
+#include<float.h>
+#include<math.h>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include<windows.h>
+#else
+#include<sys/mman.h>
+#include<fcntl.h>
+#include<unistd.h>
+#endif
+#include "model.h"
+#include "rayUtil.h"
+#include "logger.h"
+
+struct TargetChunk
+{
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+	uint32_t firstVertex, vertexCount;
+	uint32_t firstTriangle, triangleCount;
+
+	size_t Bytes() const
+	{
+		return (size_t)vertexCount * sizeof(Vertex) + (size_t)triangleCount * 3 * sizeof(uint32_t);
+	}
+};
+
+//A file that parts of can be memory mapped, read only or read and write
+class MappedFile
+{
+public:
+	~MappedFile()
+	{
+		Close();
+	}
+
+	bool Open(const std::string& path, bool writable)
+	{
+		Close();
+		this->writable = writable;
+#ifdef _WIN32
+		file = CreateFileA(path.c_str(), writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+		mapping = CreateFileMappingA(file, NULL, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL)
+		{
+			Close();
+			return false;
+		}
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		granularity = info.dwAllocationGranularity;
+#else
+		file = open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+		if (file < 0)
+			return false;
+		granularity = (size_t)sysconf(_SC_PAGESIZE);
+#endif
+		return true;
+	}
+
+	void Close()
+	{
+#ifdef _WIN32
+		if (mapping != NULL)
+			CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+		mapping = NULL;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (file >= 0)
+			close(file);
+		file = -1;
+#endif
+	}
+
+	//Bytes from offset to offset + size, mapped until Unmap(view), only to be written if the file was opened writable
+	struct View
+	{
+		char* data = nullptr;
+		void* base = nullptr; //where the mapping starts, at the granularity before offset
+		size_t length = 0;
+	};
+
+	View Map(uint64_t offset, size_t size)
+	{
+		View view;
+		uint64_t alignedOffset = offset - offset % granularity;
+		view.length = (size_t)(offset - alignedOffset) + size;
+#ifdef _WIN32
+		view.base = MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, (DWORD)(alignedOffset >> 32), (DWORD)alignedOffset, view.length);
+		if (view.base == NULL)
+			return View();
+#else
+		view.base = mmap(NULL, view.length, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, file, (off_t)alignedOffset);
+		if (view.base == MAP_FAILED)
+			return View();
+#endif
+		view.data = (char*)view.base + (offset - alignedOffset);
+		return view;
+	}
+
+	//Writes what changed in the view to the file before unmapping it if flush is set
+	void Unmap(View& view, bool flush)
+	{
+		if (view.base == nullptr)
+			return;
+#ifdef _WIN32
+		if (flush)
+			FlushViewOfFile(view.base, view.length);
+		UnmapViewOfFile(view.base);
+#else
+		if (flush)
+			msync(view.base, view.length, MS_SYNC);
+		munmap(view.base, view.length);
+#endif
+		view = View();
+	}
+
+private:
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+#else
+	int file = -1;
+#endif
+	size_t granularity = 4096;
+	bool writable = false;
+};
+
+class ChunkedTarget
+{
+public:
+	//Preprocesses a mesh into a chunk file, cells are an octree of the given depth (at most 10) over its bounding cube
+	static bool Build(const Model& model, const std::string& path, int depth)
+	{
+		PROFILE_ZONE("chunk file build");
+		const Mesh& mesh = model.meshes[0];
+		int vertexCount = (int)mesh.vertices.size();
+		if (vertexCount == 0)
+			return false;
+		depth = std::min(std::max(depth, 0), 10);
+		glm::vec3 min = mesh.vertices[0].Position, max = min;
+		for (const Vertex& vertex : mesh.vertices)
+		{
+			min = glm::min(min, vertex.Position);
+			max = glm::max(max, vertex.Position);
+		}
+		float size = fmaxf(fmaxf(fmaxf(max.x - min.x, max.y - min.y), max.z - min.z), FLT_EPSILON);
+		int cellsPerSide = 1 << depth;
+
+		//vertices sorted by their cell, in the order they came within one
+		std::vector<uint32_t> cellOf(vertexCount);
+		std::vector<int> order(vertexCount);
+		for (int i = 0; i < vertexCount; i++)
+		{
+			glm::vec3 cell = glm::floor((mesh.vertices[i].Position - min) / size * (float)cellsPerSide);
+			cell = glm::clamp(cell, glm::vec3(0.0f), glm::vec3((float)(cellsPerSide - 1)));
+			cellOf[i] = MortonCode((uint32_t)cell.x, (uint32_t)cell.y, (uint32_t)cell.z);
+			order[i] = i;
+		}
+		std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return cellOf[a] < cellOf[b]; });
+		std::vector<uint32_t> newIndex(vertexCount);
+		std::vector<TargetChunk> chunks;
+		for (int i = 0; i < vertexCount; i++)
+		{
+			newIndex[order[i]] = (uint32_t)i;
+			if (i == 0 || cellOf[order[i]] != cellOf[order[i - 1]])
+			{
+				TargetChunk chunk;
+				chunk.boundsMin = glm::vec3(FLT_MAX);
+				chunk.boundsMax = glm::vec3(-FLT_MAX);
+				chunk.firstVertex = (uint32_t)i;
+				chunk.vertexCount = 0;
+				chunks.push_back(chunk);
+			}
+			chunks.back().vertexCount++;
+		}
+		std::vector<uint32_t> chunkOf(vertexCount);
+		for (uint32_t c = 0; c < chunks.size(); c++)
+			for (uint32_t v = chunks[c].firstVertex; v < chunks[c].firstVertex + chunks[c].vertexCount; v++)
+				chunkOf[v] = c;
+
+		//triangles in new indices, grouped by the chunk of their lowest vertex, counting sort style
+		size_t triangleCount = mesh.indices.size() / 3;
+		std::vector<uint32_t> triangleStart(chunks.size() + 1, 0);
+		for (size_t t = 0; t < triangleCount; t++)
+			triangleStart[chunkOf[LowestVertex(mesh.indices, t, newIndex)] + 1]++;
+		for (size_t c = 0; c < chunks.size(); c++)
+			triangleStart[c + 1] += triangleStart[c];
+		std::vector<uint32_t> triangles(triangleCount * 3);
+		std::vector<uint32_t> fill(triangleStart.begin(), triangleStart.end() - 1);
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			uint32_t c = chunkOf[LowestVertex(mesh.indices, t, newIndex)];
+			uint32_t slot = fill[c]++;
+			for (int k = 0; k < 3; k++)
+			{
+				uint32_t vert = newIndex[mesh.indices[3 * t + k]];
+				triangles[3 * slot + k] = vert;
+				chunks[c].boundsMin = glm::min(chunks[c].boundsMin, mesh.vertices[order[vert]].Position);
+				chunks[c].boundsMax = glm::max(chunks[c].boundsMax, mesh.vertices[order[vert]].Position);
+			}
+		}
+		for (size_t c = 0; c < chunks.size(); c++)
+		{
+			chunks[c].firstTriangle = triangleStart[c];
+			chunks[c].triangleCount = triangleStart[c + 1] - triangleStart[c];
+			for (uint32_t v = chunks[c].firstVertex; v < chunks[c].firstVertex + chunks[c].vertexCount; v++)
+			{
+				chunks[c].boundsMin = glm::min(chunks[c].boundsMin, mesh.vertices[order[v]].Position);
+				chunks[c].boundsMax = glm::max(chunks[c].boundsMax, mesh.vertices[order[v]].Position);
+			}
+		}
+
+		std::ofstream out(path, std::ios::binary);
+		if (!out)
+		{
+			LOG_ERROR("Couldn't open " << path << " for writing the chunk file");
+			return false;
+		}
+		uint32_t header[4] = { version, (uint32_t)vertexCount, (uint32_t)triangleCount, (uint32_t)chunks.size() };
+		out.write(magic, 4);
+		out.write((const char*)header, sizeof(header));
+		out.write((const char*)&model.material, sizeof(Material));
+		out.write((const char*)chunks.data(), chunks.size() * sizeof(TargetChunk));
+		for (int i = 0; i < vertexCount; i++)
+			out.write((const char*)&mesh.vertices[order[i]], sizeof(Vertex));
+		out.write((const char*)triangles.data(), triangles.size() * sizeof(uint32_t));
+		if (!out)
+		{
+			LOG_ERROR("Writing the chunk file " << path << " failed");
+			return false;
+		}
+		LOG_INFO("Chunk file " << path << " built: " << vertexCount << " vertices, " << triangleCount << " triangles in " << chunks.size() << " chunks");
+		return true;
+	}
+
+	bool Open(const std::string& path)
+	{
+		std::ifstream in(path, std::ios::binary);
+		char fileMagic[4] = {};
+		uint32_t header[4] = {};
+		in.read(fileMagic, 4);
+		in.read((char*)header, sizeof(header));
+		if (!in || memcmp(fileMagic, magic, 4) != 0 || header[0] != version)
+			return false;
+		vertexCount = header[1];
+		triangleCount = header[2];
+		chunks.resize(header[3]);
+		in.read((char*)&material, sizeof(Material));
+		in.read((char*)chunks.data(), chunks.size() * sizeof(TargetChunk));
+		if (!in || !file.Open(path, false))
+		{
+			LOG_ERROR("Couldn't open the chunk file " << path);
+			return false;
+		}
+		vertexData = 4 + sizeof(header) + sizeof(Material) + chunks.size() * sizeof(TargetChunk);
+		triangleData = vertexData + (uint64_t)vertexCount * sizeof(Vertex);
+		resident.clear();
+		this->path = path;
+		return true;
+	}
+
+	bool IsOpen() const { return !path.empty(); }
+
+	//Distance along direction to the nearest triangle the rays from the projectile's vertices hit, false if they all miss
+	//The chunks along the path are tried nearest first, until the rest are further than the nearest hit
+	bool FirstHit(const Mesh& projectile, glm::vec3 direction, float& distance)
+	{
+		PROFILE_ZONE("chunk first hit");
+		if (projectile.vertices.empty() || chunks.empty() || glm::length(direction) <= 0.0f)
+			return false;
+		direction = glm::normalize(direction);
+		glm::vec3 min = projectile.vertices[0].Position, max = min;
+		for (const Vertex& vertex : projectile.vertices)
+		{
+			min = glm::min(min, vertex.Position);
+			max = glm::max(max, vertex.Position);
+		}
+		glm::vec3 center = (min + max) * 0.5f;
+		float halfSize = glm::length(max - min) * 0.5f; //every vertex is within it of the center
+
+		std::vector<std::pair<float, int>> alongPath; //entry distance of the center, chunk
+		for (int c = 0; c < (int)chunks.size(); c++)
+		{
+			float entry;
+			if (chunks[c].triangleCount > 0 && SweptBoxHits(center, direction, chunks[c].boundsMin - glm::vec3(halfSize), chunks[c].boundsMax + glm::vec3(halfSize), entry))
+				alongPath.push_back(std::make_pair(entry, c));
+		}
+		std::sort(alongPath.begin(), alongPath.end());
+
+		//triangles reach into the vertices of any chunk, the OS pages in the ones they touch
+		MappedFile::View vertexView = file.Map(vertexData, (size_t)vertexCount * sizeof(Vertex));
+		if (vertexView.data == nullptr)
+		{
+			LOG_ERROR("Couldn't map the vertices of " << path);
+			return false;
+		}
+		const Vertex* vertices = (const Vertex*)vertexView.data;
+		float nearest = FLT_MAX;
+		for (const std::pair<float, int>& candidate : alongPath)
+		{
+			//a vertex's ray can't hit anything in the chunk before the center gets within halfSize of it
+			if (candidate.first - 2.0f * halfSize > nearest)
+				break;
+			const TargetChunk& chunk = chunks[candidate.second];
+			MappedFile::View view = file.Map(triangleData + (uint64_t)chunk.firstTriangle * 3 * sizeof(uint32_t), (size_t)chunk.triangleCount * 3 * sizeof(uint32_t));
+			if (view.data == nullptr)
+				continue;
+			const uint32_t* triangles = (const uint32_t*)view.data;
+			for (uint32_t t = 0; t < chunk.triangleCount; t++)
+			{
+				for (const Vertex& origin : projectile.vertices)
+				{
+					float hitDistance;
+					if (RayUtil::MTRayCheck(vertices[triangles[3 * t]].Position, vertices[triangles[3 * t + 1]].Position, vertices[triangles[3 * t + 2]].Position,
+						origin.Position, direction, hitDistance) && hitDistance >= 0.0f)
+						nearest = fminf(nearest, hitDistance);
+				}
+			}
+			file.Unmap(view, false);
+		}
+		file.Unmap(vertexView, false);
+		if (nearest == FLT_MAX)
+			return false;
+		distance = nearest;
+		return true;
+	}
+
+	//Loads the chunks within margin of the box of the given half size swept from center along direction as the window model,
+	//as far as reach along it (FLT_MAX for the whole path), once, before the run. Returns an empty model (no meshes) if their
+	//vertices and triangles don't fit into budget bytes
+	Model LoadWindow(glm::vec3 center, float halfSize, glm::vec3 direction, float margin, float reach, size_t budget, bool createBuffers)
+	{
+		PROFILE_ZONE("load chunk window");
+		resident.clear();
+		windowStart.clear();
+		direction = glm::normalize(direction);
+		size_t bytes = 0;
+		for (int c = 0; c < (int)chunks.size(); c++) //file order, so the window's vertices keep the spatial order
+		{
+			float entry;
+			glm::vec3 around = glm::vec3(halfSize + margin);
+			if (!SweptBoxHits(center, direction, chunks[c].boundsMin - around, chunks[c].boundsMax + around, entry) || entry > reach)
+				continue;
+			bytes += chunks[c].Bytes();
+			resident.push_back(c);
+		}
+		if (bytes > budget)
+		{
+			LOG_ERROR("The " << resident.size() << " chunks the projectile can reach take " << bytes << " bytes, over the resident budget of "
+				<< budget << " bytes, the window can't be loaded");
+			resident.clear();
+			return Model(std::vector<Mesh>());
+		}
+
+		//vertices chunk by chunk, each one mapped only while it's copied
+		std::vector<Vertex> vertices;
+		windowStart.resize(resident.size());
+		for (size_t r = 0; r < resident.size(); r++)
+		{
+			const TargetChunk& chunk = chunks[resident[r]];
+			windowStart[r] = (uint32_t)vertices.size();
+			MappedFile::View view = file.Map(vertexData + (uint64_t)chunk.firstVertex * sizeof(Vertex), (size_t)chunk.vertexCount * sizeof(Vertex));
+			if (view.data == nullptr)
+			{
+				LOG_ERROR("Couldn't map a chunk of " << path);
+				break;
+			}
+			const Vertex* chunkVertices = (const Vertex*)view.data;
+			vertices.insert(vertices.end(), chunkVertices, chunkVertices + chunk.vertexCount);
+			file.Unmap(view, false);
+		}
+		windowVertexCount = vertices.size();
+
+		//triangles with every vertex resident, in window indices
+		std::vector<unsigned int> indices;
+		for (size_t r = 0; r < resident.size(); r++)
+		{
+			const TargetChunk& chunk = chunks[resident[r]];
+			if (chunk.triangleCount == 0)
+				continue;
+			MappedFile::View view = file.Map(triangleData + (uint64_t)chunk.firstTriangle * 3 * sizeof(uint32_t), (size_t)chunk.triangleCount * 3 * sizeof(uint32_t));
+			if (view.data == nullptr)
+			{
+				LOG_ERROR("Couldn't map a chunk of " << path);
+				break;
+			}
+			const uint32_t* triangles = (const uint32_t*)view.data;
+			for (uint32_t t = 0; t < chunk.triangleCount; t++)
+			{
+				int window[3];
+				if (!WindowIndex(triangles[3 * t], window[0]) || !WindowIndex(triangles[3 * t + 1], window[1]) || !WindowIndex(triangles[3 * t + 2], window[2]))
+					continue;
+				indices.insert(indices.end(), window, window + 3);
+			}
+			file.Unmap(view, false);
+		}
+		LOG_INFO("Loaded " << resident.size() << " of " << chunks.size() << " chunks: " << vertices.size() << " of " << vertexCount << " vertices, "
+			<< indices.size() / 3 << " of " << triangleCount << " triangles, " << bytes << " bytes");
+
+		std::vector<Mesh> meshes;
+		meshes.push_back(Mesh(std::move(vertices), std::move(indices), std::vector<Texture>(), true, createBuffers));
+		Model window(std::move(meshes));
+		window.material = material;
+		return window;
+	}
+
+	//Writes the chunk file with the positions of the window's vertices in the chunks they came from to outputPath, a copy of
+	//the opened one with only the chunks where any vertex moved changed. The opened file itself is never written
+	//Returns how many chunks were changed, -1 if the copy couldn't be written
+	int WriteDented(const Mesh& window, const std::string& outputPath)
+	{
+		PROFILE_ZONE("write dented chunks");
+		if (outputPath == path)
+		{
+			LOG_ERROR("The dented chunks would overwrite " << path << ", they go into a file of their own");
+			return -1;
+		}
+		if (window.vertices.size() < windowVertexCount)
+			return 0;
+		{
+			std::ifstream in(path, std::ios::binary);
+			std::ofstream out(outputPath, std::ios::binary | std::ios::trunc);
+			out << in.rdbuf();
+			if (!in || !out)
+			{
+				LOG_ERROR("Couldn't copy " << path << " to " << outputPath);
+				return -1;
+			}
+		}
+		MappedFile output;
+		if (!output.Open(outputPath, true))
+		{
+			LOG_ERROR("Couldn't open " << outputPath << " for the dented chunks");
+			return -1;
+		}
+		int written = 0;
+		for (size_t r = 0; r < resident.size(); r++)
+		{
+			const TargetChunk& chunk = chunks[resident[r]];
+			MappedFile::View view = output.Map(vertexData + (uint64_t)chunk.firstVertex * sizeof(Vertex), (size_t)chunk.vertexCount * sizeof(Vertex));
+			if (view.data == nullptr)
+			{
+				LOG_ERROR("Couldn't map a chunk of " << outputPath);
+				return -1;
+			}
+			Vertex* chunkVertices = (Vertex*)view.data;
+			bool dirty = false;
+			for (uint32_t v = 0; v < chunk.vertexCount; v++)
+			{
+				const glm::vec3& position = window.vertices[windowStart[r] + v].Position;
+				if (memcmp(&chunkVertices[v].Position, &position, sizeof(glm::vec3)) != 0)
+				{
+					chunkVertices[v].Position = position;
+					dirty = true;
+				}
+			}
+			output.Unmap(view, dirty);
+			written += dirty;
+		}
+		LOG_INFO("Wrote " << outputPath << " with " << written << " dented chunks");
+		return written;
+	}
+
+	//Where the dented copy of a chunk file goes by default, next to it: "target.chunks" gives "target.dented.chunks"
+	static std::string DentedPath(const std::string& path)
+	{
+		size_t dot = path.find_last_of('.');
+		size_t slash = path.find_last_of("/\\");
+		if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+			return path + ".dented";
+		return path.substr(0, dot) + ".dented" + path.substr(dot);
+	}
+
+	size_t ChunkCount() const { return chunks.size(); }
+	size_t ResidentChunks() const { return resident.size(); }
+
+private:
+	static constexpr const char* magic = "DTCK";
+	static const uint32_t version = 1;
+
+	//Interleaves the bits of the cell coordinates, cells close in space get close codes
+	static uint32_t MortonCode(uint32_t x, uint32_t y, uint32_t z)
+	{
+		uint32_t code = 0;
+		for (int bit = 0; bit < 10; bit++)
+			code |= ((x >> bit) & 1) << (3 * bit) | ((y >> bit) & 1) << (3 * bit + 1) | ((z >> bit) & 1) << (3 * bit + 2);
+		return code;
+	}
+
+	static uint32_t LowestVertex(const std::vector<unsigned int>& indices, size_t triangle, const std::vector<uint32_t>& newIndex)
+	{
+		return std::min(std::min(newIndex[indices[3 * triangle]], newIndex[indices[3 * triangle + 1]]), newIndex[indices[3 * triangle + 2]]);
+	}
+
+	//Slab test of the ray from origin along direction against the box, entry gets where it goes in (0 if it starts inside)
+	static bool SweptBoxHits(glm::vec3 origin, glm::vec3 direction, glm::vec3 boxMin, glm::vec3 boxMax, float& entry)
+	{
+		float enter = 0.0f, leave = FLT_MAX;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (fabsf(direction[axis]) < 1e-8f)
+			{
+				if (origin[axis] < boxMin[axis] || origin[axis] > boxMax[axis])
+					return false;
+				continue;
+			}
+			float t0 = (boxMin[axis] - origin[axis]) / direction[axis], t1 = (boxMax[axis] - origin[axis]) / direction[axis];
+			enter = fmaxf(enter, fminf(t0, t1));
+			leave = fminf(leave, fmaxf(t0, t1));
+		}
+		entry = enter;
+		return enter <= leave;
+	}
+
+	//Where a file wide vertex index is in the window, false if its chunk isn't resident
+	bool WindowIndex(uint32_t vert, int& window) const
+	{
+		//the chunk holding it, chunks are in vertex order
+		int low = 0, high = (int)chunks.size() - 1;
+		while (low < high)
+		{
+			int middle = (low + high + 1) / 2;
+			if (chunks[middle].firstVertex <= vert)
+				low = middle;
+			else
+				high = middle - 1;
+		}
+		std::vector<int>::const_iterator found = std::lower_bound(resident.begin(), resident.end(), low);
+		if (found == resident.end() || *found != low)
+			return false;
+		window = (int)(windowStart[found - resident.begin()] + (vert - chunks[low].firstVertex));
+		return true;
+	}
+
+	std::string path;
+	MappedFile file;
+	uint32_t vertexCount = 0, triangleCount = 0;
+	Material material;
+	std::vector<TargetChunk> chunks;
+	uint64_t vertexData = 0, triangleData = 0; //file offsets
+	std::vector<int> resident; //chunks in the window, in file order
+	std::vector<uint32_t> windowStart; //per resident chunk, its first vertex in the window
+	size_t windowVertexCount = 0;
+};
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef COLLISION_MIRROR_H
+#define COLLISION_MIRROR_H
+//-------------------------------------------------------------------------------------
+// Compact copy of the target positions the collision queries read, one per octree leaf.
+// The ray checks and the falloff only need positions, but reading them out of the mesh
+// pulls whole Vertex structs (56 bytes, with normal, UVs and tangents) into the cache,
+// three scattered ones per triangle. A leaf's mirror keeps the corners of its triangles
+// next to each other, in the order of the leaf's triangle list, quantised to 16 bits
+// per axis within the box around them: 18 bytes a triangle, read front to back. The
+// error is at most half a step, 1/131070 of the box, along each axis.
+// The sphere queries behind the falloff want vertices rather than triangles, so the
+// mirror also lists every vertex of the leaf once, with its index and packed position.
+// That's about a sixth of the corners, a vertex is shared by six triangles on average.
+// Moved vertices aren't requantised, the octree flags them and reads them from the mesh
+// as full floats from then on (see Octree::MarkExact), so dents never lose precision.
+//-------------------------------------------------------------------------------------
+
+#include<glm\glm.hpp>
+
+#include<vector>
+#include<stdint.h>
+#include<math.h>
+
+struct PackedPosition
+{
+	uint16_t q[3];
+};
+
+struct PackedTriangle
+{
+	PackedPosition corners[3];
+};
+
+class LeafMirror
+{
+public:
+	//Fits the box to corners (three per triangle) and quantises all of them, the vertex list has to be packed again after it
+	void Pack(const std::vector<glm::vec3>& corners)
+	{
+		tris.resize(corners.size() / 3);
+		vertsStale = true;
+		if (corners.empty())
+			return;
+		glm::vec3 boxMin = corners[0], boxMax = corners[0];
+		for (const glm::vec3& corner : corners)
+		{
+			boxMin = glm::min(boxMin, corner);
+			boxMax = glm::max(boxMax, corner);
+		}
+		origin = boxMin;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float extent = boxMax[axis] - boxMin[axis];
+			step[axis] = extent / 65535.0f;
+			inverseStep[axis] = extent > 0.0f ? 65535.0f / extent : 0.0f;
+		}
+		for (size_t t = 0; t < tris.size(); t++)
+		{
+			for (int k = 0; k < 3; k++)
+				Quantise(corners[3 * t + k], tris[t].corners[k]);
+		}
+	}
+
+	//Lists the vertices (sorted, every one once) with their positions, in the box the triangles were packed in
+	void PackVerts(const std::vector<int>& indices, const std::vector<glm::vec3>& positions)
+	{
+		verts = indices;
+		vertPositions.resize(positions.size());
+		for (size_t v = 0; v < positions.size(); v++)
+			Quantise(positions[v], vertPositions[v]); //moved vertices that left the box are read exactly anyway
+		vertsStale = false;
+	}
+
+	//Adds a triangle at the end, returns false (and adds nothing) if a corner is outside the box, the leaf has to be packed again then
+	bool Append(const glm::vec3 corners[3])
+	{
+		PackedTriangle packed;
+		bool fits = !tris.empty();
+		for (int k = 0; k < 3 && fits; k++)
+			fits = Quantise(corners[k], packed.corners[k]);
+		if (!fits)
+			return false;
+		tris.push_back(packed);
+		vertsStale = true;
+		return true;
+	}
+
+	glm::vec3 Corner(int tri, int corner) const
+	{
+		return Unpack(tris[tri].corners[corner]);
+	}
+
+	glm::vec3 VertexPosition(int vert) const
+	{
+		return Unpack(vertPositions[vert]);
+	}
+
+	size_t Bytes() const
+	{
+		return sizeof(LeafMirror) + tris.capacity() * sizeof(PackedTriangle) + verts.capacity() * sizeof(int) +
+			vertPositions.capacity() * sizeof(PackedPosition);
+	}
+
+	std::vector<PackedTriangle> tris; //same order as the leaf's tris
+	std::vector<int> verts; //indices in the mesh
+	std::vector<PackedPosition> vertPositions; //same order as verts
+	bool vertsStale = true; //the triangles changed since the vertex list was packed
+
+private:
+	bool Quantise(glm::vec3 position, PackedPosition& packed) const
+	{
+		bool fits = true;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float q = roundf((position[axis] - origin[axis]) * inverseStep[axis]);
+			fits = fits && q >= 0.0f && q <= 65535.0f && (step[axis] > 0.0f || position[axis] == origin[axis]);
+			packed.q[axis] = (uint16_t)fmaxf(0.0f, fminf(65535.0f, q));
+		}
+		return fits;
+	}
+
+	glm::vec3 Unpack(const PackedPosition& packed) const
+	{
+		return origin + glm::vec3((float)packed.q[0], (float)packed.q[1], (float)packed.q[2]) * step;
+	}
+
+	glm::vec3 origin = glm::vec3(0.0f);
+	glm::vec3 step = glm::vec3(0.0f); //size of one quantisation step along each axis
+	glm::vec3 inverseStep = glm::vec3(0.0f);
+};
+
+#endif
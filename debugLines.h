@@ -0,0 +1,99 @@
+#ifndef DEBUG_LINES_H
+#define DEBUG_LINES_H
+//-------------------------------------------------------------------------------------
+// Batched debug lines. Segments are collected on the CPU during the frame (already in
+// world space, so lines with different model matrices still share one batch) and
+// Flush() draws all of them with a single glDrawArrays(GL_LINES). The vertex buffer is
+// created once and kept: every flush orphans it (glBufferData with no data) before
+// writing, so the driver never has to wait on the previous frame's draw, and it only
+// grows when a frame has more lines than any frame before it.
+//-------------------------------------------------------------------------------------
+
+#include<GLAD\glad.h>
+#include<glm\glm.hpp>
+#include<glm\gtc\matrix_transform.hpp>
+
+#include<vector>
+#include<algorithm>
+#include "shader.h"
+
+class DebugLines
+{
+public:
+	//No GL work until the first flush, so it can be a member of things that get built headless
+	DebugLines() : VAO(0), VBO(0), capacity(0)
+	{
+	}
+
+	void AddLine(glm::vec3 from, glm::vec3 to)
+	{
+		vertices.push_back(from);
+		vertices.push_back(to);
+	}
+	void AddLine(glm::vec3 from, glm::vec3 to, const glm::mat4& model)
+	{
+		AddLine(glm::vec3(model * glm::vec4(from, 1.0f)), glm::vec3(model * glm::vec4(to, 1.0f)));
+	}
+	void AddRay(glm::vec3 origin, glm::vec3 direction, const glm::mat4& model)
+	{
+		AddLine(origin, origin + direction, model);
+	}
+
+	int LineCount() const { return (int)vertices.size() / 2; }
+
+	//Draws every line added since the last flush in one call and starts a new batch
+	void Flush(Shader& shader, const glm::mat4& view, const glm::mat4& projection)
+	{
+		if (vertices.empty())
+			return;
+		if (VAO == 0)
+			setupBuffers();
+
+		glBindVertexArray(VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		if (vertices.size() > capacity)
+			capacity = std::max(vertices.size(), capacity * 2);
+		glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(glm::vec3), nullptr, GL_STREAM_DRAW); //orphan last frame's storage
+		glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(glm::vec3), vertices.data());
+
+		shader.use();
+		shader.setMat4(modelUniform.get(shader), glm::mat4(1.0f)); //already in world space
+		shader.setMat4(viewUniform.get(shader), view);
+		shader.setMat4(projectionUniform.get(shader), projection);
+		glDrawArrays(GL_LINES, 0, (GLsizei)vertices.size());
+
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		vertices.clear(); //keeps the CPU side allocation for the next frame too
+	}
+
+	//Like the meshes, the buffers live as long as the context, call this to free them earlier
+	void Release()
+	{
+		if (VAO == 0)
+			return;
+		glDeleteVertexArrays(1, &VAO);
+		glDeleteBuffers(1, &VBO);
+		VAO = VBO = 0;
+		capacity = 0;
+	}
+
+private:
+	void setupBuffers()
+	{
+		glGenVertexArrays(1, &VAO);
+		glGenBuffers(1, &VBO);
+		glBindVertexArray(VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0); //position vertex attribute
+		glEnableVertexAttribArray(0);
+		glBindVertexArray(0);
+	}
+
+	std::vector<glm::vec3> vertices;
+	unsigned int VAO, VBO;
+	size_t capacity; //in vertices
+	UniformHandle modelUniform{ "model" }, viewUniform{ "view" }, projectionUniform{ "projection" };
+};
+
+#endif
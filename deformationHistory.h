@@ -0,0 +1,284 @@
+#ifndef DEFORMATION_HISTORY_H
+#define DEFORMATION_HISTORY_H
+//-------------------------------------------------------------------------------------
+// Recorded deformation of a mesh, so it can be rewound, reset to how it started or put
+// into the state of any recorded frame without reloading it. Every frame (simulation
+// step) stores only the vertices that moved, as an index and a displacement quantised to
+// 16 bits per axis with a per frame scale. The quantisation error is fed back into the
+// next frame of the vertex, so it doesn't add up over the frames.
+// Every keyframeInterval frames a keyframe stores the exact offsets from the pristine
+// mesh of every vertex moved so far. Going to a frame restores the vertices moved so far
+// to the keyframe before it and replays the deltas after it, so it costs in the order of
+// the moved vertices, not the mesh. When the history goes over its memory cap, the oldest
+// keyframe and its frames are dropped, the pristine mesh can always be restored.
+//-------------------------------------------------------------------------------------
+
+#include<glm\glm.hpp>
+
+#include<vector>
+#include<deque>
+#include<climits>
+#include<stdint.h>
+#include<math.h>
+#include<algorithm>
+#include "mesh.h"
+
+class DeformationHistory
+{
+public:
+	//Starts a new history with the current state of the vertices as the pristine mesh
+	void Begin(const std::vector<Vertex>& vertices, size_t memoryCap, int keyframeInterval)
+	{
+		this->memoryCap = memoryCap;
+		this->keyframeInterval = std::max(keyframeInterval, 1);
+		pristine.resize(vertices.size());
+		for (size_t i = 0; i < vertices.size(); i++)
+			pristine[i] = vertices[i].Position;
+		reconstructed = pristine;
+		isTouched.assign(vertices.size(), false);
+		touched.clear();
+		recordStamp.assign(vertices.size(), 0);
+		stamp = 0;
+		segments.clear();
+		segments.push_back(Segment());
+		segments.back().firstFrame = 0;
+		frameCount = 0;
+		currentFrame = 0;
+	}
+
+	//Begins again from the current state of the vertices, with the same cap and keyframe interval
+	void Restart(const std::vector<Vertex>& vertices)
+	{
+		Begin(vertices, memoryCap, keyframeInterval);
+	}
+
+	bool HasBegun() const { return !pristine.empty(); }
+	int FrameCount() const { return frameCount; } //the last recorded frame, frame 0 is the pristine mesh
+	int CurrentFrame() const { return currentFrame; }
+	int EarliestFrame() const { return segments.empty() ? 0 : segments.front().firstFrame; } //older ones went over the memory cap
+	const std::vector<int>& TouchedVerts() const { return touched; } //the only vertices Seek and RestorePristine move
+
+	//Records the next frame, moved lists the vertices that moved since the last one (duplicates are fine)
+	//If the history was rewound, the frames after the current one are dropped first
+	void Record(const std::vector<Vertex>& vertices, const std::vector<int>& moved)
+	{
+		if (!HasBegun())
+			return;
+		if (currentFrame < frameCount)
+			Truncate();
+
+		//the largest displacement of the frame sets its scale
+		stamp++;
+		float largest = 0.0f;
+		for (int vert : moved)
+		{
+			Touch(vert); //even if it didn't move by a whole step, so restoring puts it back exactly
+			glm::vec3 offset = vertices[vert].Position - reconstructed[vert];
+			largest = fmaxf(largest, fmaxf(fmaxf(fabsf(offset.x), fabsf(offset.y)), fabsf(offset.z)));
+		}
+		Segment& segment = segments.back();
+		FrameDelta frame;
+		frame.firstEntry = (int)segment.indices.size();
+		frame.scale = largest / 32767.0f;
+		if (largest > 0.0f)
+		{
+			float inverseScale = 1.0f / frame.scale;
+			for (int vert : moved)
+			{
+				if (recordStamp[vert] == stamp)
+					continue;
+				recordStamp[vert] = stamp;
+				glm::vec3 offset = (vertices[vert].Position - reconstructed[vert]) * inverseScale;
+				int16_t quantised[3] = { Quantise(offset.x), Quantise(offset.y), Quantise(offset.z) };
+				if (quantised[0] == 0 && quantised[1] == 0 && quantised[2] == 0)
+					continue;
+				segment.indices.push_back(vert);
+				segment.values.insert(segment.values.end(), quantised, quantised + 3);
+				reconstructed[vert] += glm::vec3(quantised[0], quantised[1], quantised[2]) * frame.scale;
+			}
+		}
+		frame.entryCount = (int)segment.indices.size() - frame.firstEntry;
+		segment.frames.push_back(frame);
+		frameCount++;
+		currentFrame = frameCount;
+
+		if (frameCount % keyframeInterval == 0)
+			AddKeyframe(vertices);
+		EnforceMemoryCap();
+	}
+
+	//Puts the vertices into the state of the given frame (clamped to the recorded ones)
+	//first and last get the range of vertices that may have changed, returns false if none could have
+	bool Seek(std::vector<Vertex>& vertices, int frame, int& first, int& last)
+	{
+		if (!HasBegun() || touched.empty())
+			return false;
+		frame = std::min(std::max(frame, EarliestFrame()), frameCount);
+
+		int s = (int)segments.size() - 1;
+		while (s > 0 && segments[s].firstFrame > frame)
+			s--;
+		const Segment& segment = segments[s];
+		for (int vert : touched)
+			vertices[vert].Position = pristine[vert];
+		for (size_t k = 0; k < segment.keyIndices.size(); k++)
+			vertices[segment.keyIndices[k]].Position = pristine[segment.keyIndices[k]] + segment.keyOffsets[k];
+		for (int f = 0; f < frame - segment.firstFrame; f++)
+		{
+			const FrameDelta& delta = segment.frames[f];
+			for (int e = delta.firstEntry; e < delta.firstEntry + delta.entryCount; e++)
+			{
+				const int16_t* quantised = &segment.values[3 * e];
+				vertices[segment.indices[e]].Position += glm::vec3(quantised[0], quantised[1], quantised[2]) * delta.scale;
+			}
+		}
+		currentFrame = frame;
+		TouchedRange(first, last);
+		return true;
+	}
+
+	//Puts every moved vertex back where it started, the history is kept (Seek can go back to any frame)
+	bool RestorePristine(std::vector<Vertex>& vertices, int& first, int& last)
+	{
+		if (!HasBegun() || touched.empty())
+			return false;
+		for (int vert : touched)
+			vertices[vert].Position = pristine[vert];
+		currentFrame = 0;
+		TouchedRange(first, last);
+		return true;
+	}
+
+	//Deltas and keyframes, roughly what counts towards the memory cap
+	size_t MemoryBytes() const
+	{
+		size_t bytes = 0;
+		for (const Segment& segment : segments)
+			bytes += segment.Bytes();
+		return bytes;
+	}
+
+private:
+	struct FrameDelta
+	{
+		int firstEntry; //into the segment's indices (and values, three per entry)
+		int entryCount;
+		float scale; //world units per quantisation step
+	};
+
+	//A keyframe and the frames after it, up to the next keyframe
+	struct Segment
+	{
+		int firstFrame = 0; //the frame of the keyframe
+		std::vector<int> keyIndices; //every vertex moved so far, and its exact offset from the pristine mesh
+		std::vector<glm::vec3> keyOffsets;
+		std::vector<FrameDelta> frames; //frames[i] takes firstFrame + i to firstFrame + i + 1
+		std::vector<int> indices;
+		std::vector<int16_t> values;
+
+		size_t Bytes() const
+		{
+			return keyIndices.size() * sizeof(int) + keyOffsets.size() * sizeof(glm::vec3) + frames.size() * sizeof(FrameDelta) +
+				indices.size() * sizeof(int) + values.size() * sizeof(int16_t);
+		}
+	};
+
+	static int16_t Quantise(float value)
+	{
+		return (int16_t)std::max(-32767.0f, std::min(32767.0f, roundf(value)));
+	}
+
+	void Touch(int vert)
+	{
+		if (isTouched[vert])
+			return;
+		isTouched[vert] = true;
+		touched.push_back(vert);
+	}
+
+	void TouchedRange(int& first, int& last) const
+	{
+		first = INT_MAX;
+		last = -1;
+		for (int vert : touched)
+		{
+			first = std::min(first, vert);
+			last = std::max(last, vert);
+		}
+	}
+
+	//Exact state of the latest frame, which the deltas after it build on
+	void AddKeyframe(const std::vector<Vertex>& vertices)
+	{
+		Segment segment;
+		segment.firstFrame = frameCount;
+		segment.keyIndices = touched;
+		segment.keyOffsets.resize(touched.size());
+		for (size_t k = 0; k < touched.size(); k++)
+		{
+			int vert = touched[k];
+			segment.keyOffsets[k] = vertices[vert].Position - pristine[vert];
+			reconstructed[vert] = pristine[vert] + segment.keyOffsets[k];
+		}
+		segments.push_back(std::move(segment));
+	}
+
+	//Drops the frames after the current one, called when recording goes on from a rewound state
+	void Truncate()
+	{
+		if (currentFrame < EarliestFrame()) //only after RestorePristine, frame 0 is a plain start again
+		{
+			segments.clear();
+			segments.push_back(Segment());
+		}
+		while (segments.size() > 1 && segments.back().firstFrame > currentFrame)
+			segments.pop_back();
+		Segment& segment = segments.back();
+		int keep = currentFrame - segment.firstFrame;
+		if (keep < (int)segment.frames.size())
+		{
+			int entries = keep > 0 ? segment.frames[keep - 1].firstEntry + segment.frames[keep - 1].entryCount : 0;
+			segment.frames.resize(keep);
+			segment.indices.resize(entries);
+			segment.values.resize(3 * entries);
+		}
+		frameCount = currentFrame;
+		//recording goes on from the state the vertices were rewound to, which is exactly what replaying gives
+		for (int vert : touched)
+			reconstructed[vert] = pristine[vert];
+		for (size_t k = 0; k < segment.keyIndices.size(); k++)
+			reconstructed[segment.keyIndices[k]] = pristine[segment.keyIndices[k]] + segment.keyOffsets[k];
+		for (const FrameDelta& delta : segment.frames)
+		{
+			for (int e = delta.firstEntry; e < delta.firstEntry + delta.entryCount; e++)
+			{
+				const int16_t* quantised = &segment.values[3 * e];
+				reconstructed[segment.indices[e]] += glm::vec3(quantised[0], quantised[1], quantised[2]) * delta.scale;
+			}
+		}
+	}
+
+	void EnforceMemoryCap()
+	{
+		size_t bytes = MemoryBytes();
+		while (bytes > memoryCap && segments.size() > 1)
+		{
+			bytes -= segments.front().Bytes();
+			segments.pop_front();
+		}
+	}
+
+	size_t memoryCap = 0;
+	int keyframeInterval = 1;
+	std::vector<glm::vec3> pristine; //positions at Begin
+	std::vector<glm::vec3> reconstructed; //positions replaying the recorded frames gives, the next deltas are taken from these
+	std::vector<bool> isTouched;
+	std::vector<int> touched; //every vertex moved since Begin
+	std::vector<unsigned int> recordStamp; //per vertex, the last Record that stored it
+	unsigned int stamp = 0;
+	std::deque<Segment> segments;
+	int frameCount = 0;
+	int currentFrame = 0;
+};
+
+#endif
@@ -0,0 +1,306 @@
+#ifndef EXPORT_THREAD_H
+#define EXPORT_THREAD_H
+//-------------------------------------------------------------------------------------
+// Export stage of a run, writes the deformed target for tools outside the app (formats
+// in meshExport.h) on a background thread, so file I/O never holds up the simulation.
+// The final mesh goes out as PLY and/or OBJ once nothing changes it anymore. Optionally
+// every simulation step also goes into a displacement stream, relative to the rest mesh
+// (which is written next to it).
+// Frames are double buffered: the simulation thread copies the moved vertices of a step
+// into its back buffer and swaps it with the front one whenever the writer is done with
+// that, the lock is only held for checking on the writer and swapping. While it's busy the frames
+// keep piling up in the back buffer, nothing is dropped and nothing waits. Once the
+// stream ends the writer takes what's left in the back buffer itself, then reads the
+// stream back and checks it decodes to the offsets it was given.
+//-------------------------------------------------------------------------------------
+
+#include<glm\glm.hpp>
+
+#include<string>
+#include<vector>
+#include<deque>
+#include<mutex>
+#include<condition_variable>
+#include<thread>
+#include "mesh.h"
+#include "meshExport.h"
+#include "logger.h"
+
+struct ExportSettings
+{
+	std::string basePath = "deformed_target"; //files are this plus _final.ply, _final.obj, _rest.ply and _displacement.bin
+	bool writePly = true;
+	bool writeObj = false;
+	bool streamDisplacements = false;
+	int framesPerChunk = 64; //of the displacement stream, a chunk is the smallest part a reader can decode on its own
+	bool verifyStream = true; //read the closed stream back and compare every vertex's last offset with what was captured
+};
+
+class ExportThread
+{
+public:
+	ExportThread(const ExportSettings& settings) : settings(settings)
+	{
+		writer = std::thread(&ExportThread::WriterLoop, this);
+	}
+	~ExportThread()
+	{
+		Finish();
+	}
+
+	//Before the first frame is captured, the mesh as it is now is the rest mesh the displacements are relative to
+	//Does nothing unless the settings stream displacements
+	void BeginStream(const Mesh& mesh, float frameTime)
+	{
+		if (!settings.streamDisplacements)
+			return;
+		rest.resize(mesh.vertices.size());
+		for (size_t i = 0; i < mesh.vertices.size(); i++)
+			rest[i] = mesh.vertices[i].Position;
+		captureStamp.assign(rest.size(), 0);
+		std::lock_guard<std::mutex> lock(mutex);
+		streamPath = settings.basePath + "_displacement.bin";
+		if (!stream.Open(streamPath, (int)rest.size(), frameTime))
+			LOG_ERROR("Couldn't open " << streamPath << " for the displacement stream");
+		streamedOffsets.assign(rest.size(), glm::vec3(0.0f));
+		largestOffset = 0.0f;
+		meshJobs.push_back(MeshJob{ settings.basePath + "_rest", rest, mesh.indices, true, false });
+		pending.notify_one();
+	}
+
+	//Simulation thread, after every step, moved lists the vertices the step moved (duplicates are fine)
+	void CaptureFrame(const std::vector<Vertex>& vertices, const std::vector<int>& moved)
+	{
+		if (rest.empty())
+			return;
+		captureFrame++;
+		back.frameStart.push_back((int)back.indices.size());
+		for (int vert : moved)
+		{
+			if (captureStamp[vert] == captureFrame)
+				continue;
+			captureStamp[vert] = captureFrame;
+			back.indices.push_back(vert);
+			back.offsets.push_back(vertices[vert].Position - rest[vert]);
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!frontReady)
+		{
+			std::swap(back, front);
+			frontReady = true;
+			pending.notify_one();
+		}
+	}
+
+	//Queues the mesh as it is now for writing, call it once nothing changes it anymore (the simulation is done)
+	void ExportMesh(const Mesh& mesh)
+	{
+		MeshJob job{ settings.basePath + "_final", std::vector<glm::vec3>(mesh.vertices.size()), mesh.indices, settings.writePly, settings.writeObj };
+		for (size_t i = 0; i < mesh.vertices.size(); i++)
+			job.positions[i] = mesh.vertices[i].Position;
+		std::lock_guard<std::mutex> lock(mutex);
+		meshJobs.push_back(std::move(job));
+		pending.notify_one();
+	}
+
+	//No more frames are coming (the simulation is done), the writer takes the ones still in the back buffer and closes the stream
+	//Doesn't wait for any of it
+	void EndStream()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		streamEnded = true;
+		pending.notify_one();
+	}
+
+	//Ends the stream, writes out everything still pending and stops the thread, blocks until it's done
+	void Finish()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if (!writer.joinable())
+			return;
+		streamEnded = true;
+		stopping = true;
+		lock.unlock();
+		pending.notify_one();
+		writer.join();
+	}
+
+private:
+	//Frames one after the other, the records of frame f are from frameStart[f] up to the next one's start
+	struct FrameBatch
+	{
+		std::vector<int> frameStart;
+		std::vector<int> indices;
+		std::vector<glm::vec3> offsets;
+
+		void Clear()
+		{
+			frameStart.clear();
+			indices.clear();
+			offsets.clear();
+		}
+	};
+
+	struct MeshJob
+	{
+		std::string basePath;
+		std::vector<glm::vec3> positions;
+		std::vector<unsigned int> indices;
+		bool ply, obj;
+	};
+
+	void WriterLoop()
+	{
+		std::vector<MeshExport::DisplacementFrame> chunk;
+		std::vector<std::pair<int, glm::vec3>> sortScratch;
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true)
+		{
+			pending.wait(lock, [this] { return frontReady || !meshJobs.empty() || (streamEnded && stream.IsOpen()) || stopping; });
+			if (!meshJobs.empty())
+			{
+				MeshJob job = std::move(meshJobs.front());
+				meshJobs.pop_front();
+				lock.unlock();
+				WriteMesh(job);
+				lock.lock();
+				continue;
+			}
+			if (!frontReady && streamEnded && !back.frameStart.empty()) //capturing is over, the back buffer is the writer's now
+			{
+				std::swap(back, front);
+				frontReady = true;
+			}
+			if (frontReady)
+			{
+				//the front buffer is the writer's until frontReady goes back to false
+				lock.unlock();
+				AppendFrames(front, chunk, sortScratch);
+				front.Clear();
+				lock.lock();
+				frontReady = false;
+				continue;
+			}
+			if (streamEnded && stream.IsOpen())
+			{
+				lock.unlock();
+				CloseStream(chunk);
+				lock.lock();
+				continue;
+			}
+			break; //stopping, and nothing left
+		}
+	}
+
+	void CloseStream(std::vector<MeshExport::DisplacementFrame>& chunk)
+	{
+		if (!chunk.empty())
+			stream.WriteChunk(chunk);
+		chunk.clear();
+		if (stream.Close())
+		{
+			LOG_INFO("Displacement stream written: " << stream.FramesWritten() << " frames, " << stream.EncodedBytes() << " bytes ("
+				<< stream.RawBytes() << " as plain records)");
+			if (settings.verifyStream)
+				VerifyStream();
+		}
+		else
+			LOG_ERROR("Writing the displacement stream failed");
+	}
+
+	//Decodes the stream and checks every vertex ends up where the frames put it, give or take a quantisation step
+	void VerifyStream()
+	{
+		MeshExport::DisplacementStream decoded;
+		if (!MeshExport::ReadDisplacementStream(streamPath, decoded) || decoded.vertexCount != (int)streamedOffsets.size() ||
+			(int)decoded.frames.size() != stream.FramesWritten())
+		{
+			LOG_ERROR("The displacement stream " << streamPath << " doesn't read back");
+			return;
+		}
+		std::vector<glm::vec3> offsets(decoded.vertexCount, glm::vec3(0.0f));
+		for (const MeshExport::DisplacementFrame& frame : decoded.frames)
+		{
+			for (size_t r = 0; r < frame.indices.size(); r++)
+				offsets[frame.indices[r]] = frame.offsets[r];
+		}
+		float largestError = 0.0f;
+		for (size_t i = 0; i < offsets.size(); i++)
+		{
+			glm::vec3 error = glm::abs(offsets[i] - streamedOffsets[i]);
+			largestError = fmaxf(largestError, fmaxf(fmaxf(error.x, error.y), error.z));
+		}
+		float allowed = largestOffset / 32767.0f; //a whole step of the coarsest chunk, rounding takes at most half
+		if (largestError > allowed)
+			LOG_ERROR("The displacement stream " << streamPath << " decodes up to " << largestError << " off, more than " << allowed);
+		else
+			LOG_INFO("Displacement stream read back, at most " << largestError << " off");
+	}
+
+	void AppendFrames(FrameBatch& batch, std::vector<MeshExport::DisplacementFrame>& chunk, std::vector<std::pair<int, glm::vec3>>& sortScratch)
+	{
+		for (size_t f = 0; f < batch.frameStart.size(); f++)
+		{
+			int first = batch.frameStart[f];
+			int last = f + 1 < batch.frameStart.size() ? batch.frameStart[f + 1] : (int)batch.indices.size();
+			MeshExport::DisplacementFrame frame;
+			frame.indices.assign(batch.indices.begin() + first, batch.indices.begin() + last);
+			frame.offsets.assign(batch.offsets.begin() + first, batch.offsets.begin() + last);
+			MeshExport::SortFrame(frame, sortScratch);
+			for (size_t r = 0; r < frame.indices.size(); r++)
+			{
+				glm::vec3 offset = frame.offsets[r];
+				streamedOffsets[frame.indices[r]] = offset;
+				largestOffset = fmaxf(largestOffset, fmaxf(fmaxf(fabsf(offset.x), fabsf(offset.y)), fabsf(offset.z)));
+			}
+			chunk.push_back(std::move(frame));
+			if (chunk.size() >= settings.framesPerChunk)
+			{
+				stream.WriteChunk(chunk);
+				chunk.clear();
+			}
+		}
+	}
+
+	void WriteMesh(const MeshJob& job)
+	{
+		if (job.ply)
+		{
+			if (MeshExport::WritePly(job.basePath + ".ply", job.positions, job.indices))
+				LOG_INFO("Exported " << job.basePath << ".ply");
+			else
+				LOG_ERROR("Couldn't write " << job.basePath << ".ply");
+		}
+		if (job.obj)
+		{
+			if (MeshExport::WriteObj(job.basePath + ".obj", job.positions, job.indices))
+				LOG_INFO("Exported " << job.basePath << ".obj");
+			else
+				LOG_ERROR("Couldn't write " << job.basePath << ".obj");
+		}
+	}
+
+	ExportSettings settings;
+
+	//Simulation thread only, until the stream ends
+	std::vector<glm::vec3> rest;
+	std::vector<unsigned int> captureStamp; //per vertex, the last frame it was captured in
+	unsigned int captureFrame = 0;
+	FrameBatch back;
+
+	std::mutex mutex;
+	std::condition_variable pending; //writer waits on it for work
+	FrameBatch front; //the writer's while frontReady is set
+	bool frontReady = false;
+	bool streamEnded = false;
+	std::deque<MeshJob> meshJobs;
+	bool stopping = false;
+	MeshExport::DisplacementStreamWriter stream; //opened by BeginStream, then the writer's
+	std::string streamPath;
+	std::vector<glm::vec3> streamedOffsets; //writer's, every vertex's latest offset that went into the stream
+	float largestOffset = 0.0f;
+	std::thread writer;
+};
+
+#endif
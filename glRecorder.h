@@ -0,0 +1,499 @@
+#ifndef GL_RECORDER_H
+#define GL_RECORDER_H
+//-------------------------------------------------------------------------------------
+// Recording GL backend. glad dispatches every gl* call through a function pointer
+// (glBufferData is glad_glBufferData), Install() swaps those pointers for recording
+// ones, so the rest of the code runs unchanged. Every call is counted per entry point,
+// uploads are counted in bytes, and buffer contents are captured per buffer object.
+// With forwardToDriver the calls still reach the real driver (after gladLoadGLLoader),
+// without it no context is needed at all: object names are handed out by the recorder
+// and shader compiles/links report success, so meshes, shaders and text can be set up
+// and drawn headless. The recorded command stream can be written out and diffed
+// between two builds. GL is single threaded, so is this.
+//-------------------------------------------------------------------------------------
+
+#ifndef DEFORM_GL_RECORDING
+#define DEFORM_GL_RECORDING 0 //the app records its own GL calls when built with this set to 1
+#endif
+
+#include<GLAD\glad.h>
+
+#include<string>
+#include<vector>
+#include<map>
+#include<unordered_map>
+#include<functional>
+#include<sstream>
+#include<fstream>
+#include<iostream>
+#include<type_traits>
+#include<string.h>
+#include "logger.h"
+
+template<typename Tag, typename Proc> struct GLHook;
+
+class GLRecorder
+{
+public:
+	struct EntryStats
+	{
+		long long calls = 0;
+		long long bytes = 0; //uploaded bytes, only for the buffer and texture uploads
+	};
+
+	static GLRecorder& Get()
+	{
+		static GLRecorder recorder;
+		return recorder;
+	}
+
+	//Replaces every gl* entry point the app uses with a recording one
+	void Install(bool forwardToDriver);
+
+	//Puts glad's own pointers back
+	void Uninstall()
+	{
+		for (auto& restore : restorers)
+			restore();
+		restorers.clear();
+	}
+
+	bool IsForwarding() const { return forwarding; }
+
+	//Clears the counters and the command stream, captured buffer contents stay (they are still what the buffers hold)
+	void Reset()
+	{
+		stats.clear();
+		commands.clear();
+	}
+
+	//Keeps the text of every call, off by default since big scenes make a lot of them
+	void SetCommandRecording(bool enabled) { recordCommands = enabled; }
+	//Keeps a copy of everything uploaded into buffers, on by default
+	void SetBufferCapture(bool enabled) { captureBuffers = enabled; }
+
+	EntryStats Stats(const std::string& entry) const
+	{
+		EntryStats total;
+		for (auto& entryStats : stats)
+		{
+			if (entry == entryStats.first)
+			{
+				total.calls += entryStats.second.calls;
+				total.bytes += entryStats.second.bytes;
+			}
+		}
+		return total;
+	}
+
+	//All entry points called since the last Reset, by name
+	std::map<std::string, EntryStats> AllStats() const
+	{
+		std::map<std::string, EntryStats> byName;
+		for (auto& entryStats : stats)
+		{
+			byName[entryStats.first].calls += entryStats.second.calls;
+			byName[entryStats.first].bytes += entryStats.second.bytes;
+		}
+		return byName;
+	}
+
+	//glBufferData, glBufferSubData, glTexImage2D and glTexSubImage2D
+	long long UploadCalls() const
+	{
+		return Stats("glBufferData").calls + Stats("glBufferSubData").calls + Stats("glTexImage2D").calls + Stats("glTexSubImage2D").calls;
+	}
+	long long UploadBytes() const
+	{
+		return Stats("glBufferData").bytes + Stats("glBufferSubData").bytes + Stats("glTexImage2D").bytes + Stats("glTexSubImage2D").bytes;
+	}
+	long long DrawCalls() const
+	{
+		return Stats("glDrawArrays").calls + Stats("glDrawElements").calls + Stats("glDrawArraysInstanced").calls;
+	}
+	long long TotalCalls() const
+	{
+		long long calls = 0;
+		for (auto& entryStats : stats)
+			calls += entryStats.second.calls;
+		return calls;
+	}
+
+	//One line per call, name and arguments, pointers only as null/non null so runs can be diffed
+	const std::vector<std::string>& Commands() const { return commands; }
+
+	bool WriteCommands(const std::string& path) const
+	{
+		std::ofstream out(path);
+		if (!out)
+		{
+			LOG_ERROR("Couldn't open " << path << " for writing the GL commands");
+			return false;
+		}
+		for (const std::string& command : commands)
+			out << command << "\n";
+		return true;
+	}
+
+	void PrintStats(std::ostream& out) const
+	{
+		out << "GL: " << TotalCalls() << " calls, " << DrawCalls() << " draws, " << UploadCalls() << " uploads of " << UploadBytes() << " bytes";
+		for (auto& entryStats : AllStats())
+		{
+			out << "\n  " << entryStats.first << ": " << entryStats.second.calls;
+			if (entryStats.second.bytes > 0)
+				out << " calls, " << entryStats.second.bytes << " bytes";
+		}
+	}
+
+	//What the buffer holds according to the uploads, nullptr if nothing was uploaded into it
+	const std::vector<unsigned char>* BufferContents(GLuint buffer) const
+	{
+		auto found = bufferContents.find(buffer);
+		return found == bufferContents.end() ? nullptr : &found->second;
+	}
+
+	//Called by the hooks
+	template<typename... Args>
+	void Record(const char* entry, long long bytes, Args... args)
+	{
+		EntryStats& entryStats = stats[entry];
+		entryStats.calls++;
+		entryStats.bytes += bytes;
+		if (recordCommands)
+		{
+			std::ostringstream command;
+			command << entry << "(";
+			AppendArgs(command, args...);
+			command << ")";
+			commands.push_back(command.str());
+		}
+	}
+
+private:
+	template<typename Tag, typename Proc> friend struct GLHook;
+
+	GLRecorder() {}
+
+	static void AppendArgs(std::ostringstream&) {}
+	template<typename T, typename... Rest>
+	static void AppendArgs(std::ostringstream& out, T arg, Rest... rest)
+	{
+		AppendArg(out, arg);
+		if (sizeof...(rest) > 0)
+			out << ", ";
+		AppendArgs(out, rest...);
+	}
+	template<typename T>
+	static typename std::enable_if<std::is_arithmetic<T>::value>::type AppendArg(std::ostringstream& out, T arg) { out << +arg; }
+	template<typename T>
+	static void AppendArg(std::ostringstream& out, T* arg) { out << (arg ? "ptr" : "null"); }
+	static void AppendArg(std::ostringstream& out, const GLchar* arg) { out << "\"" << (arg ? arg : "") << "\""; } //uniform names
+
+	template<typename Tag, typename Proc>
+	void Hook(Proc& slot, Proc replacement)
+	{
+		typedef GLHook<Tag, Proc> HookType;
+		HookType::Original() = slot;
+		slot = replacement;
+		restorers.push_back([&slot]() { slot = HookType::Original(); });
+	}
+
+	static int BytesPerPixel(GLenum format, GLenum type)
+	{
+		int components = format == GL_RED ? 1 : format == GL_RGB ? 3 : 4;
+		int componentSize = type == GL_UNSIGNED_BYTE ? 1 : type == GL_UNSIGNED_SHORT || type == GL_HALF_FLOAT ? 2 : 4;
+		return components * componentSize;
+	}
+
+	GLuint& BoundBuffer(GLenum target)
+	{
+		//the element array binding is part of the vertex array object
+		if (target == GL_ELEMENT_ARRAY_BUFFER)
+			return elementBindings[boundVertexArray];
+		return bufferBindings[target];
+	}
+
+	void CaptureUpload(GLenum target, GLintptr offset, GLsizeiptr size, const void* data, bool reallocate)
+	{
+		if (!captureBuffers)
+			return;
+		std::vector<unsigned char>& contents = bufferContents[BoundBuffer(target)];
+		if (reallocate)
+			contents.assign(size, 0);
+		else if (contents.size() < offset + size)
+			contents.resize(offset + size, 0); //out of range in real GL, kept so nothing is lost
+		if (data != nullptr)
+			memcpy(contents.data() + offset, data, size);
+	}
+
+	GLuint NewName() { return nextName++; }
+
+	//Replacements for the entry points that need more than a count
+	static void APIENTRY GenBuffers(GLsizei n, GLuint* buffers);
+	static void APIENTRY GenVertexArrays(GLsizei n, GLuint* arrays);
+	static void APIENTRY GenTextures(GLsizei n, GLuint* textures);
+	static GLuint APIENTRY CreateShader(GLenum type);
+	static GLuint APIENTRY CreateProgram();
+	static void APIENTRY DeleteBuffers(GLsizei n, const GLuint* buffers);
+	static void APIENTRY BindBuffer(GLenum target, GLuint buffer);
+	static void APIENTRY BindVertexArray(GLuint array);
+	static void APIENTRY BufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage);
+	static void APIENTRY BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data);
+	static void APIENTRY TexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border,
+		GLenum format, GLenum type, const void* pixels);
+	static void APIENTRY TexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height,
+		GLenum format, GLenum type, const void* pixels);
+	static void APIENTRY GetShaderiv(GLuint shader, GLenum pname, GLint* params);
+	static void APIENTRY GetProgramiv(GLuint program, GLenum pname, GLint* params);
+	static void APIENTRY GetShaderInfoLog(GLuint shader, GLsizei bufSize, GLsizei* length, GLchar* infoLog);
+	static void APIENTRY GetProgramInfoLog(GLuint program, GLsizei bufSize, GLsizei* length, GLchar* infoLog);
+	static GLint APIENTRY GetUniformLocation(GLuint program, const GLchar* name);
+
+	bool forwarding = false;
+	bool recordCommands = false;
+	bool captureBuffers = true;
+	std::unordered_map<const char*, EntryStats> stats; //entry names are literals, keyed by pointer and merged by name when read
+	std::vector<std::string> commands;
+	std::vector<std::function<void()>> restorers;
+	std::map<GLuint, std::vector<unsigned char>> bufferContents;
+	std::map<GLenum, GLuint> bufferBindings;
+	std::map<GLuint, GLuint> elementBindings; //by vertex array object
+	GLuint boundVertexArray = 0;
+	GLuint nextName = 1; //headless object names
+	std::map<std::string, GLint> uniformLocations; //headless uniform locations, by program and name
+};
+
+//One per entry point: keeps the driver's function and records the call before passing it on
+template<typename Tag, typename R, typename... Args>
+struct GLHook<Tag, R (APIENTRYP)(Args...)>
+{
+	typedef R (APIENTRYP Proc)(Args...);
+
+	static Proc& Original()
+	{
+		static Proc original = nullptr;
+		return original;
+	}
+
+	//Calls the driver when forwarding, otherwise does nothing and returns 0
+	static R Forward(Args... args)
+	{
+		if (GLRecorder::Get().forwarding && Original() != nullptr)
+			return Original()(args...);
+		return R();
+	}
+
+	static R APIENTRY Counted(Args... args)
+	{
+		GLRecorder::Get().Record(Tag::Name(), 0, args...);
+		return Forward(args...);
+	}
+};
+
+#define GL_RECORDER_TAG(entry) struct entry##Tag { static const char* Name() { return #entry; } };
+//Only ever used directly, an entry passed in from another macro would already be expanded to glad_gl*
+#define GL_RECORDER_HOOK(entry) GLHook<entry##Tag, decltype(glad_##entry)>
+
+//Every entry point the app calls, hooked ones get recorded
+#define GL_RECORDER_ENTRIES(X) \
+	X(glActiveTexture) X(glAttachShader) X(glBindBuffer) X(glBindBufferBase) X(glBindBufferRange) X(glBindTexture) \
+	X(glBindVertexArray) X(glBlendFunc) X(glBufferData) X(glBufferSubData) X(glClear) X(glClearColor) X(glCompileShader) \
+	X(glCreateProgram) X(glCreateShader) X(glCullFace) X(glDeleteBuffers) X(glDeleteProgram) X(glDeleteShader) \
+	X(glDeleteTextures) X(glDeleteVertexArrays) X(glDepthMask) X(glDrawArrays) X(glDrawArraysInstanced) X(glDrawElements) \
+	X(glEnable) X(glEnableVertexAttribArray) X(glFrontFace) X(glGenBuffers) X(glGenTextures) X(glGenVertexArrays) \
+	X(glGenerateMipmap) X(glGetActiveUniform) X(glGetProgramInfoLog) X(glGetProgramiv) X(glGetShaderInfoLog) X(glGetShaderiv) \
+	X(glGetUniformBlockIndex) X(glGetUniformLocation) X(glLinkProgram) X(glPixelStorei) X(glPolygonMode) X(glShaderSource) X(glStencilFunc) \
+	X(glStencilMask) X(glStencilOp) X(glTexImage2D) X(glTexParameteri) X(glTexSubImage2D) X(glUniform1f) X(glUniform1i) \
+	X(glUniform2f) X(glUniform2fv) X(glUniform3f) X(glUniform3fv) X(glUniform4f) X(glUniform4fv) X(glUniformBlockBinding) X(glUniformMatrix2fv) \
+	X(glUniformMatrix3fv) X(glUniformMatrix4fv) X(glUseProgram) X(glVertexAttribPointer) X(glViewport)
+
+GL_RECORDER_ENTRIES(GL_RECORDER_TAG)
+
+inline void GLRecorder::Install(bool forwardToDriver)
+{
+	Uninstall();
+	forwarding = forwardToDriver;
+#define GL_RECORDER_COUNTED(entry) Hook<entry##Tag>(glad_##entry, &GLHook<entry##Tag, decltype(glad_##entry)>::Counted);
+	GL_RECORDER_ENTRIES(GL_RECORDER_COUNTED)
+#undef GL_RECORDER_COUNTED
+	//the ones that need more than a count replace their counted version
+#define GL_RECORDER_REPLACE(entry, replacement) glad_##entry = &replacement;
+	GL_RECORDER_REPLACE(glGenBuffers, GenBuffers)
+	GL_RECORDER_REPLACE(glGenVertexArrays, GenVertexArrays)
+	GL_RECORDER_REPLACE(glGenTextures, GenTextures)
+	GL_RECORDER_REPLACE(glCreateShader, CreateShader)
+	GL_RECORDER_REPLACE(glCreateProgram, CreateProgram)
+	GL_RECORDER_REPLACE(glDeleteBuffers, DeleteBuffers)
+	GL_RECORDER_REPLACE(glBindBuffer, BindBuffer)
+	GL_RECORDER_REPLACE(glBindVertexArray, BindVertexArray)
+	GL_RECORDER_REPLACE(glBufferData, BufferData)
+	GL_RECORDER_REPLACE(glBufferSubData, BufferSubData)
+	GL_RECORDER_REPLACE(glTexImage2D, TexImage2D)
+	GL_RECORDER_REPLACE(glTexSubImage2D, TexSubImage2D)
+	GL_RECORDER_REPLACE(glGetShaderiv, GetShaderiv)
+	GL_RECORDER_REPLACE(glGetProgramiv, GetProgramiv)
+	GL_RECORDER_REPLACE(glGetShaderInfoLog, GetShaderInfoLog)
+	GL_RECORDER_REPLACE(glGetProgramInfoLog, GetProgramInfoLog)
+	GL_RECORDER_REPLACE(glGetUniformLocation, GetUniformLocation)
+#undef GL_RECORDER_REPLACE
+}
+
+//Object creation: the driver's names when forwarding, the recorder's own otherwise
+#define GL_RECORDER_GEN(function, entry, names) \
+	inline void APIENTRY GLRecorder::function(GLsizei n, GLuint* names) \
+	{ \
+		GLRecorder& recorder = Get(); \
+		recorder.Record(entry##Tag::Name(), 0, n, names); \
+		if (recorder.forwarding) \
+			GLHook<entry##Tag, decltype(glad_##entry)>::Forward(n, names); \
+		else \
+			for (GLsizei i = 0; i < n; i++) \
+				names[i] = recorder.NewName(); \
+	}
+GL_RECORDER_GEN(GenBuffers, glGenBuffers, buffers)
+GL_RECORDER_GEN(GenVertexArrays, glGenVertexArrays, arrays)
+GL_RECORDER_GEN(GenTextures, glGenTextures, textures)
+#undef GL_RECORDER_GEN
+
+inline GLuint APIENTRY GLRecorder::CreateShader(GLenum type)
+{
+	GLRecorder& recorder = Get();
+	recorder.Record(glCreateShaderTag::Name(), 0, type);
+	return recorder.forwarding ? GL_RECORDER_HOOK(glCreateShader)::Forward(type) : recorder.NewName();
+}
+
+inline GLuint APIENTRY GLRecorder::CreateProgram()
+{
+	GLRecorder& recorder = Get();
+	recorder.Record(glCreateProgramTag::Name(), 0);
+	return recorder.forwarding ? GL_RECORDER_HOOK(glCreateProgram)::Forward() : recorder.NewName();
+}
+
+inline void APIENTRY GLRecorder::DeleteBuffers(GLsizei n, const GLuint* buffers)
+{
+	GLRecorder& recorder = Get();
+	recorder.Record(glDeleteBuffersTag::Name(), 0, n, buffers);
+	for (GLsizei i = 0; i < n; i++)
+		recorder.bufferContents.erase(buffers[i]);
+	GL_RECORDER_HOOK(glDeleteBuffers)::Forward(n, buffers);
+}
+
+inline void APIENTRY GLRecorder::BindBuffer(GLenum target, GLuint buffer)
+{
+	GLRecorder& recorder = Get();
+	recorder.Record(glBindBufferTag::Name(), 0, target, buffer);
+	recorder.BoundBuffer(target) = buffer;
+	GL_RECORDER_HOOK(glBindBuffer)::Forward(target, buffer);
+}
+
+inline void APIENTRY GLRecorder::BindVertexArray(GLuint array)
+{
+	GLRecorder& recorder = Get();
+	recorder.Record(glBindVertexArrayTag::Name(), 0, array);
+	recorder.boundVertexArray = array;
+	GL_RECORDER_HOOK(glBindVertexArray)::Forward(array);
+}
+
+inline void APIENTRY GLRecorder::BufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+{
+	GLRecorder& recorder = Get();
+	recorder.Record(glBufferDataTag::Name(), data != nullptr ? size : 0, target, size, data, usage);
+	recorder.CaptureUpload(target, 0, size, data, true);
+	GL_RECORDER_HOOK(glBufferData)::Forward(target, size, data, usage);
+}
+
+inline void APIENTRY GLRecorder::BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+{
+	GLRecorder& recorder = Get();
+	recorder.Record(glBufferSubDataTag::Name(), size, target, offset, size, data);
+	recorder.CaptureUpload(target, offset, size, data, false);
+	GL_RECORDER_HOOK(glBufferSubData)::Forward(target, offset, size, data);
+}
+
+inline void APIENTRY GLRecorder::TexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border,
+	GLenum format, GLenum type, const void* pixels)
+{
+	long long bytes = pixels != nullptr ? (long long)width * height * BytesPerPixel(format, type) : 0;
+	Get().Record(glTexImage2DTag::Name(), bytes, target, level, internalformat, width, height, border, format, type, pixels);
+	GL_RECORDER_HOOK(glTexImage2D)::Forward(target, level, internalformat, width, height, border, format, type, pixels);
+}
+
+inline void APIENTRY GLRecorder::TexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height,
+	GLenum format, GLenum type, const void* pixels)
+{
+	long long bytes = (long long)width * height * BytesPerPixel(format, type);
+	Get().Record(glTexSubImage2DTag::Name(), bytes, target, level, xoffset, yoffset, width, height, format, type, pixels);
+	GL_RECORDER_HOOK(glTexSubImage2D)::Forward(target, level, xoffset, yoffset, width, height, format, type, pixels);
+}
+
+//Headless compiles and links always succeed, with an empty log
+inline void APIENTRY GLRecorder::GetShaderiv(GLuint shader, GLenum pname, GLint* params)
+{
+	GLRecorder& recorder = Get();
+	recorder.Record(glGetShaderivTag::Name(), 0, shader, pname, params);
+	if (recorder.forwarding)
+		GL_RECORDER_HOOK(glGetShaderiv)::Forward(shader, pname, params);
+	else
+		*params = pname == GL_COMPILE_STATUS ? GL_TRUE : 0;
+}
+
+inline void APIENTRY GLRecorder::GetProgramiv(GLuint program, GLenum pname, GLint* params)
+{
+	GLRecorder& recorder = Get();
+	recorder.Record(glGetProgramivTag::Name(), 0, program, pname, params);
+	if (recorder.forwarding)
+		GL_RECORDER_HOOK(glGetProgramiv)::Forward(program, pname, params);
+	else
+		*params = pname == GL_LINK_STATUS ? GL_TRUE : 0;
+}
+
+inline void APIENTRY GLRecorder::GetShaderInfoLog(GLuint shader, GLsizei bufSize, GLsizei* length, GLchar* infoLog)
+{
+	GLRecorder& recorder = Get();
+	recorder.Record(glGetShaderInfoLogTag::Name(), 0, shader, bufSize, length, infoLog);
+	if (recorder.forwarding)
+		GL_RECORDER_HOOK(glGetShaderInfoLog)::Forward(shader, bufSize, length, infoLog);
+	else
+	{
+		if (length != nullptr)
+			*length = 0;
+		if (bufSize > 0)
+			infoLog[0] = '\0';
+	}
+}
+
+inline void APIENTRY GLRecorder::GetProgramInfoLog(GLuint program, GLsizei bufSize, GLsizei* length, GLchar* infoLog)
+{
+	GLRecorder& recorder = Get();
+	recorder.Record(glGetProgramInfoLogTag::Name(), 0, program, bufSize, length, infoLog);
+	if (recorder.forwarding)
+		GL_RECORDER_HOOK(glGetProgramInfoLog)::Forward(program, bufSize, length, infoLog);
+	else
+	{
+		if (length != nullptr)
+			*length = 0;
+		if (bufSize > 0)
+			infoLog[0] = '\0';
+	}
+}
+
+//Headless every uniform name of a program gets its own location, the same one every time it's asked for
+inline GLint APIENTRY GLRecorder::GetUniformLocation(GLuint program, const GLchar* name)
+{
+	GLRecorder& recorder = Get();
+	recorder.Record(glGetUniformLocationTag::Name(), 0, program, name);
+	if (recorder.forwarding)
+		return GL_RECORDER_HOOK(glGetUniformLocation)::Forward(program, name);
+	std::string key = std::to_string(program) + ":" + name;
+	auto found = recorder.uniformLocations.find(key);
+	if (found != recorder.uniformLocations.end())
+		return found->second;
+	GLint location = (GLint)recorder.uniformLocations.size();
+	recorder.uniformLocations[key] = location;
+	return location;
+}
+
+#undef GL_RECORDER_HOOK
+
+#endif
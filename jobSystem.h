@@ -0,0 +1,287 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+//-------------------------------------------------------------------------------------
+// Work stealing job system, one pool shared by everything that runs in parallel
+// (octree builds, ray passes, falloff...), so separate users never pile up threads.
+// Every worker has its own deque, it pushes and pops its own jobs at the back and
+// steals from the front of the others when it runs dry. Threads that wait on a job
+// (including ones outside the pool) run other jobs meanwhile instead of blocking,
+// which keeps nested parallel loops from deadlocking or oversubscribing the cores.
+//-------------------------------------------------------------------------------------
+
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+#include<atomic>
+#include<deque>
+#include<vector>
+#include<memory>
+#include<functional>
+#include<chrono>
+#include<algorithm>
+
+struct Job
+{
+	std::function<void()> work;
+	const char* name = "";
+	std::atomic<int> pendingDependencies{ 0 };
+	std::atomic<bool> finished{ false };
+	std::mutex dependentsMutex;
+	std::vector<std::shared_ptr<Job>> dependents; //jobs waiting on this one
+};
+typedef std::shared_ptr<Job> JobHandle;
+
+//Called after every job (and every parallel loop chunk) with its name, the worker that ran it (-1 outside the pool) and its duration
+typedef std::function<void(const char* name, int worker, double seconds)> JobTimingHook;
+
+class JobSystem
+{
+public:
+	//workerCount < 0 takes one worker less than there are cores, the thread that waits on the jobs works too
+	JobSystem(int workerCount = -1)
+	{
+		if (workerCount < 0)
+			workerCount = std::max((int)std::thread::hardware_concurrency() - 1, 0);
+		for (int i = 0; i <= workerCount; i++) //the last queue is shared by threads outside the pool
+			queues.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue()));
+		for (int i = 0; i < workerCount; i++)
+			threads.push_back(std::thread(&JobSystem::WorkerLoop, this, i));
+	}
+	~JobSystem()
+	{
+		{
+			std::lock_guard<std::mutex> lock(wakeMutex);
+			stopRequested = true;
+		}
+		wakeCondition.notify_all();
+		for (auto& thread : threads)
+			thread.join();
+	}
+
+	//Threads that can run jobs at the same time, including the one waiting on them
+	int ThreadCount() const
+	{
+		return (int)threads.size() + 1;
+	}
+
+	//Set before submitting any work, per job timing goes through it
+	void SetTimingHook(JobTimingHook hook)
+	{
+		timingHook = hook;
+	}
+
+	//Queues work to run once all of its dependencies have finished
+	JobHandle Submit(const char* name, std::function<void()> work, const std::vector<JobHandle>& dependencies = std::vector<JobHandle>())
+	{
+		JobHandle job = std::make_shared<Job>();
+		job->name = name;
+		job->work = work;
+		job->pendingDependencies = 1; //held until all the dependencies are registered
+		for (const JobHandle& dependency : dependencies)
+		{
+			std::lock_guard<std::mutex> lock(dependency->dependentsMutex);
+			if (!dependency->finished)
+			{
+				job->pendingDependencies++;
+				dependency->dependents.push_back(job);
+			}
+		}
+		if (--job->pendingDependencies == 0)
+			Enqueue(job);
+		return job;
+	}
+
+	//Runs other jobs until the given one has finished
+	void Wait(const JobHandle& job)
+	{
+		while (!job->finished)
+		{
+			if (!RunOne())
+				std::this_thread::yield();
+		}
+	}
+
+	//Calls body(first, last) on chunks covering [begin, end) and returns once all of them are done
+	//Chunks are split in halves until they reach the grain size, which adapts to the range and the thread
+	//count (a few chunks per thread, so stealing evens out uneven work) but never goes under minGrain
+	template<typename RangeBody>
+	void ParallelForRange(const char* name, int begin, int end, int minGrain, const RangeBody& body)
+	{
+		if (end <= begin)
+			return;
+		int grain = std::max(std::max(minGrain, 1), (end - begin) / (ThreadCount() * 4));
+		if (end - begin <= grain || ThreadCount() == 1)
+		{
+			RunTimed(name, [&]() { body(begin, end); });
+			return;
+		}
+
+		std::atomic<int> remaining(end - begin);
+		RunSplit(name, begin, end, grain, body, remaining);
+		while (remaining > 0)
+		{
+			if (!RunOne())
+				std::this_thread::yield();
+		}
+	}
+
+	//Calls body(i) for every i in [begin, end), see ParallelForRange
+	template<typename Body>
+	void ParallelFor(const char* name, int begin, int end, int minGrain, const Body& body)
+	{
+		ParallelForRange(name, begin, end, minGrain, [&](int first, int last)
+		{
+			for (int i = first; i < last; i++)
+				body(i);
+		});
+	}
+
+private:
+	struct WorkerQueue
+	{
+		std::mutex mutex;
+		std::deque<JobHandle> jobs;
+	};
+
+	//Index of the calling thread's own queue, the shared one for threads outside this pool
+	int CurrentQueue()
+	{
+		return (CurrentPool() == this) ? CurrentWorker() : (int)threads.size();
+	}
+	static JobSystem*& CurrentPool()
+	{
+		static thread_local JobSystem* pool = nullptr;
+		return pool;
+	}
+	static int& CurrentWorker()
+	{
+		static thread_local int worker = -1;
+		return worker;
+	}
+
+	template<typename RangeBody>
+	void RunSplit(const char* name, int begin, int end, int grain, const RangeBody& body, std::atomic<int>& remaining)
+	{
+		//hand the upper halves out to be stolen, keep splitting the lower one ourselves
+		while (end - begin > grain)
+		{
+			int middle = begin + (end - begin) / 2;
+			int upperEnd = end;
+			Submit(name, [this, name, middle, upperEnd, grain, &body, &remaining]()
+			{
+				RunSplit(name, middle, upperEnd, grain, body, remaining);
+			});
+			end = middle;
+		}
+		RunTimed(name, [&]() { body(begin, end); });
+		remaining -= end - begin;
+	}
+
+	template<typename Work>
+	void RunTimed(const char* name, const Work& work)
+	{
+		if (!timingHook)
+		{
+			work();
+			return;
+		}
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		work();
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		timingHook(name, CurrentPool() == this ? CurrentWorker() : -1, seconds);
+	}
+
+	void Enqueue(const JobHandle& job)
+	{
+		WorkerQueue& queue = *queues[CurrentQueue()];
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.jobs.push_back(job);
+		}
+		{
+			//under the lock a worker is either before its wait predicate (and sees the job) or already waiting (and gets the notify)
+			std::lock_guard<std::mutex> lock(wakeMutex);
+			queuedJobs++;
+		}
+		wakeCondition.notify_one();
+	}
+
+	//Runs a single job if there's one anywhere, returns false if everything is empty
+	bool RunOne()
+	{
+		JobHandle job;
+		int own = CurrentQueue();
+		{
+			//newest own job first, it's the most likely to still be in cache
+			std::lock_guard<std::mutex> lock(queues[own]->mutex);
+			if (!queues[own]->jobs.empty())
+			{
+				job = queues[own]->jobs.back();
+				queues[own]->jobs.pop_back();
+			}
+		}
+		for (int i = 1; !job && i < queues.size(); i++)
+		{
+			//steal the oldest job of someone else, it's usually the biggest chunk
+			WorkerQueue& victim = *queues[(own + i) % queues.size()];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if (!victim.jobs.empty())
+			{
+				job = victim.jobs.front();
+				victim.jobs.pop_front();
+			}
+		}
+		if (!job)
+			return false;
+
+		queuedJobs--;
+		RunTimed(job->name, job->work);
+
+		std::vector<JobHandle> ready;
+		{
+			std::lock_guard<std::mutex> lock(job->dependentsMutex);
+			job->finished = true;
+			for (JobHandle& dependent : job->dependents)
+			{
+				if (--dependent->pendingDependencies == 0)
+					ready.push_back(dependent);
+			}
+			job->dependents.clear();
+		}
+		for (JobHandle& dependent : ready)
+			Enqueue(dependent);
+		return true;
+	}
+
+	void WorkerLoop(int index)
+	{
+		CurrentPool() = this;
+		CurrentWorker() = index;
+		while (true)
+		{
+			if (RunOne())
+				continue;
+			std::unique_lock<std::mutex> lock(wakeMutex);
+			wakeCondition.wait(lock, [this]() { return stopRequested || queuedJobs > 0; });
+			if (stopRequested)
+				return;
+		}
+	}
+
+	std::vector<std::unique_ptr<WorkerQueue>> queues;
+	std::vector<std::thread> threads;
+	std::mutex wakeMutex;
+	std::condition_variable wakeCondition;
+	std::atomic<int> queuedJobs{ 0 };
+	bool stopRequested = false;
+	JobTimingHook timingHook;
+};
+
+//The one pool everything shares
+JobSystem& Jobs()
+{
+	static JobSystem jobSystem;
+	return jobSystem;
+}
+
+#endif
\ No newline at end of file
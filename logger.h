@@ -0,0 +1,203 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+//-------------------------------------------------------------------------------------
+// Leveled logging. LOG_INFO("loaded " << count << " verts") formats the message on the
+// calling thread and hands it to a ring buffer, a background thread writes it out, so
+// logging never waits on the console. Levels below DEFORM_LOG_LEVEL are compiled out
+// completely (arguments included), the rest can still be filtered at runtime with
+// Logger::Get().SetLevel(). When the ring is full new messages are counted and dropped
+// instead of blocking the caller, errors always wait for a slot.
+//-------------------------------------------------------------------------------------
+
+#define DEFORM_LOG_TRACE 0
+#define DEFORM_LOG_DEBUG 1
+#define DEFORM_LOG_INFO 2
+#define DEFORM_LOG_WARN 3
+#define DEFORM_LOG_ERROR 4
+#define DEFORM_LOG_OFF 5
+
+#ifndef DEFORM_LOG_LEVEL
+#define DEFORM_LOG_LEVEL DEFORM_LOG_INFO
+#endif
+
+#include<string>
+#include<vector>
+#include<sstream>
+#include<iostream>
+#include<fstream>
+#include<mutex>
+#include<condition_variable>
+#include<thread>
+#include<atomic>
+
+enum class LogLevel { Trace = DEFORM_LOG_TRACE, Debug, Info, Warn, Error, Off };
+
+class Logger
+{
+public:
+	static Logger& Get()
+	{
+		static Logger logger;
+		return logger;
+	}
+
+	void SetLevel(LogLevel level) { minLevel = (int)level; }
+	bool IsEnabled(LogLevel level) const { return (int)level >= minLevel.load(std::memory_order_relaxed); }
+
+	//Also writes every message to the given file, on top of the console
+	bool OpenFile(const std::string& path)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		file.open(path);
+		return (bool)file;
+	}
+
+	void Push(LogLevel level, std::string message)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if (count == ring.size())
+		{
+			if (level < LogLevel::Error)
+			{
+				dropped++;
+				return;
+			}
+			drained.wait(lock, [this] { return count < ring.size(); });
+		}
+		ring[(head + count) % ring.size()] = Entry{ level, std::move(message) };
+		count++;
+		lock.unlock();
+		pending.notify_one();
+	}
+
+	//Blocks until everything pushed so far has been written out
+	void Flush()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		drained.wait(lock, [this] { return count == 0 && !writing; });
+		std::cout.flush();
+		if (file)
+			file.flush();
+	}
+
+	~Logger()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		pending.notify_one();
+		writer.join();
+		if (dropped > 0)
+			std::cout << "[warn] logger dropped " << dropped << " messages, its buffer was full\n";
+		std::cout.flush();
+	}
+
+private:
+	struct Entry
+	{
+		LogLevel level;
+		std::string message;
+	};
+
+	Logger() : ring(ringSize), minLevel(DEFORM_LOG_LEVEL)
+	{
+		writer = std::thread(&Logger::WriterLoop, this);
+	}
+
+	static const char* Prefix(LogLevel level)
+	{
+		static const char* prefixes[] = { "[trace] ", "[debug] ", "[info] ", "[warn] ", "[error] " };
+		return prefixes[(int)level];
+	}
+
+	//Takes everything out of the ring in one go and writes it with the lock released
+	void WriterLoop()
+	{
+		std::vector<Entry> batch;
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true)
+		{
+			pending.wait(lock, [this] { return count > 0 || stopping; });
+			if (count == 0 && stopping)
+				break;
+			batch.clear();
+			for (; count > 0; count--, head = (head + 1) % ring.size())
+				batch.push_back(std::move(ring[head]));
+			writing = true;
+			lock.unlock();
+			drained.notify_all(); //callers waiting for a slot can go on while this batch is written
+
+			std::string text;
+			for (const Entry& entry : batch)
+				text.append(Prefix(entry.level)).append(entry.message).append("\n");
+			std::cout << text;
+			if (file)
+				file << text;
+
+			lock.lock();
+			writing = false;
+			drained.notify_all();
+		}
+	}
+
+	static const size_t ringSize = 4096;
+
+	std::mutex mutex;
+	std::condition_variable pending; //writer waits on it for messages
+	std::condition_variable drained; //producers wait on it for free slots, Flush for an empty ring
+	std::vector<Entry> ring;
+	size_t head = 0;
+	size_t count = 0;
+	bool writing = false;
+	bool stopping = false;
+	long long dropped = 0;
+	std::atomic<int> minLevel;
+	std::ofstream file;
+	std::thread writer;
+};
+
+//True if messages of the level are compiled in and not filtered out at runtime, for guarding costly diagnostics
+#define LOG_ENABLED(level) ((int)(level) >= DEFORM_LOG_LEVEL && Logger::Get().IsEnabled(level))
+
+#define LOG_AT(level, message) \
+	do { \
+		if (LOG_ENABLED(level)) \
+		{ \
+			std::ostringstream logStream; \
+			logStream << message; \
+			Logger::Get().Push(level, logStream.str()); \
+		} \
+	} while (0)
+
+#if DEFORM_LOG_LEVEL <= DEFORM_LOG_TRACE
+#define LOG_TRACE(message) LOG_AT(LogLevel::Trace, message)
+#else
+#define LOG_TRACE(message) do {} while (0)
+#endif
+
+#if DEFORM_LOG_LEVEL <= DEFORM_LOG_DEBUG
+#define LOG_DEBUG(message) LOG_AT(LogLevel::Debug, message)
+#else
+#define LOG_DEBUG(message) do {} while (0)
+#endif
+
+#if DEFORM_LOG_LEVEL <= DEFORM_LOG_INFO
+#define LOG_INFO(message) LOG_AT(LogLevel::Info, message)
+#else
+#define LOG_INFO(message) do {} while (0)
+#endif
+
+#if DEFORM_LOG_LEVEL <= DEFORM_LOG_WARN
+#define LOG_WARN(message) LOG_AT(LogLevel::Warn, message)
+#else
+#define LOG_WARN(message) do {} while (0)
+#endif
+
+#if DEFORM_LOG_LEVEL <= DEFORM_LOG_ERROR
+#define LOG_ERROR(message) LOG_AT(LogLevel::Error, message)
+#else
+#define LOG_ERROR(message) do {} while (0)
+#endif
+
+#endif
@@ -19,6 +19,11 @@
 #include "rayUtil.h"
 #include "optimalProjectile.h"
 #include "optimalTarget.h"
+#include "simThread.h"
+#include "profiler.h"
+#include "logger.h"
+#include "glRecorder.h"
+#include "uniformBlocks.h"
 
 //------------------------------------------------------------------------------------------------
 //Function prototypes
@@ -30,7 +35,7 @@ void framebufferSizeCallback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow* window);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
-void setupStaticLights(Shader& targetShader, glm::vec3* lightPositions, glm::vec3 lightDiffuse);
+void setupStaticLights(UniformBuffer<LightsBlock>& lightsBuffer, glm::vec3* lightPositions, glm::vec3 lightDiffuse);
 unsigned int loadCubemap(vector<std::string> faces);
 
 //------------------------------------------------------------------------------------------------
@@ -51,6 +56,7 @@ bool firstMouse = true;
 
 //TODO: delete dis
 float dentSpeed = 0.01f; bool started = false;
+int historySeek = 0; bool historyReset = false; //going through the recorded deformation, once the simulation is done
 
 glm::vec3 rayPos = glm::vec3(0.01f, 2.0f, 0.01f);
 
@@ -66,9 +72,15 @@ int main()
 	//Loading opengl func pointers
 	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
 	{
-		std::cout << "Failed to initialize GLAD!" << std::endl;
+		LOG_ERROR("Failed to initialize GLAD!");
 		return -1;
 	}
+#if DEFORM_GL_RECORDING
+	//every GL call from here on is counted, one frame's commands get written out for diffing
+	GLRecorder::Get().Install(true);
+	const int glRecordedFrame = 120; //late enough for everything to be set up
+	int frameIndex = 0;
+#endif
 
 	//Initialize text font
 	Text text("../OpenGL_DeformProj/arial.ttf", 0, 24, glm::vec3(0, 0, 0));
@@ -86,6 +98,10 @@ int main()
 
 	ofstream FPSOutput; //for logging fps onto a csv file
 	FPSOutput.open("fps.csv");
+#if DEFORM_PROFILING
+	//job system work shows up as zones too (octree builds, ray chunks), has to be set before any jobs run
+	Jobs().SetTimingHook(Profiler::RecordJob);
+#endif
 
 	//------------------------------------------------------------------------------------------------
 	//Geometry and shader setup
@@ -97,6 +113,9 @@ int main()
 	Shader textShader("../OpenGL_DeformProj/textShader.vert", "../OpenGL_DeformProj/textShader.frag");
 	Shader skyboxShader("../OpenGL_DeformProj/skybox.vert", "../OpenGL_DeformProj/skybox.frag");
 	Shader rayShader("../OpenGL_DeformProj/ray.vert", "../OpenGL_DeformProj/ray.frag");
+	//Camera and light uniforms shared by all of the programs above
+	UniformBuffer<CameraBlock> cameraBuffer(UniformBlocks::Camera);
+	UniformBuffer<LightsBlock> lightsBuffer(UniformBlocks::Lights);
 
 	//Raw geometry for lights and the skybox
 	float vertices[] = {
@@ -236,23 +255,55 @@ int main()
 	//Target, lights, and projectile setup
 	//------------------------------------------------------------------------------------------------
 	glm::vec3 lightDiffuse = glm::vec3(0.66f, 0.86f, 0.97f);
-	setupStaticLights(objShader, lightPositions, lightDiffuse);
-	setupStaticLights(projShader, lightPositions, lightDiffuse);
+	setupStaticLights(lightsBuffer, lightPositions, lightDiffuse);
+	//Everything the simulation depends on, recorded along with every step so the run can be replayed headless
+	ImpactLog replayLog;
+	ImpactSetup& impact = replayLog.setup;
+	impact.targetPath = "../../OpenGLAssets/testModels/testPlaneHiRes.obj";
+	impact.projectilePath = "../../OpenGLAssets/testModels/projectileTriangle.obj";
+	impact.relaxSettings.enabled = true; //spreads out the crease around the rim of the dent
+	//impact.chunkedTargetPath = "../../OpenGLAssets/testModels/testPlaneHiRes.chunks"; //out of core, for targets too big for memory
+	//Loading the projectile, first, out of core targets only load what's along its path
+	//PointProjectile projectile(glm::vec3(0.0f, 3.05f, -2.20f), glm::vec3(0.0f, -0.03f, 0.005f));
+	OctreePointProjectile octreeTester(rayPos, glm::vec3(0.0f, -0.03f, 0.0f));
+	OctreeProjectile legitOctreeTester(impact.projectilePath, impact.acceleration);
+	Octree projectileOctree(legitOctreeTester.projectileMesh, legitOctreeTester.boundingBoxSize* 0.5f, impact.treeMaxVerts, impact.treeMaxTris, impact.treeDepth,
+		legitOctreeTester.boundingBoxSize, legitOctreeTester.boundingBoxCenter + glm::vec3(0, 0.001f, 0));
+	legitOctreeTester.SetupTree(projectileOctree);
+	legitOctreeTester.relaxSettings = impact.relaxSettings;
 	//Loading the target
-	OctreeTarget target("../../OpenGLAssets/testModels/testPlaneHiRes.obj", 0.5f, 3.0f, 1);
-	Octree sceneOctree(target.targetModel, target.boundingBoxSize* 0.5f, 3, 3, 3, target.boundingBoxSize, target.boundingBoxCenter + glm::vec3(0, 0.001f, 0));
+	ChunkedTarget chunkedTarget;
+	Model targetModel = impact.TargetModel(chunkedTarget, legitOctreeTester, true);
+	if (targetModel.meshes.empty() || targetModel.meshes[0].vertices.empty())
+	{
+		LOG_ERROR("Failed to load the target!");
+		glfwTerminate();
+		return -1;
+	}
+	OctreeTarget target(std::move(targetModel), impact.falloff, impact.roughness, impact.threshold);
+	impact.ApplyMaterial(target); //keeps the uniform material if the map doesn't fit, that's been logged
+	Octree sceneOctree(target.targetModel, target.boundingBoxSize* 0.5f, impact.treeMaxVerts, impact.treeMaxTris, impact.treeDepth, target.boundingBoxSize,
+		target.boundingBoxCenter + glm::vec3(0, 0.001f, 0));
 	target.SetupTree(sceneOctree);
+	objShader.use();
 	objShader.setVec3("material.diffuse", target.targetModel.material.diffuse);
 	objShader.setVec3("material.specular", target.targetModel.material.specular);
-	//Loading the projectile
-	//PointProjectile projectile(glm::vec3(0.0f, 3.05f, -2.20f), glm::vec3(0.0f, -0.03f, 0.005f));
-	OctreePointProjectile octreeTester(rayPos, glm::vec3(0.0f, -0.03f, 0.0f));
-	OctreeProjectile legitOctreeTester("../../OpenGLAssets/testModels/projectileTriangle.obj", glm::vec3(0.0f, -0.03f, 0.0f));
-	Octree projectileOctree(legitOctreeTester.projectileMesh, legitOctreeTester.boundingBoxSize* 0.5f, 3, 3, 3, legitOctreeTester.boundingBoxSize,
-		legitOctreeTester.boundingBoxCenter + glm::vec3(0, 0.001f, 0));
-	legitOctreeTester.SetupTree(projectileOctree);
+	//Spend triangles where the dent is going to be, before the simulation thread takes the target over
+	impact.PrepareTarget(target, legitOctreeTester, sceneOctree);
+	impact.Capture(target, legitOctreeTester);
+	target.BeginHistory(64 << 20, 30); //a keyframe every half a second of simulation
+	//The deformed target and every step of its deformation get written out on their own thread
+	ExportSettings exportSettings;
+	exportSettings.streamDisplacements = true;
+	ExportThread exporter(exportSettings);
+	exporter.BeginStream(target.targetModel.meshes[0], (float)impact.stepSize);
+	projShader.use();
 	projShader.setVec3("material.diffuse", legitOctreeTester.projectileMesh.material.diffuse);
 	projShader.setVec3("material.specular", legitOctreeTester.projectileMesh.material.specular);
+	//Fixed step simulation on its own thread, 60 steps per second of real time regardless of the frame rate
+	SimThread simThread(legitOctreeTester, target, sceneOctree, projectileOctree, impact.stepSize, 8);
+	simThread.Record(&replayLog);
+	simThread.Export(&exporter);
 	//Fps counter constants
 	double lastFPSCheck = glfwGetTime();
 	int currentFPS = 0;
@@ -263,6 +314,17 @@ int main()
 	//------------------------------------------------------------------------------------------------
 	while (!glfwWindowShouldClose(window))
 	{
+		PROFILE_FRAME();
+#if DEFORM_GL_RECORDING
+		if (frameIndex == glRecordedFrame)
+			GLRecorder::Get().SetCommandRecording(true);
+		else if (frameIndex == glRecordedFrame + 1)
+		{
+			GLRecorder::Get().SetCommandRecording(false);
+			GLRecorder::Get().WriteCommands("gl_frame.txt");
+		}
+		frameIndex++;
+#endif
 		//Fps and deltaTime updating
 		float currentFrame = glfwGetTime();
 		deltaTime = currentFrame - lastFrame;
@@ -285,16 +347,9 @@ int main()
 		glfwGetWindowSize(window, &windowWidth, &windowHeight);
 		projection = glm::perspective(glm::radians(camera.Zoom), (float)windowWidth / (float)windowHeight, 0.1f, 100.0f);
 
-		objShader.use();
-		objShader.setMat4("view", view);
-		objShader.setMat4("projection", projection);
-		objShader.setVec3("viewPos", camera.Position);
-		objShader.setFloat("material.shininess", 32.0f); //the only thing left in the material not managed by textures
-		projShader.use();
-		projShader.setMat4("view", view);
-		projShader.setMat4("projection", projection);
-		projShader.setVec3("viewPos", camera.Position);
-		projShader.setFloat("material.shininess", 32.0f); //the only thing left in the material not managed by textures
+		//one upload for every program that reads the camera block
+		CameraBlock cameraBlock = { view, projection, camera.Position, 0.0f };
+		cameraBuffer.Update(cameraBlock);
 		//Dynamic light setup
 		//objShader.setSpotLight("flashLight", camera.Position, camera.Front, lightDiffuse, 12.5f, 17.5f);
 
@@ -306,27 +361,58 @@ int main()
 		skyboxShader.setMat4("view", glm::mat4(glm::mat3(camera.GetViewMatrix())));
 		skyboxShader.setMat4("projection", projection);
 		// skybox cube
-		glBindVertexArray(skyVAO);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
-		glBindVertexArray(0);
+		{
+			PROFILE_ZONE("draw skybox");
+			glBindVertexArray(skyVAO);
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+			glDrawArrays(GL_TRIANGLES, 0, 36);
+			glBindVertexArray(0);
+		}
 		glDepthMask(GL_TRUE);
 
 		//Rendering light geometry
 		glBindVertexArray(lampVAO);
 		for (int i = 0; i < 4; i++)
 		{
+			PROFILE_ZONE("draw light");
 			lightShader.use();
 			model = glm::mat4(1.0f);
 			model = glm::scale(model, glm::vec3(.5f, .5f, .5f));
 			model = glm::translate(model, lightPositions[i]);
-			lightShader.setMat4("view", view);
 			lightShader.setMat4("model", model);
-			lightShader.setMat4("projection", projection);
 			glDrawArrays(GL_TRIANGLES, 0, 36);
 		}
 
+		//Picking up the latest simulated state, the simulation itself runs on its own thread
+		if (started)
+			simThread.Start();
+		const SimSnapshot& simState = simThread.Consume(target.targetModel.meshes[0]);
+		if (started)
+		{
+			FPSOutput << currentFPS << "\n";
+			if (simState.isDone)
+			{
+				started = false;
+				FPSOutput.close();
+				replayLog.Write("impact_replay.bin"); //replay it with benchmarks/impactReplay
+				exporter.EndStream();
+				exporter.ExportMesh(target.targetModel.meshes[0]);
+				if (chunkedTarget.IsOpen())
+					chunkedTarget.WriteDented(target.targetModel.meshes[0], ChunkedTarget::DentedPath(impact.chunkedTargetPath));
+			}
+		}
+		//The target is the render thread's again once the simulation is done, rewind, replay or reset its deformation
+		if (!simThread.IsRunning() && (historySeek != 0 || historyReset))
+		{
+			Mesh& targetMesh = target.targetModel.meshes[0];
+			int first, last;
+			bool changed = historyReset ? target.ResetDeformation(sceneOctree, first, last) :
+				target.SeekFrame(sceneOctree, target.history.CurrentFrame() + historySeek, first, last);
+			if (changed)
+				targetMesh.UpdateBufferRange(first, last - first + 1, &targetMesh.vertices[first]);
+		}
+
 		//Rendering the target
 		glStencilFunc(GL_ALWAYS, 1, 0xFF);
 		glStencilMask(0xFF);
@@ -336,7 +422,10 @@ int main()
 		//model = glm::translate(model, glm::vec3(0.5f, -3.2f, 0.2f));
 		objShader.use();
 		target.model = model;
-		target.Draw(objShader);
+		{
+			PROFILE_ZONE("draw target");
+			target.Draw(objShader);
+		}
 
 		/* NON OCTREE IMPLEMENTATION
 		if (started) //When simulation is started(keystroke), start denting the target
@@ -346,7 +435,7 @@ int main()
 			{
 				legitProjectile.ProcessRays(target, model);
 				//legitProjectile.ProcessTarget(target, model);
-				std::cout << "Target has been set up.\n";
+				LOG_INFO("Target has been set up.");
 				firstPass = false;
 			}
 			if (!legitProjectile.isDone)
@@ -366,20 +455,17 @@ int main()
 		projShader.use();
 		projShader.setMat4("model", model);
 		legitOctreeTester.model = model;
-		legitOctreeTester.Draw(projShader);
-		legitOctreeTester.RenderInfiniteRays(view, projection);
-
-		//octreeTester.projectilePosition = rayPos;
-		octreeTester.RenderRay(view, model, projection);
-		if (started)
+		glm::vec3 projectileOffset = simThread.RenderOffset(simState);
 		{
-			FPSOutput << currentFPS << "\n";
-			legitOctreeTester.Update(sceneOctree, projectileOctree, target, 0.0167f, model);
-			if (legitOctreeTester.isDone)
-			{
-				started = false;
-				FPSOutput.close();
-			}
+			PROFILE_ZONE("draw projectile");
+			legitOctreeTester.Draw(projShader, projectileOffset);
+		}
+		{
+			PROFILE_ZONE("draw rays");
+			legitOctreeTester.RenderInfiniteRays(view, projection, projectileOffset);
+
+			//octreeTester.projectilePosition = rayPos;
+			octreeTester.RenderRay(view, model, projection);
 		}
 
 		glm::mat4 textCanvas = glm::ortho(0.0f, (float)windowWidth, 0.0f, (float)windowHeight);
@@ -396,10 +482,22 @@ int main()
 		currentFPS = 1 / deltaTime;
 		//}
 
-		glfwSwapBuffers(window);
+		{
+			PROFILE_ZONE("swap buffers");
+			glfwSwapBuffers(window);
+		}
 		glfwPollEvents();
 	}
 
+#if DEFORM_PROFILING
+	Profiler::Get().WriteChromeTrace("profile_trace.json");
+	Profiler::Get().WriteFrameCsv("profile_frames.csv");
+#endif
+#if DEFORM_GL_RECORDING
+	std::ostringstream glStats;
+	GLRecorder::Get().PrintStats(glStats);
+	LOG_INFO(glStats.str());
+#endif
 	glfwTerminate();
 	return 0;
 }
@@ -419,7 +517,7 @@ GLFWwindow* setupWindow()
 	GLFWwindow* window = glfwCreateWindow(windowWidth, windowHeight, "bottom text", NULL, NULL);
 	if (window == NULL)
 	{
-		std::cout << "Failed to create window!" << std::endl;
+		LOG_ERROR("Failed to create window!");
 		return NULL;
 	}
 	glfwMakeContextCurrent(window);
@@ -457,7 +555,7 @@ void loadTexture(unsigned int* texture, bool isRGBA, const char* path)
 	}
 	else
 	{
-		std::cout << "ERROR: Failed to load image data!";
+		LOG_ERROR("Failed to load image data at path: " << path);
 	}
 	stbi_image_free(data);
 }
@@ -502,6 +600,14 @@ void processInput(GLFWwindow * window)
 		started = true;
 	}
 
+	//Deformation history, a step per frame while held
+	historySeek = 0;
+	if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
+		historySeek = -1;
+	else if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
+		historySeek = 1;
+	historyReset = glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS;
+
 	if (glfwGetKey(window, GLFW_KEY_U) == GLFW_PRESS)
 	{
 		rayPos.y -= deltaTime;
@@ -554,16 +660,27 @@ void scroll_callback(GLFWwindow * window, double xoffset, double yoffset)
 }
 
 //Static light setup for object shader, these get calculated before the actual render
-void setupStaticLights(Shader& targetShader, glm::vec3* lightPositions, glm::vec3 lightDiffuse)
+//Same values Shader::setPointLight and setDirectionalLight would set, uploaded once for all programs
+void setupStaticLights(UniformBuffer<LightsBlock>& lightsBuffer, glm::vec3* lightPositions, glm::vec3 lightDiffuse)
 {
-	targetShader.use();
-	for (int i = 0; i < 4; i++)
+	LightsBlock lights = {};
+	for (int i = 0; i < UniformBlocks::PointLightCount; i++)
 	{
-		targetShader.setPointLightAt("pointLights", i, lightPositions[i], lightDiffuse, linear, quadratic);
+		PointLightData& light = lights.pointLights[i];
+		light.position = lightPositions[i];
+		light.ambient = lightDiffuse * 0.2f;
+		light.diffuse = lightDiffuse * 0.8f;
+		light.specular = lightDiffuse;
+		light.constant = 1.0f;
+		light.linear = linear;
+		light.quadratic = quadratic;
 	}
 	glm::vec3 sunDiffuse = glm::vec3(1.0f, 0.7f, 0.3f);
-	glm::vec3 sunDirection = glm::vec3(-0.2f, -1.0f, -0.3f);
-	targetShader.setDirectionalLight("dirLight", sunDirection, sunDiffuse);
+	lights.dirLight.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+	lights.dirLight.ambient = sunDiffuse * 0.2f;
+	lights.dirLight.diffuse = sunDiffuse * 0.5f;
+	lights.dirLight.specular = sunDiffuse;
+	lightsBuffer.Update(lights);
 }
 
 //Loads cubemap for the skybox
@@ -584,7 +701,7 @@ unsigned int loadCubemap(vector<std::string> faces)
 		}
 		else
 		{
-			std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
+			LOG_ERROR("Cubemap texture failed to load at path: " << faces[i]);
 			stbi_image_free(data);
 		}
 	}
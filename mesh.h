@@ -11,6 +11,8 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "shader.h"
+#include "profiler.h"
+#include "logger.h"
 
 #include <string>
 #include <fstream>
@@ -47,42 +49,30 @@ public:
 	unsigned int VAO;
 
 	/*  Functions  */
-	//Constructor
-	Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, bool isDynamic)
+	//Constructor, without createBuffers the mesh stays CPU only (no GL context needed, e.g. for benchmarks)
+	//Pass the vectors in with std::move when they aren't needed afterwards, so big meshes aren't copied
+	Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, bool isDynamic, bool createBuffers = true) :
+		vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures))
 	{
-		this->vertices = vertices;
-		this->indices = indices;
-		this->textures = textures;
 		this->isDynamic = isDynamic;
+		VAO = VBO = EBO = 0;
+		vertexCapacity = indexCapacity = 0;
+		setupSamplerNames();
 		//Now that we have all the required data, set the vertex buffers and its attribute pointers.
-		setupMesh();
+		if (createBuffers)
+			setupMesh();
 	}
 
 	//Render the mesh
-	void Draw(Shader shader)
+	void Draw(Shader& shader)
 	{
+		PROFILE_ZONE("Mesh::Draw");
 		//Bind appropriate textures
-		unsigned int diffuseNr = 1;
-		unsigned int specularNr = 1;
-		unsigned int normalNr = 1;
-		unsigned int heightNr = 1;
 		for (unsigned int i = 0; i < textures.size(); i++)
 		{
 			glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-			// retrieve texture number (the N in diffuse_textureN)
-			string number;
-			string name = textures[i].type;
-			if (name == "texture_diffuse")
-				number = std::to_string(diffuseNr++);
-			else if (name == "texture_specular")
-				number = std::to_string(specularNr++); // transfer unsigned int to stream
-			else if (name == "texture_normal")
-				number = std::to_string(normalNr++); // transfer unsigned int to stream
-			else if (name == "texture_height")
-				number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-													 // now set the sampler to the correct texture unit
-			glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
+			// now set the sampler to the correct texture unit
+			shader.setInt(samplerNames[i], i);
 			// and finally bind the texture
 			glBindTexture(GL_TEXTURE_2D, textures[i].id);
 		}
@@ -99,41 +89,108 @@ public:
 	//Updates single triangle in array buffer, given the first index of triangle verts
 	void UpdateBufferTriangle(int firstIndex)
 	{
-		//vertices of the triangle that need to be updated
-		Vertex first = this->vertices[indices[firstIndex]];
-		Vertex second = this->vertices[indices[firstIndex + 1]];
-		Vertex third = this->vertices[indices[firstIndex + 2]];
-
 		glBindBuffer(GL_ARRAY_BUFFER, VBO);
 		//passing the first, second, and third vertex into buffer
-		glBufferSubData(GL_ARRAY_BUFFER, indices[firstIndex] * sizeof(Vertex), sizeof(Vertex), &first);
-		glBufferSubData(GL_ARRAY_BUFFER, indices[firstIndex + 1] * sizeof(Vertex), sizeof(Vertex), &second);
-		glBufferSubData(GL_ARRAY_BUFFER, indices[firstIndex + 2] * sizeof(Vertex), sizeof(Vertex), &third);
+		glBufferSubData(GL_ARRAY_BUFFER, indices[firstIndex] * sizeof(Vertex), sizeof(Vertex), &vertices[indices[firstIndex]]);
+		glBufferSubData(GL_ARRAY_BUFFER, indices[firstIndex + 1] * sizeof(Vertex), sizeof(Vertex), &vertices[indices[firstIndex + 1]]);
+		glBufferSubData(GL_ARRAY_BUFFER, indices[firstIndex + 2] * sizeof(Vertex), sizeof(Vertex), &vertices[indices[firstIndex + 2]]);
 	}
 	void UpdateBufferVertex(int firstIndex)
 	{
-		//vertex to be updated
-		Vertex first = this->vertices[indices[firstIndex]];
-
 		glBindBuffer(GL_ARRAY_BUFFER, VBO);
 		//passing the vert into the buffer
-		glBufferSubData(GL_ARRAY_BUFFER, indices[firstIndex] * sizeof(Vertex), sizeof(Vertex), &first);
+		glBufferSubData(GL_ARRAY_BUFFER, indices[firstIndex] * sizeof(Vertex), sizeof(Vertex), &vertices[indices[firstIndex]]);
 	}
 	void UpdateBufferVertexDirect(int index)
 	{
-		//vertex to be updated
-		Vertex first = this->vertices[index];
-
 		glBindBuffer(GL_ARRAY_BUFFER, VBO);
 		//passing the vert into the buffer
-		glBufferSubData(GL_ARRAY_BUFFER, index * sizeof(Vertex), sizeof(Vertex), &first);
+		glBufferSubData(GL_ARRAY_BUFFER, index * sizeof(Vertex), sizeof(Vertex), &vertices[index]);
+	}
+	//Uploads count consecutive vertices starting at first from data, with a single call
+	void UpdateBufferRange(int first, int count, const Vertex* data)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(Vertex), count * sizeof(Vertex), data);
+	}
+	//Uploads only the position of a vertex, which doesn't have to match the one in vertices (e.g. interpolated)
+	void UpdateBufferVertexPosition(int index, glm::vec3 position)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferSubData(GL_ARRAY_BUFFER, index * sizeof(Vertex) + offsetof(Vertex, Position), sizeof(glm::vec3), &position);
+	}
+	//Uploads only the positions of the listed vertices, positions is indexed like vertices but doesn't have to be them
+	void UpdateBufferPositions(const std::vector<int>& verts, const glm::vec3* positions)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		for (int vert : verts)
+			glBufferSubData(GL_ARRAY_BUFFER, vert * sizeof(Vertex) + offsetof(Vertex, Position), sizeof(glm::vec3), &positions[vert]);
+	}
+	//GL name of the vertex buffer, 0 for a CPU only mesh
+	unsigned int VertexBuffer() const
+	{
+		return VBO;
+	}
+	//After the mesh grew (vertices and indices appended, some indices rewritten), uploads the vertices from firstVertex
+	//and the indices from firstIndex on. Buffers that are too small get reallocated with room to spare and refilled
+	void UpdateBufferGrowth(int firstVertex, int firstIndex)
+	{
+		if (VAO == 0)
+			return;
+		glBindVertexArray(VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		if (vertices.size() > vertexCapacity)
+		{
+			vertexCapacity = vertices.size() + vertices.size() / 2;
+			glBufferData(GL_ARRAY_BUFFER, vertexCapacity * sizeof(Vertex), NULL, isDynamic ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
+			firstVertex = 0;
+		}
+		if (firstVertex < vertices.size())
+			glBufferSubData(GL_ARRAY_BUFFER, firstVertex * sizeof(Vertex), (vertices.size() - firstVertex) * sizeof(Vertex), &vertices[firstVertex]);
+		//the element buffer binding is part of the VAO state
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+		if (indices.size() > indexCapacity)
+		{
+			indexCapacity = indices.size() + indices.size() / 2;
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCapacity * sizeof(unsigned int), NULL, isDynamic ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
+			firstIndex = 0;
+		}
+		if (firstIndex < indices.size())
+			glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, firstIndex * sizeof(unsigned int), (indices.size() - firstIndex) * sizeof(unsigned int), &indices[firstIndex]);
+		glBindVertexArray(0);
 	}
 
 private:
 	/*  Render data  */
 	unsigned int VBO, EBO;
+	size_t vertexCapacity, indexCapacity; //sizes of the buffers, in vertices and indices
 	bool isDynamic;
+	vector<string> samplerNames; //sampler uniform of every texture (diffuse_textureN etc.), worked out once instead of every draw
 	/*  Functions    */
+	// names the sampler of each texture after its type and its number among textures of that type
+	void setupSamplerNames()
+	{
+		unsigned int diffuseNr = 1;
+		unsigned int specularNr = 1;
+		unsigned int normalNr = 1;
+		unsigned int heightNr = 1;
+		samplerNames.clear();
+		for (const Texture& texture : textures)
+		{
+			// retrieve texture number (the N in diffuse_textureN)
+			string number;
+			const string& name = texture.type;
+			if (name == "texture_diffuse")
+				number = std::to_string(diffuseNr++);
+			else if (name == "texture_specular")
+				number = std::to_string(specularNr++); // transfer unsigned int to stream
+			else if (name == "texture_normal")
+				number = std::to_string(normalNr++); // transfer unsigned int to stream
+			else if (name == "texture_height")
+				number = std::to_string(heightNr++); // transfer unsigned int to stream
+			samplerNames.push_back(name + number);
+		}
+	}
 	// initializes all the buffer objects/arrays
 	void setupMesh()
 	{
@@ -142,6 +199,8 @@ private:
 		glGenBuffers(1, &VBO);
 		glGenBuffers(1, &EBO);
 
+		vertexCapacity = vertices.size();
+		indexCapacity = indices.size();
 		glBindVertexArray(VAO);
 		// load data into vertex buffers
 		glBindBuffer(GL_ARRAY_BUFFER, VBO);
@@ -151,14 +210,14 @@ private:
 		//If the mesh is dynamic, it gets set up for dynamic drawing
 		if (isDynamic)
 		{
-			std::cout << "dynamic mesh setup\n"; //TODO delet dis
+			LOG_TRACE("dynamic mesh setup");
 			glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_DYNAMIC_DRAW);
 			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 			glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_DYNAMIC_DRAW);
 		}
 		else //Otherwise, it gets set up for static drawing
 		{
-			std::cout << "static mesh setup\n"; //TODO delet dis
+			LOG_TRACE("static mesh setup");
 			glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
 			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 			glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
@@ -0,0 +1,372 @@
+#ifndef MESH_EXPORT_H
+#define MESH_EXPORT_H
+//-------------------------------------------------------------------------------------
+// File formats the deformed target gets exported in, for tools outside the app.
+// Meshes go out as binary little endian PLY or as OBJ, positions, normals and triangles.
+// The mesh's own normals are from before it got dented, so the exported ones are worked
+// out again from the triangles (area weighted).
+// Displacement streams hold the deformation of every simulation step as sparse records,
+// the vertices the step moved and their offset from the rest mesh. Frames are grouped
+// into chunks that can be decoded on their own. Within a chunk the offsets are quantised
+// to 16 bits per axis with one scale for the whole chunk, and every record stores only
+// the change since the vertex's previous record in the chunk, zigzag varint coded, as
+// are the gaps between the sorted vertex indices. Dents move smoothly, so most records
+// end up a few bytes instead of the 16 they take raw.
+//
+// Stream layout, all little endian:
+//   header: "DDSP", uint32 version, uint32 vertex count, float seconds per frame
+//   chunk:  "DCHK", uint32 first frame, uint32 frame count, float scale, uint32 payload bytes, payload
+//   payload, per frame: varint record count, then per record
+//           varint index gap (index - previous index - 1, the first from -1) and
+//           3 zigzag varints, quantised offset minus the vertex's previous one in the chunk (0 before it has one)
+// A vertex's offset is its quantised offset times the chunk's scale, vertices without
+// a record in a frame keep the offset they had. ReadDisplacementStream decodes a stream.
+//-------------------------------------------------------------------------------------
+
+#include<glm\glm.hpp>
+
+#include<string>
+#include<vector>
+#include<fstream>
+#include<algorithm>
+#include<stdint.h>
+#include<stdio.h>
+#include<string.h>
+#include<math.h>
+#include "mesh.h"
+
+namespace MeshExport
+{
+	//Area weighted vertex normals of the triangles as they are now
+	std::vector<glm::vec3> VertexNormals(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices)
+	{
+		std::vector<glm::vec3> normals(positions.size(), glm::vec3(0.0f));
+		for (size_t t = 0; t + 2 < indices.size(); t += 3)
+		{
+			glm::vec3 a = positions[indices[t]], b = positions[indices[t + 1]], c = positions[indices[t + 2]];
+			glm::vec3 faceNormal = glm::cross(b - a, c - a); //its length is twice the area, which weights it
+			normals[indices[t]] += faceNormal;
+			normals[indices[t + 1]] += faceNormal;
+			normals[indices[t + 2]] += faceNormal;
+		}
+		for (glm::vec3& normal : normals)
+		{
+			float length = glm::length(normal);
+			normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+		}
+		return normals;
+	}
+
+	bool WritePly(const std::string& path, const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices)
+	{
+		std::ofstream out(path, std::ios::binary);
+		if (!out)
+			return false;
+		std::vector<glm::vec3> normals = VertexNormals(positions, indices);
+		out << "ply\nformat binary_little_endian 1.0\ncomment deformed target\nelement vertex " << positions.size()
+			<< "\nproperty float x\nproperty float y\nproperty float z\nproperty float nx\nproperty float ny\nproperty float nz\n"
+			<< "element face " << indices.size() / 3 << "\nproperty list uchar int vertex_indices\nend_header\n";
+		//vertices interleaved, faces as a count and three indices, built up in memory and written in one go
+		std::vector<char> data(positions.size() * 6 * sizeof(float) + indices.size() / 3 * (1 + 3 * sizeof(int)));
+		char* cursor = data.data();
+		for (size_t i = 0; i < positions.size(); i++)
+		{
+			memcpy(cursor, &positions[i], sizeof(glm::vec3));
+			memcpy(cursor + sizeof(glm::vec3), &normals[i], sizeof(glm::vec3));
+			cursor += 2 * sizeof(glm::vec3);
+		}
+		for (size_t t = 0; t + 2 < indices.size(); t += 3)
+		{
+			*cursor++ = 3;
+			int triangle[3] = { (int)indices[t], (int)indices[t + 1], (int)indices[t + 2] };
+			memcpy(cursor, triangle, sizeof(triangle));
+			cursor += sizeof(triangle);
+		}
+		out.write(data.data(), data.size());
+		return (bool)out;
+	}
+
+	bool WriteObj(const std::string& path, const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices)
+	{
+		std::ofstream out(path);
+		if (!out)
+			return false;
+		std::vector<glm::vec3> normals = VertexNormals(positions, indices);
+		//formatted with snprintf into one buffer, streams are slow at this many numbers
+		std::string text = "# deformed target\n";
+		char line[128];
+		for (const glm::vec3& position : positions)
+		{
+			int length = snprintf(line, sizeof(line), "v %.7g %.7g %.7g\n", position.x, position.y, position.z);
+			text.append(line, length);
+		}
+		for (const glm::vec3& normal : normals)
+		{
+			int length = snprintf(line, sizeof(line), "vn %.6g %.6g %.6g\n", normal.x, normal.y, normal.z);
+			text.append(line, length);
+		}
+		for (size_t t = 0; t + 2 < indices.size(); t += 3) //OBJ indices start at 1, normals share the vertex index
+		{
+			unsigned int a = indices[t] + 1, b = indices[t + 1] + 1, c = indices[t + 2] + 1;
+			int length = snprintf(line, sizeof(line), "f %u//%u %u//%u %u//%u\n", a, a, b, b, c, c);
+			text.append(line, length);
+		}
+		out.write(text.data(), text.size());
+		return (bool)out;
+	}
+
+	void PutVarint(std::vector<uint8_t>& bytes, uint32_t value)
+	{
+		while (value >= 0x80)
+		{
+			bytes.push_back((uint8_t)(value | 0x80));
+			value >>= 7;
+		}
+		bytes.push_back((uint8_t)value);
+	}
+
+	//Small magnitudes of either sign to small numbers: 0, -1, 1, -2... to 0, 1, 2, 3...
+	void PutZigzag(std::vector<uint8_t>& bytes, int32_t value)
+	{
+		PutVarint(bytes, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+	}
+
+	//Reads a varint at cursor and moves past it, false if it runs past end or over 32 bits
+	bool GetVarint(const uint8_t*& cursor, const uint8_t* end, uint32_t& value)
+	{
+		value = 0;
+		for (int shift = 0; shift < 32 && cursor < end; shift += 7)
+		{
+			uint8_t byte = *cursor++;
+			value |= (uint32_t)(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0)
+				return true;
+		}
+		return false;
+	}
+
+	bool GetZigzag(const uint8_t*& cursor, const uint8_t* end, int32_t& value)
+	{
+		uint32_t coded;
+		if (!GetVarint(cursor, end, coded))
+			return false;
+		value = (int32_t)(coded >> 1) ^ -(int32_t)(coded & 1);
+		return true;
+	}
+
+	//One frame of a displacement stream, the vertices it moved and their offsets from the rest mesh
+	struct DisplacementFrame
+	{
+		std::vector<int> indices;
+		std::vector<glm::vec3> offsets;
+	};
+
+	//Encodes and writes a displacement stream, a chunk per WriteChunk call
+	class DisplacementStreamWriter
+	{
+	public:
+		bool Open(const std::string& path, int vertexCount, float frameTime)
+		{
+			out.open(path, std::ios::binary);
+			if (!out)
+				return false;
+			uint32_t version = 1, count = (uint32_t)vertexCount;
+			out.write("DDSP", 4);
+			Put(version);
+			Put(count);
+			Put(frameTime);
+			lastQuantised.assign(3 * (size_t)vertexCount, 0);
+			chunkStamp.assign(vertexCount, 0);
+			chunkIndex = 0;
+			nextFrame = 0;
+			rawBytes = encodedBytes = 0;
+			return (bool)out;
+		}
+
+		bool IsOpen() const { return out.is_open(); }
+
+		//Frames go in sorted by vertex index (see SortFrame), every index once
+		bool WriteChunk(const std::vector<DisplacementFrame>& frames)
+		{
+			if (!out || frames.empty())
+				return false;
+			float largest = 0.0f;
+			for (const DisplacementFrame& frame : frames)
+			{
+				for (const glm::vec3& offset : frame.offsets)
+					largest = fmaxf(largest, fmaxf(fmaxf(fabsf(offset.x), fabsf(offset.y)), fabsf(offset.z)));
+			}
+			float scale = largest > 0.0f ? largest / 32767.0f : 1.0f;
+			float inverseScale = 1.0f / scale;
+
+			chunkIndex++; //vertices stamped with an older chunk have no previous record in this one
+			payload.clear();
+			for (const DisplacementFrame& frame : frames)
+			{
+				PutVarint(payload, (uint32_t)frame.indices.size());
+				int previous = -1;
+				for (size_t r = 0; r < frame.indices.size(); r++)
+				{
+					int vert = frame.indices[r];
+					PutVarint(payload, (uint32_t)(vert - previous - 1));
+					previous = vert;
+					int16_t* last = &lastQuantised[3 * (size_t)vert];
+					if (chunkStamp[vert] != chunkIndex)
+					{
+						chunkStamp[vert] = chunkIndex;
+						last[0] = last[1] = last[2] = 0;
+					}
+					for (int axis = 0; axis < 3; axis++)
+					{
+						int16_t quantised = (int16_t)std::max(-32767.0f, std::min(32767.0f, roundf(frame.offsets[r][axis] * inverseScale)));
+						PutZigzag(payload, (int32_t)quantised - last[axis]);
+						last[axis] = quantised;
+					}
+				}
+				rawBytes += frame.indices.size() * (sizeof(int) + sizeof(glm::vec3));
+			}
+
+			uint32_t firstFrame = (uint32_t)nextFrame, frameCount = (uint32_t)frames.size(), payloadBytes = (uint32_t)payload.size();
+			out.write("DCHK", 4);
+			Put(firstFrame);
+			Put(frameCount);
+			Put(scale);
+			Put(payloadBytes);
+			out.write((const char*)payload.data(), payload.size());
+			nextFrame += frames.size();
+			encodedBytes += payload.size();
+			return (bool)out;
+		}
+
+		bool Close()
+		{
+			if (!out.is_open())
+				return false;
+			out.close();
+			return !out.fail();
+		}
+
+		int FramesWritten() const { return nextFrame; }
+		size_t RawBytes() const { return rawBytes; } //what the records would take as plain indices and float offsets
+		size_t EncodedBytes() const { return encodedBytes; }
+
+	private:
+		template<typename T>
+		void Put(const T& value)
+		{
+			out.write((const char*)&value, sizeof(T));
+		}
+
+		std::ofstream out;
+		std::vector<uint8_t> payload;
+		std::vector<int16_t> lastQuantised; //per vertex, its latest quantised offset in the current chunk
+		std::vector<unsigned int> chunkStamp; //per vertex, the chunk lastQuantised is from
+		unsigned int chunkIndex = 0;
+		int nextFrame = 0;
+		size_t rawBytes = 0, encodedBytes = 0;
+	};
+
+	//A displacement stream read back, every frame's records with their offsets from the rest mesh
+	struct DisplacementStream
+	{
+		int vertexCount = 0;
+		float frameTime = 0.0f;
+		std::vector<DisplacementFrame> frames;
+	};
+
+	//Reads and decodes a stream written by DisplacementStreamWriter, false if it isn't one or it's cut short or corrupt
+	bool ReadDisplacementStream(const std::string& path, DisplacementStream& stream)
+	{
+		std::ifstream in(path, std::ios::binary);
+		char magic[4] = {};
+		uint32_t version = 0, vertexCount = 0;
+		in.read(magic, 4);
+		in.read((char*)&version, sizeof(version));
+		in.read((char*)&vertexCount, sizeof(vertexCount));
+		in.read((char*)&stream.frameTime, sizeof(stream.frameTime));
+		if (!in || memcmp(magic, "DDSP", 4) != 0 || version != 1)
+			return false;
+		stream.vertexCount = (int)vertexCount;
+		stream.frames.clear();
+
+		std::vector<int16_t> lastQuantised(3 * (size_t)vertexCount);
+		std::vector<unsigned int> chunkStamp(vertexCount, 0); //same as the writer, the chunk lastQuantised is from
+		unsigned int chunkIndex = 0;
+		std::vector<uint8_t> payload;
+		while (true)
+		{
+			char chunkMagic[4];
+			in.read(chunkMagic, 4);
+			if (in.gcount() == 0 && in.eof())
+				return true; //past the last chunk
+			uint32_t firstFrame = 0, frameCount = 0, payloadBytes = 0;
+			float scale = 0.0f;
+			in.read((char*)&firstFrame, sizeof(firstFrame));
+			in.read((char*)&frameCount, sizeof(frameCount));
+			in.read((char*)&scale, sizeof(scale));
+			in.read((char*)&payloadBytes, sizeof(payloadBytes));
+			if (!in || memcmp(chunkMagic, "DCHK", 4) != 0 || firstFrame != stream.frames.size())
+				return false;
+			payload.resize(payloadBytes);
+			in.read((char*)payload.data(), payloadBytes);
+			if (!in)
+				return false;
+
+			chunkIndex++;
+			const uint8_t* cursor = payload.data();
+			const uint8_t* end = payload.data() + payload.size();
+			for (uint32_t f = 0; f < frameCount; f++)
+			{
+				DisplacementFrame frame;
+				uint32_t recordCount;
+				if (!GetVarint(cursor, end, recordCount) || recordCount > vertexCount)
+					return false;
+				frame.indices.resize(recordCount);
+				frame.offsets.resize(recordCount);
+				int64_t previous = -1;
+				for (uint32_t r = 0; r < recordCount; r++)
+				{
+					uint32_t gap;
+					if (!GetVarint(cursor, end, gap) || previous + gap + 1 >= vertexCount)
+						return false;
+					int vert = (int)(previous + gap + 1);
+					previous = vert;
+					int16_t* last = &lastQuantised[3 * (size_t)vert];
+					if (chunkStamp[vert] != chunkIndex)
+					{
+						chunkStamp[vert] = chunkIndex;
+						last[0] = last[1] = last[2] = 0;
+					}
+					for (int axis = 0; axis < 3; axis++)
+					{
+						int32_t delta;
+						if (!GetZigzag(cursor, end, delta) || last[axis] + delta < -32767 || last[axis] + delta > 32767)
+							return false;
+						last[axis] = (int16_t)(last[axis] + delta);
+					}
+					frame.indices[r] = vert;
+					frame.offsets[r] = glm::vec3((float)last[0], (float)last[1], (float)last[2]) * scale;
+				}
+				stream.frames.push_back(std::move(frame));
+			}
+			if (cursor != end)
+				return false;
+		}
+	}
+
+	//Sorts the records of a frame by vertex index, which the index gaps need
+	void SortFrame(DisplacementFrame& frame, std::vector<std::pair<int, glm::vec3>>& scratch)
+	{
+		scratch.resize(frame.indices.size());
+		for (size_t r = 0; r < frame.indices.size(); r++)
+			scratch[r] = std::make_pair(frame.indices[r], frame.offsets[r]);
+		std::sort(scratch.begin(), scratch.end(), [](const std::pair<int, glm::vec3>& a, const std::pair<int, glm::vec3>& b) { return a.first < b.first; });
+		for (size_t r = 0; r < scratch.size(); r++)
+		{
+			frame.indices[r] = scratch[r].first;
+			frame.offsets[r] = scratch[r].second;
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,326 @@
+#ifndef MESH_REFINEMENT_H
+#define MESH_REFINEMENT_H
+//-------------------------------------------------------------------------------------
+// Local refinement of a triangle mesh by longest edge bisection, Rivara's LEPP style: a
+// triangle is only ever split along its longest edge, and if the neighbour across that
+// edge has a longer one, the neighbour gets split first. The mesh stays conforming (no
+// T-junctions) and the new triangles are never thinner than the ones they came from.
+// Only triangles touching a sphere are refined, until their longest edge is short enough,
+// the rest of the mesh is left alone apart from the neighbours LEPP has to split.
+// A split triangle keeps its place in the index buffer as its first half, the second half
+// and the midpoints go on the end, and the octree leaves are patched per triangle, so only
+// the changed part of the buffers has to be uploaded (see Mesh::UpdateBufferGrowth).
+// Vertices at the same position (seams of split normals/uvs, give or take rounding) are
+// welded, so both sides of a seam get split at the same point.
+//-------------------------------------------------------------------------------------
+
+#include<glm\glm.hpp>
+
+#include<vector>
+#include<unordered_map>
+#include<utility>
+#include<climits>
+#include<stdint.h>
+#include "mesh.h"
+#include "triangleOctree.h"
+#include "spatialHash.h"
+#include "profiler.h"
+
+struct RefinementResult
+{
+	int firstNewVertex = 0; //vertices from here on are new midpoints
+	int firstChangedIndex = INT_MAX; //the index buffer changed from here to the end, INT_MAX if it didn't
+	std::vector<std::pair<int, int>> parents; //per new vertex, the two vertices of the edge it split
+	int splits = 0; //triangles split
+	bool reachedBudget = false; //stopped before every triangle in the sphere was small enough
+};
+
+class MeshRefinement
+{
+public:
+	//The tree has to be built over the mesh, it's kept in step with it
+	MeshRefinement(Mesh& mesh, Octree& tree) : mesh(mesh), tree(tree)
+	{
+	}
+
+	//Splits the triangles touching the sphere until none of their edges is longer than maxEdge, adding at most
+	//maxNewTriangles triangles
+	RefinementResult RefineAround(glm::vec3 center, float radius, float maxEdge, int maxNewTriangles)
+	{
+		PROFILE_ZONE("mesh refinement");
+		RefinementResult result;
+		result.firstNewVertex = (int)mesh.vertices.size();
+		this->result = &result;
+		this->center = center;
+		this->radius = radius;
+		maxEdgeSquared = maxEdge * maxEdge;
+		triangleLimit = TriangleCount() + maxNewTriangles;
+		BuildTopology();
+
+		for (int t = 0; t < TriangleCount(); t++)
+			queue.push_back(t);
+		while (!queue.empty())
+		{
+			int t = queue.back();
+			queue.pop_back();
+			if (!NeedsSplit(t))
+				continue;
+			if (TriangleCount() >= triangleLimit)
+			{
+				result.reachedBudget = true;
+				break;
+			}
+			SplitLongestEdgePath(t);
+		}
+		queue.clear();
+		this->result = nullptr;
+		return result;
+	}
+
+private:
+	int TriangleCount() const
+	{
+		return (int)mesh.indices.size() / 3;
+	}
+
+	static uint64_t EdgeKey(int nodeA, int nodeB)
+	{
+		if (nodeA > nodeB)
+			std::swap(nodeA, nodeB);
+		return ((uint64_t)(uint32_t)nodeA << 32) | (uint32_t)nodeB;
+	}
+
+	//Welds the vertices into nodes and lists the triangles of every edge
+	void BuildTopology()
+	{
+		std::vector<glm::vec3> positions(mesh.vertices.size());
+		for (size_t i = 0; i < mesh.vertices.size(); i++)
+			positions[i] = mesh.vertices[i].Position;
+		//seams of generated meshes (a sphere closing at 2 pi) don't always land on the exact same float
+		float cellSize = SpatialHash::SurfaceCellSize(positions);
+		glm::vec3 tolerance(cellSize * 1e-3f);
+		float toleranceSquared = tolerance.x * tolerance.x;
+		SpatialHash hash;
+		hash.Build(positions, cellSize);
+		nodeOf.assign(positions.size(), -1);
+		nodePosition.clear();
+		for (int i = 0; i < (int)positions.size(); i++)
+		{
+			int same = -1;
+			hash.Query(positions[i] - tolerance, positions[i] + tolerance, [&](int j)
+			{
+				glm::vec3 offset = positions[j] - positions[i];
+				if (j < i && glm::dot(offset, offset) <= toleranceSquared && (same < 0 || j < same))
+					same = j;
+			});
+			if (same < 0)
+			{
+				nodeOf[i] = (int)nodePosition.size();
+				nodePosition.push_back(positions[i]);
+			}
+			else
+				nodeOf[i] = nodeOf[same];
+		}
+
+		edgeTriangles.clear();
+		midpoints.clear();
+		for (int t = 0; t < TriangleCount(); t++)
+		{
+			for (int corner = 0; corner < 3; corner++)
+			{
+				int a = nodeOf[mesh.indices[3 * t + corner]], b = nodeOf[mesh.indices[3 * t + (corner + 1) % 3]];
+				if (a != b)
+					edgeTriangles[EdgeKey(a, b)].push_back(t);
+			}
+		}
+	}
+
+	//Corner whose edge (to the next corner) is the longest, ties go to the larger key so neighbours always agree
+	int LongestCorner(int t) const
+	{
+		int longest = 0;
+		float longestSquared = -1.0f;
+		uint64_t longestKey = 0;
+		for (int corner = 0; corner < 3; corner++)
+		{
+			int a = nodeOf[mesh.indices[3 * t + corner]], b = nodeOf[mesh.indices[3 * t + (corner + 1) % 3]];
+			//measured from the lower node, so both triangles of an edge get the exact same length
+			glm::vec3 edge = nodePosition[std::max(a, b)] - nodePosition[std::min(a, b)];
+			float squared = glm::dot(edge, edge);
+			uint64_t key = EdgeKey(a, b);
+			if (squared > longestSquared || (squared == longestSquared && key > longestKey))
+			{
+				longest = corner;
+				longestSquared = squared;
+				longestKey = key;
+			}
+		}
+		return longest;
+	}
+
+	uint64_t CornerKey(int t, int corner) const
+	{
+		return EdgeKey(nodeOf[mesh.indices[3 * t + corner]], nodeOf[mesh.indices[3 * t + (corner + 1) % 3]]);
+	}
+
+	float LongestEdgeSquared(int t) const
+	{
+		int corner = LongestCorner(t);
+		glm::vec3 edge = mesh.vertices[mesh.indices[3 * t + (corner + 1) % 3]].Position - mesh.vertices[mesh.indices[3 * t + corner]].Position;
+		return glm::dot(edge, edge);
+	}
+
+	//Conservative, tests the sphere against the bounding box of the triangle
+	bool TouchesSphere(int t) const
+	{
+		glm::vec3 v0 = mesh.vertices[mesh.indices[3 * t]].Position;
+		glm::vec3 v1 = mesh.vertices[mesh.indices[3 * t + 1]].Position;
+		glm::vec3 v2 = mesh.vertices[mesh.indices[3 * t + 2]].Position;
+		glm::vec3 closest = glm::clamp(center, glm::min(glm::min(v0, v1), v2), glm::max(glm::max(v0, v1), v2));
+		glm::vec3 offset = center - closest;
+		return glm::dot(offset, offset) <= radius * radius;
+	}
+
+	bool NeedsSplit(int t) const
+	{
+		return TouchesSphere(t) && LongestEdgeSquared(t) > maxEdgeSquared;
+	}
+
+	//Another triangle on the edge, -1 on the boundary
+	int Neighbour(int t, uint64_t key) const
+	{
+		auto found = edgeTriangles.find(key);
+		if (found == edgeTriangles.end())
+			return -1;
+		for (int other : found->second)
+		{
+			if (other != t)
+				return other;
+		}
+		return -1;
+	}
+
+	//Walks from t to the neighbour across the longest edge while that one's longest edge is longer, splits the
+	//last edge (longest for both of its triangles) and goes back, until t itself has been split
+	//Every step along the path has a strictly longer edge, so it can't go in circles
+	void SplitLongestEdgePath(int t)
+	{
+		path.clear();
+		path.push_back(t);
+		while (!path.empty())
+		{
+			if (TriangleCount() >= triangleLimit)
+			{
+				result->reachedBudget = true;
+				return;
+			}
+			int current = path.back();
+			uint64_t key = CornerKey(current, LongestCorner(current));
+			int neighbour = Neighbour(current, key);
+			if (neighbour >= 0 && CornerKey(neighbour, LongestCorner(neighbour)) != key)
+			{
+				path.push_back(neighbour);
+				continue;
+			}
+			SplitEdge(key);
+			path.pop_back();
+		}
+	}
+
+	//Midpoint of the edge between vertices a and b, one per pair of vertices, so seams get one on each side
+	int Midpoint(int a, int b, int node)
+	{
+		uint64_t key = a < b ? ((uint64_t)a << 32) | (uint32_t)b : ((uint64_t)b << 32) | (uint32_t)a;
+		auto found = midpoints.find(key);
+		if (found != midpoints.end())
+			return found->second;
+
+		const Vertex& va = mesh.vertices[a];
+		const Vertex& vb = mesh.vertices[b];
+		Vertex middle;
+		middle.Position = nodePosition[node];
+		glm::vec3 normal = va.Normal + vb.Normal;
+		middle.Normal = glm::dot(normal, normal) > 0.0f ? glm::normalize(normal) : va.Normal;
+		middle.TexCoords = (va.TexCoords + vb.TexCoords) * 0.5f;
+		middle.Tangent = (va.Tangent + vb.Tangent) * 0.5f;
+		middle.Bitangent = (va.Bitangent + vb.Bitangent) * 0.5f;
+		int index = (int)mesh.vertices.size();
+		mesh.vertices.push_back(middle);
+		nodeOf.push_back(node);
+		result->parents.push_back(std::make_pair(a, b));
+		midpoints[key] = index;
+		return index;
+	}
+
+	void ReplaceOnEdge(uint64_t key, int from, int to)
+	{
+		std::vector<int>& triangles = edgeTriangles[key];
+		for (int& t : triangles)
+		{
+			if (t == from)
+				t = to;
+		}
+	}
+
+	//Splits every triangle on the edge at its midpoint, a b c becomes a m c in place and m b c on the end
+	void SplitEdge(uint64_t key)
+	{
+		std::vector<int> triangles = std::move(edgeTriangles[key]);
+		edgeTriangles.erase(key);
+		int nodeA = (int)(key >> 32), nodeB = (int)(key & 0xffffffffu);
+		int middleNode = (int)nodePosition.size();
+		nodePosition.push_back((nodePosition[nodeA] + nodePosition[nodeB]) * 0.5f);
+
+		for (int t : triangles)
+		{
+			int corner = 0;
+			while (corner < 3 && CornerKey(t, corner) != key)
+				corner++;
+			if (corner == 3)
+				continue;
+			unsigned int* tri = &mesh.indices[3 * t];
+			int a = tri[corner], b = tri[(corner + 1) % 3], c = tri[(corner + 2) % 3];
+			int m = Midpoint(a, b, middleNode);
+			tree.RemoveTriangle(Triangle(tri[0], tri[1], tri[2]));
+
+			int u = TriangleCount();
+			unsigned int second[3] = { tri[0], tri[1], tri[2] };
+			second[corner] = m;
+			tri[(corner + 1) % 3] = m; //tri is invalid after the indices grow
+			mesh.indices.insert(mesh.indices.end(), second, second + 3);
+			result->firstChangedIndex = std::min(result->firstChangedIndex, 3 * t);
+			result->splits++;
+
+			int na = nodeOf[a], nb = nodeOf[b], nc = nodeOf[c];
+			ReplaceOnEdge(EdgeKey(nb, nc), t, u);
+			edgeTriangles[EdgeKey(na, middleNode)].push_back(t);
+			edgeTriangles[EdgeKey(middleNode, nb)].push_back(u);
+			std::vector<int>& toOpposite = edgeTriangles[EdgeKey(middleNode, nc)];
+			toOpposite.push_back(t);
+			toOpposite.push_back(u);
+
+			tree.AddTriangle(Triangle(mesh.indices[3 * t], mesh.indices[3 * t + 1], mesh.indices[3 * t + 2]));
+			tree.AddTriangle(Triangle(mesh.indices[3 * u], mesh.indices[3 * u + 1], mesh.indices[3 * u + 2]));
+			queue.push_back(t);
+			queue.push_back(u);
+		}
+	}
+
+	Mesh& mesh;
+	Octree& tree;
+
+	//State of the current RefineAround
+	RefinementResult* result = nullptr;
+	glm::vec3 center;
+	float radius = 0.0f;
+	float maxEdgeSquared = 0.0f;
+	int triangleLimit = 0;
+	std::vector<int> nodeOf; //per vertex, the welded node
+	std::vector<glm::vec3> nodePosition; //per node
+	std::unordered_map<uint64_t, std::vector<int>> edgeTriangles; //per edge between two nodes, the triangles on it
+	std::unordered_map<uint64_t, int> midpoints; //per pair of vertices that got split, the midpoint vertex
+	std::vector<int> queue; //triangles that may still need splitting
+	std::vector<int> path; //the longest edge path being split
+};
+
+#endif
@@ -13,6 +13,7 @@
 
 #include "mesh.h"
 #include "shader.h"
+#include "logger.h"
 
 #include <string>
 #include <fstream>
@@ -43,14 +44,20 @@ public:
 
 	/*  Functions   */
 	// constructor, expects a filepath to a 3D model.
-	Model(string const& path, bool isDynamic, bool gamma = false) : gammaCorrection(gamma)
+	// without createBuffers the meshes stay CPU only and no textures are loaded (no GL context needed, e.g. for headless runs)
+	Model(string const& path, bool isDynamic, bool gamma = false, bool createBuffers = true) : gammaCorrection(gamma), createBuffers(createBuffers)
 	{
 		loadModel(path, isDynamic);
-		std::cout << "Num indices from loader: " << this->meshes[0].indices.size() << "\n";
+		if (!this->meshes.empty()) // nothing got loaded if the file couldn't be read
+			LOG_DEBUG("Num indices from loader: " << this->meshes[0].indices.size());
+	}
+	// constructor for meshes built in code (procedural geometry), nothing gets loaded
+	Model(vector<Mesh> meshes, bool gamma = false) : meshes(std::move(meshes)), gammaCorrection(gamma)
+	{
 	}
 
 	// draws the model, and thus all its meshes
-	void Draw(Shader shader)
+	void Draw(Shader& shader)
 	{
 		for (unsigned int i = 0; i < meshes.size(); i++)
 			meshes[i].Draw(shader);
@@ -74,6 +81,8 @@ public:
 	}
 
 private:
+	bool createBuffers = true;
+
 	/*  Functions   */
 	// loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
 	void loadModel(string const& path, bool isDynamic)
@@ -84,7 +93,7 @@ private:
 		// check for errors
 		if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
 		{
-			cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+			LOG_ERROR("ERROR::ASSIMP:: " << importer.GetErrorString());
 			return;
 		}
 		// retrieve the directory path of the filepath
@@ -119,10 +128,11 @@ private:
 		vector<Vertex> vertices;
 		vector<unsigned int> indices;
 		vector<Texture> textures;
+		vertices.reserve(mesh->mNumVertices);
+		indices.reserve(mesh->mNumFaces * 3);
 
 		// Walk through each of the mesh's vertices
-		std::cout << "Num verts from loader: " << mesh->mNumVertices << "\n"; //TODO: delete debug output later
-		std::cout << "Num faces from loader: " << mesh->mNumFaces << "\n";
+		LOG_DEBUG("Num verts from loader: " << mesh->mNumVertices << ", num faces from loader: " << mesh->mNumFaces);
 		for (unsigned int i = 0; i < mesh->mNumVertices; i++)
 		{
 			Vertex vertex;
@@ -193,6 +203,10 @@ private:
 		material->Get(AI_MATKEY_SHININESS, shininess);
 		this->material.shininess = shininess;
 
+		// CPU only meshes don't need the textures either
+		if (!createBuffers)
+			return Mesh(std::move(vertices), std::move(indices), std::move(textures), isDynamic, false);
+
 		// 1. diffuse maps
 		vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
 		textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
@@ -206,8 +220,8 @@ private:
 		std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
 		textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
 
-		// return a mesh object created from the extracted mesh data
-		return Mesh(vertices, indices, textures, isDynamic);
+		// return a mesh object created from the extracted mesh data, moving it in instead of copying
+		return Mesh(std::move(vertices), std::move(indices), std::move(textures), isDynamic);
 	}
 
 	// checks all material textures of a given type and loads the textures if they're not loaded yet.
@@ -277,7 +291,7 @@ unsigned int TextureFromFile(const char* path, const string & directory, bool ga
 	}
 	else
 	{
-		std::cout << "Texture failed to load at path: " << path << std::endl;
+		LOG_ERROR("Texture failed to load at path: " << path);
 		stbi_image_free(data);
 	}
 
@@ -14,7 +14,6 @@ struct DirLight {
     vec3 diffuse;
     vec3 specular;
 };
-uniform DirLight dirLight;
 
 struct FlashLight {
 	vec3 position;
@@ -28,26 +27,35 @@ struct FlashLight {
 };
 uniform FlashLight flashLight;
 
+//member order follows the std140 packing of PointLightData on the C++ side
 struct PointLight {
     vec3 position;
-  
 	float constant;
-	float linear;
-	float quadratic;
-
     vec3 ambient;
+	float linear;
     vec3 diffuse;
+	float quadratic;
     vec3 specular;
 };
 #define NR_PLIGHTS 4
-uniform PointLight pointLights[NR_PLIGHTS];
+
+//shared by all programs, see uniformBlocks.h
+layout (std140) uniform Lights
+{
+	PointLight pointLights[NR_PLIGHTS];
+	DirLight dirLight;
+};
+layout (std140) uniform Camera
+{
+	mat4 view;
+	mat4 projection;
+	vec3 viewPos;
+};
 
 in vec3 Normal;
 in vec3 FragPos;
 in vec2 TexCoords;
 
-uniform vec3 viewPos;
-
 out vec4 FragColor;
 
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
@@ -16,11 +16,37 @@
 #include<fstream>
 #include<utility>
 #include<set>
+#include<climits>
+#include<mutex>
+#include<algorithm>
+#include<chrono>
 #include "optimalTarget.h"
 #include "shader.h"
 #include "model.h"
 #include "rayUtil.h"
 #include "triangleOctree.h"
+#include "jobSystem.h"
+#include "profiler.h"
+#include "logger.h"
+#include "debugLines.h"
+#include "surfaceRelaxation.h"
+
+//Time spent in each phase of the simulation since the projectile was created, in seconds
+struct SimPhaseTimes
+{
+	double rayCasting = 0.0; //swept check and both ray passes
+	double falloff = 0.0; //applying the hits, spreading them over the neighbouring vertices
+	double vertexUpdate = 0.0; //denting the target, moving the projectile
+	double relaxation = 0.0; //relaxing the surface around the dent, if it's enabled
+};
+
+//A ray that hit something this step, tri for rays cast onto the target, vertexIndex for the inverse ones
+struct RayHit
+{
+	Triangle tri;
+	int vertexIndex = -1;
+	glm::vec3 hitPoint;
+};
 
 class OctreeProjectile
 {
@@ -29,51 +55,13 @@ public:
 		projectileMesh(meshPath.c_str(), true), acceleration(accel),
 		rayShader("../OpenGL_DeformProj/ray.vert", "../OpenGL_DeformProj/ray.frag")
 	{
-		rayDirection = acceleration;
-		speed = acceleration;
-		std::cout << "Successfully constructed projectile ";
-
-		float minX, minY, minZ, maxX, maxY, maxZ;
-		minX = projectileMesh.meshes[0].vertices[0].Position.x; maxX = minX;
-		minY = projectileMesh.meshes[0].vertices[0].Position.y; maxY = minY;
-		minZ = projectileMesh.meshes[0].vertices[0].Position.z; maxZ = minZ;
-		for (int i = 1; i < projectileMesh.meshes[0].vertices.size(); i++)
-		{
-			if (projectileMesh.meshes[0].vertices[i].Position.x <= minX)
-				minX = projectileMesh.meshes[0].vertices[i].Position.x;
-			if (projectileMesh.meshes[0].vertices[i].Position.x >= maxX)
-				maxX = projectileMesh.meshes[0].vertices[i].Position.x;
-
-			if (projectileMesh.meshes[0].vertices[i].Position.y <= minY)
-				minY = projectileMesh.meshes[0].vertices[i].Position.y;
-			if (projectileMesh.meshes[0].vertices[i].Position.y >= maxY)
-				maxY = projectileMesh.meshes[0].vertices[i].Position.y;
-
-			if (projectileMesh.meshes[0].vertices[i].Position.z <= minZ)
-				minZ = projectileMesh.meshes[0].vertices[i].Position.z;
-			if (projectileMesh.meshes[0].vertices[i].Position.z >= maxZ)
-				maxZ = projectileMesh.meshes[0].vertices[i].Position.z;
-
-		}
-		std::cout << "min/max X: " << minX << " " << maxX << "\nmin/max Y: " << minY << " " << maxY <<
-			"\nmin/max Z: " << minZ << " " << maxZ << "\n";
-		boundingBoxSize = fmaxf(fmaxf(maxX - minX, maxY - minY), maxZ - minZ);
-		boundingBoxCenter = glm::vec3((maxX + minX) / 2, (maxY + minY) / 2, (maxZ + minZ) / 2);
-		std::cout << "bounding box size: " << boundingBoxSize << "\n";
-		std::cout << "bounding box center: " << boundingBoxCenter.x << boundingBoxCenter.y << boundingBoxCenter.z << "\n";
-		
-		boundingBoxCenterOffset = boundingBoxCenter;
-		/*
-		for (int i = 0; i < projectileMesh.meshes[0].vertices.size(); i++)
-		{
-			projectileMesh.meshes[0].vertices[i].Position += glm::vec3(0, 3.0f, 0); //Change position of all vertices
-			projectileMesh.meshes[0].UpdateBufferVertexDirect(i);
-		}*/
-
-		OptimizeVertices();
-		std::cout << "optimized verts size: " << optimizedVerts.size() << "\n";
-
-		//std::cout << projectileMesh.meshes[0].vertices.size();//.vertices.size();
+		Init();
+	}
+	//Projectile from a model built in code (procedural geometry), for headless runs, its rays can't be rendered
+	OctreeProjectile(Model mesh, glm::vec3 accel) :
+		projectileMesh(std::move(mesh)), acceleration(accel)
+	{
+		Init();
 	}
 
 	void SetupTree(Octree& tree)
@@ -88,6 +76,13 @@ public:
 		tree.InsertTriangles(modelTris);
 	}
 
+	//Takes the rest lengths of the relaxation from the target as it is now, call it once the target is final (refined) and before it's dented
+	void SetupRelaxation(const Mesh& targetMesh)
+	{
+		if (relaxSettings.enabled)
+			relaxation.Setup(targetMesh);
+	}
+
 	//Casts a single ray on a given triangle of a target, given the ray origin (transformed using a model matrix)
 	bool CastRay(OctreeTarget& target, int indexv0, int indexv1, int indexv2, glm::vec3 rayOrigin, glm::mat4 model, float& hitDistance)
 	{
@@ -105,91 +100,280 @@ public:
 		return RayUtil::MTRayCheck(vert0, vert1, vert2, model * glm::vec4(rayOrigin, 1.0f), glm::normalize(-rayDirection), hitDistance);
 	}
 
-	void ProcessRays(Octree& tree, Octree& projectileTree, OctreeTarget& target /*glm::mat4 model*/)
+	//Continuous collision check, sweeps every projectile triangle over displacement and tests it against the target
+	//triangles in the leaves overlapping the swept bounding box
+	//Returns the earliest time of impact as a fraction of displacement (0 to 1), or -1 if nothing gets hit
+	float SweepTimeOfImpact(Octree& tree, glm::vec3 displacement, Triangle& hitTriangle, glm::vec3& contactPoint)
+	{
+		const std::vector<Vertex>& projVerts = projectileMesh.meshes[0].vertices;
+		const std::vector<unsigned int>& projIndices = projectileMesh.meshes[0].indices;
+
+		//swept bounds of every projectile triangle, and of the whole projectile
+		std::vector<glm::vec3> sweptMin(projIndices.size() / 3), sweptMax(projIndices.size() / 3);
+		glm::vec3 boxMin = glm::vec3(FLT_MAX), boxMax = glm::vec3(-FLT_MAX);
+		for (int i = 0; i < projIndices.size(); i += 3)
+		{
+			glm::vec3 triMin = projVerts[projIndices[i]].Position, triMax = triMin;
+			for (int k = 1; k < 3; k++)
+			{
+				triMin = glm::min(triMin, projVerts[projIndices[i + k]].Position);
+				triMax = glm::max(triMax, projVerts[projIndices[i + k]].Position);
+			}
+			sweptMin[i / 3] = glm::min(triMin, triMin + displacement);
+			sweptMax[i / 3] = glm::max(triMax, triMax + displacement);
+			boxMin = glm::min(boxMin, sweptMin[i / 3]);
+			boxMax = glm::max(boxMax, sweptMax[i / 3]);
+		}
+
+		float earliest = FLT_MAX;
+		tree.QueryBox(boxMin, boxMax, [&](OctreeNode* leaf)
+		{
+			for (int t = 0; t < leaf->tris->size(); t++)
+			{
+				glm::vec3 corners[3];
+				tree.LeafTriangle(leaf, t, corners);
+				const glm::vec3& b0 = corners[0];
+				const glm::vec3& b1 = corners[1];
+				const glm::vec3& b2 = corners[2];
+				glm::vec3 targetMin = glm::min(glm::min(b0, b1), b2);
+				glm::vec3 targetMax = glm::max(glm::max(b0, b1), b2);
+
+				for (int i = 0; i < projIndices.size(); i += 3)
+				{
+					const glm::vec3& triMin = sweptMin[i / 3];
+					const glm::vec3& triMax = sweptMax[i / 3];
+					if (triMin.x > targetMax.x || triMax.x < targetMin.x || triMin.y > targetMax.y || triMax.y < targetMin.y ||
+						triMin.z > targetMax.z || triMax.z < targetMin.z)
+						continue; //their swept bounds don't even touch
+
+					float toi;
+					glm::vec3 contact;
+					if (RayUtil::SweptTriangleCheck(projVerts[projIndices[i]].Position, projVerts[projIndices[i + 1]].Position,
+						projVerts[projIndices[i + 2]].Position, b0, b1, b2, displacement, toi, contact) && toi < earliest)
+					{
+						earliest = toi;
+						hitTriangle = (*leaf->tris)[t];
+						contactPoint = contact;
+					}
+				}
+			}
+		});
+
+		return earliest == FLT_MAX ? -1.0f : earliest;
+	}
+
+	//Finds what the projectile runs into if it moves by step
+	void ProcessRays(Octree& tree, Octree& projectileTree, OctreeTarget& target, glm::vec3 step /*glm::mat4 model*/)
 	{
+		PROFILE_ZONE("ProcessRays");
+		//sweep the whole projectile over this step first, the rays alone miss thin features between the ray origins
+		//and let fast projectiles tunnel through the target
+		std::chrono::steady_clock::time_point phaseStart = std::chrono::steady_clock::now();
+		Triangle sweptHit;
+		glm::vec3 contactPoint;
+		{
+			PROFILE_ZONE("swept check");
+			timeOfImpact = SweepTimeOfImpact(tree, step, sweptHit, contactPoint);
+		}
+		LapPhase(phaseTimes.rayCasting, phaseStart);
+		if (timeOfImpact >= 0.0f)
+		{
+			acceleration = -rayDirection;
+			affectedVerts.insert(sweptHit.index0);
+			affectedVerts.insert(sweptHit.index1);
+			affectedVerts.insert(sweptHit.index2);
+			target.vertInfo[sweptHit.index0].hitIntensity = 1.0f;
+			target.vertInfo[sweptHit.index1].hitIntensity = 1.0f;
+			target.vertInfo[sweptHit.index2].hitIntensity = 1.0f;
+
+			collision = true;
+			CalcLocalFalloff(tree, target, contactPoint);
+		}
+		LapPhase(phaseTimes.falloff, phaseStart);
+
+		//the rays only read the trees, so they're cast in parallel and their hits are applied afterwards,
+		//in ray order, which keeps the result the same no matter how the work was split between threads
+		std::vector<RayHit> hits;
+
 		//cast rays from projectile onto target
-		for (auto vertexPos : optimizedVerts)
+		float stepLength = glm::length(step);
+		CastRaysParallel("forward rays", (int)optimizedVerts.size(), 16, hits, [&](int v, std::vector<RayHit>& chunkHits)
 		{ //search for each ray on the projectile model
-			OctreeNode* targetOctant = tree.FindOctant(vertexPos + speed);
-			if (targetOctant != nullptr)
+			glm::vec3 vertexPos = optimizedVerts[v];
+			size_t firstHit = chunkHits.size();
+			//every target leaf the ray passes through this step, not only the one it ends up in
+			tree.QuerySphereLeaves(vertexPos + step * 0.5f, stepLength * 0.5f, [&](OctreeNode* leaf)
 			{
-				if (targetOctant->tris != nullptr)
+				for (int i = 0; i < leaf->tris->size(); i++)
 				{
-					if (targetOctant->tris->size() > 0)
+					const Triangle& tri = (*leaf->tris)[i];
+					glm::vec3 corners[3];
+					tree.LeafTriangle(leaf, i, corners);
+					float hitDistance = FLT_MAX;
+					bool rayResult = RayUtil::MTRayCheck(corners[0], corners[1], corners[2], vertexPos, glm::normalize(rayDirection), hitDistance);
+					if (rayResult && (hitDistance < stepLength)) // there's gonna be a hit next frame
 					{
-						for (int i = 0; i < targetOctant->tris->size(); i++)
-						{
-							glm::vec3 vert0 = tree.model.meshes[0].vertices[(*targetOctant->tris)[i].index0].Position;
-							glm::vec3 vert1 = tree.model.meshes[0].vertices[(*targetOctant->tris)[i].index1].Position;
-							glm::vec3 vert2 = tree.model.meshes[0].vertices[(*targetOctant->tris)[i].index2].Position;
-							float hitDistance = FLT_MAX;
-							bool rayResult = RayUtil::MTRayCheck(vert0, vert1, vert2, vertexPos, glm::normalize(rayDirection), hitDistance);
-							if (rayResult && (hitDistance < glm::length(speed))) // there's gonna be a hit next frame
-							{
-								//odmah ovde dentuj da ne bi radio pretragu bezveze
-								acceleration = -rayDirection;
-								affectedVerts.insert((*targetOctant->tris)[i].index0);
-								affectedVerts.insert((*targetOctant->tris)[i].index1);
-								affectedVerts.insert((*targetOctant->tris)[i].index2);
-								target.vertInfo[(*targetOctant->tris)[i].index0].hitIntensity = 1.0f;
-								target.vertInfo[(*targetOctant->tris)[i].index1].hitIntensity = 1.0f;
-								target.vertInfo[(*targetOctant->tris)[i].index2].hitIntensity = 1.0f;
-
-								collision = true;
-								glm::vec3 hitPoint = vertexPos + hitDistance * glm::normalize(rayDirection);
-
-								CalcLocalFalloff(tree, target, targetOctant, hitPoint);
-								//return true;
-							}
-						}
-						//return false;
+						//triangles spanning several leaves come up once per leaf, the ray only hits them once
+						bool known = false;
+						for (size_t h = firstHit; h < chunkHits.size() && !known; h++)
+							known = chunkHits[h].tri.index0 == tri.index0 && chunkHits[h].tri.index1 == tri.index1 && chunkHits[h].tri.index2 == tri.index2;
+						if (known)
+							continue;
+						RayHit hit;
+						hit.tri = tri;
+						hit.hitPoint = vertexPos + hitDistance * glm::normalize(rayDirection);
+						chunkHits.push_back(hit);
 					}
 				}
-			}
-			
+			});
+		});
+		LapPhase(phaseTimes.rayCasting, phaseStart);
+		for (const RayHit& hit : hits)
+		{
+			acceleration = -rayDirection;
+			affectedVerts.insert(hit.tri.index0);
+			affectedVerts.insert(hit.tri.index1);
+			affectedVerts.insert(hit.tri.index2);
+			target.vertInfo[hit.tri.index0].hitIntensity = 1.0f;
+			target.vertInfo[hit.tri.index1].hitIntensity = 1.0f;
+			target.vertInfo[hit.tri.index2].hitIntensity = 1.0f;
+
+			collision = true;
+			CalcLocalFalloff(tree, target, hit.hitPoint);
 		}
+		LapPhase(phaseTimes.falloff, phaseStart);
+
 		//cast rays from target onto projectile (inverse)
-		
-		for (int i = 0; i < target.targetModel.meshes[0].vertices.size(); i++)
+		hits.clear();
+		CastRaysParallel("inverse rays", (int)target.targetModel.meshes[0].vertices.size(), 256, hits, [&](int i, std::vector<RayHit>& chunkHits)
 		{
-			
 			glm::vec3 vertexPos = target.targetModel.meshes[0].vertices[i].Position;
-			OctreeNode* targetOctant = projectileTree.FindOctant(vertexPos - speed);
-			int indexX = projectileTree.calcNodeIndexX(targetOctant);
-			int indexY = projectileTree.calcNodeIndexY(targetOctant);
-			int indexZ = projectileTree.calcNodeIndexZ(targetOctant);
-
-
-			for (int x = max(indexX - 3, 0); x < min(indexX + 3, 7); x++)
+			//only the projectile leaves touching the path the ray covers this step can be hit
+			projectileTree.QuerySphereLeaves(vertexPos - step * 0.5f, stepLength * 0.5f, [&](OctreeNode* leaf)
 			{
-				for (int z = max(indexZ - 3, 0); z < min(indexZ + 3, 7); z++)
+				for (int j = 0; j < leaf->tris->size(); j++)
 				{
-					if (targetOctant != nullptr)
+					glm::vec3 vert0 = projectileTree.model.meshes[0].vertices[(*leaf->tris)[j].index0].Position;
+					glm::vec3 vert1 = projectileTree.model.meshes[0].vertices[(*leaf->tris)[j].index1].Position;
+					glm::vec3 vert2 = projectileTree.model.meshes[0].vertices[(*leaf->tris)[j].index2].Position;
+					float hitDistance;
+					bool rayResult = RayUtil::MTRayCheck(vert0, vert1, vert2, vertexPos, glm::normalize(-rayDirection), hitDistance);
+					if (rayResult && hitDistance < stepLength)
 					{
-						if (projectileTree.arrayRepresentation[x][indexY][z]->tris != nullptr && projectileTree.arrayRepresentation[x][indexY][z]->tris->size() > 0)
-						{
-							float hitDistance;
-							for (int j = 0; j < projectileTree.arrayRepresentation[x][indexY][z]->tris->size(); j++)
-							{
-								glm::vec3 vert0 = projectileTree.model.meshes[0].vertices[(*projectileTree.arrayRepresentation[x][indexY][z]->tris)[j].index0].Position;
-								glm::vec3 vert1 = projectileTree.model.meshes[0].vertices[(*projectileTree.arrayRepresentation[x][indexY][z]->tris)[j].index1].Position;
-								glm::vec3 vert2 = projectileTree.model.meshes[0].vertices[(*projectileTree.arrayRepresentation[x][indexY][z]->tris)[j].index2].Position;
-								bool rayResult = RayUtil::MTRayCheck(vert0, vert1, vert2, vertexPos, glm::normalize(-rayDirection), hitDistance);
-								if (rayResult && hitDistance < glm::length(speed))
-								{
-									affectedVerts.insert(i);
-									target.vertInfo[i].hitIntensity = 1.0f;
-									glm::vec3 hitPoint = vertexPos + hitDistance * glm::normalize(rayDirection);
-									CalcLocalFalloff(tree, target, projectileTree.arrayRepresentation[x][indexY][z], hitPoint);
-								}
-
-							}
-						}
+						RayHit hit;
+						hit.vertexIndex = i;
+						hit.hitPoint = vertexPos + hitDistance * glm::normalize(rayDirection);
+						chunkHits.push_back(hit);
 					}
 				}
-				
+			});
+		});
+		LapPhase(phaseTimes.rayCasting, phaseStart);
+		for (const RayHit& hit : hits)
+		{
+			affectedVerts.insert(hit.vertexIndex);
+			target.vertInfo[hit.vertexIndex].hitIntensity = 1.0f;
+			CalcLocalFalloff(tree, target, hit.hitPoint);
+		}
+		LapPhase(phaseTimes.falloff, phaseStart);
+	}
+
+	//Where the projectile is going to hit the target if it keeps flying along rayDirection, for work that has to be
+	//done before contact (like refining the target there). Every ray is cast all the way through the target's tree,
+	//center and radius bound the nearest hits. Returns false if no ray hits
+	bool PredictImpact(Octree& tree, glm::vec3& center, float& radius)
+	{
+		PROFILE_ZONE("predict impact");
+		glm::vec3 direction = glm::normalize(rayDirection);
+		std::vector<RayHit> hits;
+		CastRaysParallel("impact prediction", (int)optimizedVerts.size(), 16, hits, [&](int v, std::vector<RayHit>& chunkHits)
+		{
+			glm::vec3 vertexPos = optimizedVerts[v];
+			glm::vec3 end = vertexPos + direction * (glm::length(tree.root->position - vertexPos) + tree.root->size);
+			float nearest = FLT_MAX;
+			tree.QueryBox(glm::min(vertexPos, end), glm::max(vertexPos, end), [&](OctreeNode* leaf)
+			{
+				for (int t = 0; t < leaf->tris->size(); t++)
+				{
+					glm::vec3 corners[3];
+					tree.LeafTriangle(leaf, t, corners);
+					float hitDistance = FLT_MAX;
+					if (RayUtil::MTRayCheck(corners[0], corners[1], corners[2], vertexPos, direction, hitDistance) && hitDistance >= 0.0f)
+						nearest = fminf(nearest, hitDistance);
+				}
+			});
+			if (nearest < FLT_MAX)
+			{
+				RayHit hit;
+				hit.hitPoint = vertexPos + direction * nearest;
+				chunkHits.push_back(hit);
 			}
+		});
+		if (hits.empty())
+			return false;
+		glm::vec3 hitMin = hits[0].hitPoint, hitMax = hits[0].hitPoint;
+		for (const RayHit& hit : hits)
+		{
+			hitMin = glm::min(hitMin, hit.hitPoint);
+			hitMax = glm::max(hitMax, hit.hitPoint);
+		}
+		center = (hitMin + hitMax) * 0.5f;
+		radius = glm::length(hitMax - hitMin) * 0.5f;
+		return true;
+	}
+
+	//How far the projectile can get along rayDirection from where it is now, before it's been stepped, if it first touches
+	//the target contactDistance away with time long steps. It speeds up until then, from the step that touches on the
+	//reversed acceleration slows it down, and the target's material can only take more of the speed away
+	float MaxTravel(float contactDistance, float time) const
+	{
+		if (glm::length(rayDirection) <= 0.0f)
+			return 0.0f;
+		glm::vec3 direction = glm::normalize(rayDirection);
+		float speedAlong = glm::dot(speed, direction), accelerationAlong = glm::dot(acceleration, direction);
+		float travelled = 0.0f;
+		for (int step = 0; step < 1000000 && speedAlong >= __EPSILON; step++)
+		{
+			travelled += speedAlong;
+			if (travelled >= contactDistance)
+				accelerationAlong = -glm::length(rayDirection);
+			speedAlong += accelerationAlong * time;
 		}
+		return travelled;
+	}
+
+	//Adds the time since start to phase and restarts the clock for the next one
+	static void LapPhase(double& phase, std::chrono::steady_clock::time_point& start)
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		phase += std::chrono::duration<double>(now - start).count();
+		start = now;
+	}
+
+	//Runs castRay(index, chunkHits) for every index in [0, count) on the shared job system and
+	//gathers the hits into one list, ordered by index
+	template<typename RayCaster>
+	void CastRaysParallel(const char* name, int count, int minGrain, std::vector<RayHit>& hits, const RayCaster& castRay)
+	{
+		PROFILE_ZONE(name);
+		std::mutex chunksMutex;
+		std::vector<std::pair<int, std::vector<RayHit>>> chunks;
+		Jobs().ParallelForRange(name, 0, count, minGrain, [&](int first, int last)
+		{
+			std::vector<RayHit> chunkHits;
+			for (int i = first; i < last; i++)
+				castRay(i, chunkHits);
+			if (chunkHits.empty())
+				return;
+			std::lock_guard<std::mutex> lock(chunksMutex);
+			chunks.push_back(std::make_pair(first, std::move(chunkHits)));
+		});
+		std::sort(chunks.begin(), chunks.end(), [](const std::pair<int, std::vector<RayHit>>& a, const std::pair<int, std::vector<RayHit>>& b)
+		{
+			return a.first < b.first;
+		});
+		for (auto& chunk : chunks)
+			hits.insert(hits.end(), chunk.second.begin(), chunk.second.end());
 	}
 
 	//Mesh preprocessing, detects all intersections, bruteforce
@@ -219,84 +403,42 @@ public:
 		}
 	}
 
-	void AffectFalloff(OctreeNode * node, OctreeTarget & target, glm::vec3 hitPoint)
+	//Raises the hit intensity of every target vertex within falloff range of the hit point
+	void CalcLocalFalloff(Octree& tree, OctreeTarget& target, glm::vec3 hitPoint)
 	{
-		//if there are triangles
-		if (node->tris != nullptr && node->tris->size() > 0)
+		PROFILE_ZONE("CalcLocalFalloff");
+		tree.QuerySphere(hitPoint, target.falloff, [&](int index, float distance)
 		{
-			for (int i = 0; i < node->tris->size(); i++)
+			float hitIntensity = target.falloffFunc(distance);
+			if (hitIntensity > target.vertInfo[index].hitIntensity)
 			{
-				float hitIntensity = 
-					target.falloffFunc(glm::length(target.targetModel.meshes[0].vertices[(*node->tris)[i].index0].Position - hitPoint));
-				if (hitIntensity > target.vertInfo[(*node->tris)[i].index0].hitIntensity)
-				{
-					target.vertInfo[(*node->tris)[i].index0].hitIntensity = hitIntensity;
-					affectedVerts.insert((*node->tris)[i].index0);
-				}
-
-				hitIntensity =
-					target.falloffFunc(glm::length(target.targetModel.meshes[0].vertices[(*node->tris)[i].index1].Position - hitPoint));
-				if (hitIntensity > target.vertInfo[(*node->tris)[i].index1].hitIntensity)
-				{
-					target.vertInfo[(*node->tris)[i].index1].hitIntensity = hitIntensity;
-					affectedVerts.insert((*node->tris)[i].index1);
-				}
-
-				hitIntensity =
-					target.falloffFunc(glm::length(target.targetModel.meshes[0].vertices[(*node->tris)[i].index2].Position - hitPoint));
-				if (hitIntensity > target.vertInfo[(*node->tris)[i].index2].hitIntensity)
-				{
-					target.vertInfo[(*node->tris)[i].index2].hitIntensity = hitIntensity;
-					affectedVerts.insert((*node->tris)[i].index2);
-				}
+				target.vertInfo[index].hitIntensity = hitIntensity;
+				affectedVerts.insert(index);
 			}
-		}
+		});
 	}
 
-	void AffectLeafFalloff(int indexX, int indexY, int indexZ, Octree & tree, OctreeTarget & target, glm::vec3 hitPoint)
+	//Where the projectile is drawn relative to its spawn, at the latest simulated step
+	//Reads simulation state, so with a simulation thread the offset has to come from its snapshots instead (see SimThread::RenderOffset)
+	glm::vec3 RenderOffset()
 	{
-		//in a leaf
-		float leafSize = tree.size / 8; //todo change to dynamic
-		int radiusXP = ceil((tree.arrayRepresentation[indexX][indexY][indexZ]->position.x - hitPoint.x + target.falloff) / leafSize); //= target.falloff / (tree.size / 8);
-		int radiusXN = ceil(fabs((tree.arrayRepresentation[indexX][indexY][indexZ]->position.x - hitPoint.x - target.falloff) / leafSize));
-		int radiusYP = ceil((tree.arrayRepresentation[indexX][indexY][indexZ]->position.y - hitPoint.y + target.falloff) / leafSize); //= target.falloff / (tree.size / 8);
-		int radiusYN = ceil(fabs((tree.arrayRepresentation[indexX][indexY][indexZ]->position.y - hitPoint.y - target.falloff) / leafSize));
-		int radiusZP = ceil((tree.arrayRepresentation[indexX][indexY][indexZ]->position.z - hitPoint.z + target.falloff) / leafSize); //= target.falloff / (tree.size / 8);
-		int radiusZN = ceil(fabs((tree.arrayRepresentation[indexX][indexY][indexZ]->position.z - hitPoint.z - target.falloff) / leafSize));
-		radiusXP = min(radiusXP, 7 - indexX); radiusYP = min(radiusYP, 7 - indexY); radiusZP = min(radiusZP, 7 - indexZ);
-		radiusXN = min(radiusXN, indexX); radiusYN = min(radiusYN, indexY); radiusZN = min(radiusXN, indexZ);
-		//std::cout << radiusXP << radiusXN << radiusYP << radiusYN << radiusZP << radiusZN << "\n";
-
-		for (int i = -radiusXN; i <= radiusXP; i++)
-		{
-			for (int j = -radiusYN; j <= radiusYP; j++)
-			{
-				for (int k = -radiusZN; k <= radiusZP; k++)
-				{
-					AffectFalloff(tree.arrayRepresentation[indexX + i][indexY + j][indexZ + k], target, hitPoint);
-				}
-			}
-		}
+		return travelled;
 	}
 
-	void CalcLocalFalloff(Octree& tree, OctreeTarget& target, OctreeNode* targetOctant, glm::vec3 hitPoint)
+	void Draw(Shader& shader)
 	{
-		OctreeNode* falloffCenter = tree.FindFalloffCenterNode(hitPoint, target.falloff);
-		//FindAdjacentToData(tree, target, falloffCenter, hitPoint, target.falloff);
-		int indexX = tree.calcNodeIndexX(targetOctant);
-		int indexY = tree.calcNodeIndexY(targetOctant);
-		int indexZ = tree.calcNodeIndexZ(targetOctant);
-		//std::cout << indexX << indexY << indexZ << "\n";
-		AffectLeafFalloff(indexX, indexY, indexZ, tree, target, hitPoint);
+		Draw(shader, RenderOffset());
 	}
 
-	void Draw(Shader shader)
+	//Draws the projectile moved by offset from its spawn, the buffer itself always keeps the spawn positions
+	void Draw(Shader& shader, glm::vec3 offset)
 	{
 		shader.use();
+		shader.setMat4(modelUniform.get(shader), glm::translate(model, offset));
 
-		shader.setVec3("material.diffuse", projectileMesh.material.diffuse);
-		shader.setVec3("material.specular", projectileMesh.material.specular);
-		shader.setFloat("material.shininess", 32.0f);
+		shader.setVec3(diffuseUniform.get(shader), projectileMesh.material.diffuse);
+		shader.setVec3(specularUniform.get(shader), projectileMesh.material.specular);
+		shader.setFloat(shininessUniform.get(shader), 32.0f);
 
 		projectileMesh.Draw(shader);
 	}
@@ -308,36 +450,80 @@ public:
 		target.targetModel.meshes[0].UpdateBufferVertexDirect(index);
 	}
 
+	//Advances the simulation by one fixed step, time is the step size
+	//Speed is kept as distance per step, so the step size must not change between calls
+	//Nothing is uploaded here, the moved vertices are listed in MovedVerts for whoever uploads them (see SimThread)
 	void Update(Octree& tree, Octree& projectileTree, OctreeTarget& target, float time, glm::mat4 model)
 	{
+		PROFILE_ZONE("sim step");
+		std::chrono::steady_clock::time_point phaseStart = std::chrono::steady_clock::now();
+		//the step that first touched the target ended at the surface, the rest of it is pushed into the target now
+		glm::vec3 step = speed * (1.0f + contactRemainder);
+		float stepTime = time * (1.0f + contactRemainder);
+		contactRemainder = 0.0f;
+		historyVerts.clear();
+		lastRelaxIterations = 0;
 		if (collision)
 		{
-			//Update distances to impact on vertices
-			for (auto vert : affectedVerts)
+			PROFILE_ZONE("vertex update");
+			//Dent the target, only as much as its material gives way
+			dentVerts.assign(affectedVerts.begin(), affectedVerts.end());
+			if (relaxSettings.enabled && !relaxation.IsSetUp())
+				relaxation.Setup(tree.model.meshes[0]); //nobody called SetupRelaxation, the target isn't dented yet at least
+			float contactShare = target.Deform(dentVerts, step, stepTime);
+			if (!dentVerts.empty())
 			{
-				tree.model.meshes[0].vertices[vert].Position += speed * target.vertInfo[vert].hitIntensity;
-				tree.model.meshes[0].UpdateBufferVertexDirect(vert);
+				//the projectile only gets as far as the surface it pushes on moves. There are no masses or forces to
+				//balance, the projectile is moved kinematically and the material only says how much of a push it
+				//takes for good, so the speed follows the vertex that gave way the most, the one right under the
+				//projectile (the others moved less because of the falloff, not because they held it back). The
+				//springback part of the push is lost to the projectile for good, so the scaling compounds: a target
+				//that keeps taking half of every push halves the speed every step and stops it well before the
+				//reversed acceleration alone would
+				speed *= contactShare;
+				step *= contactShare;
 			}
+			if (relaxSettings.enabled && !dentVerts.empty())
+			{
+				LapPhase(phaseTimes.vertexUpdate, phaseStart);
+				RelaxDent(tree.model.meshes[0], target, contactShare);
+				LapPhase(phaseTimes.relaxation, phaseStart);
+				historyVerts.insert(historyVerts.end(), relaxedVerts.begin(), relaxedVerts.end());
+			}
+			historyVerts.insert(historyVerts.end(), dentVerts.begin(), dentVerts.end());
 
 			//If the speed beomes the opposite direction of the ray, we hammer it at zero,
 			//because we don't want backwards movement
 
 		}
+		target.RecordFrame(historyVerts);
+		tree.VerticesMoved(historyVerts);
 		//boundingBoxCenterOffset += speed;
-		ProcessRays(tree, projectileTree, target);
+		LapPhase(phaseTimes.vertexUpdate, phaseStart);
+		bool touching = collision;
+		ProcessRays(tree, projectileTree, target, step);
+		phaseStart = std::chrono::steady_clock::now();
+		//continuous collision: the step that first reaches the target stops where the sweep touched it instead of
+		//sinking in, the rest of the step goes into the next one's dent
+		if (!touching && timeOfImpact >= 0.0f)
+		{
+			contactRemainder = 1.0f - timeOfImpact;
+			step *= timeOfImpact;
+		}
+		lastStep = step;
 
 		for (int i = 0; i < optimizedVerts.size(); i++)
 		{
-			optimizedVerts[i] += speed; //Change position of all ray origins according to current speed
+			optimizedVerts[i] += step; //Change position of all ray origins according to this step's displacement
 		}
 		for (int i = 0; i < projectileMesh.meshes[0].vertices.size(); i++)
 		{
-			projectileMesh.meshes[0].vertices[i].Position += speed; //Change position of all vertices according to current speed
-			projectileMesh.meshes[0].UpdateBufferVertexDirect(i);
+			projectileMesh.meshes[0].vertices[i].Position += step; //Change position of all vertices according to this step's displacement
 		}
+		travelled += step;
 
-
-		projectileTree.UpdatePosition(speed);
+		projectileTree.UpdatePosition(step);
+		LapPhase(phaseTimes.vertexUpdate, phaseStart);
 
 		if (glm::dot(speed, rayDirection) < __EPSILON)
 		{
@@ -351,18 +537,48 @@ public:
 
 	}
 
+	//Smooths the surface around this step's dent, the vertices right under the projectile stay where they are
+	void RelaxDent(Mesh& targetMesh, OctreeTarget& target, float contactShare)
+	{
+		pinnedVerts.clear();
+		for (int vert : dentVerts)
+		{
+			if (target.materialState.lastShare[vert] >= contactShare * relaxSettings.pinShare)
+				pinnedVerts.push_back(vert);
+		}
+		lastRelaxIterations = relaxation.Relax(targetMesh.vertices, dentVerts, pinnedVerts, relaxSettings, relaxedVerts);
+	}
+
+	//Target vertices the latest step moved (dented or relaxed), may list some twice
+	const std::vector<int>& MovedVerts() const
+	{
+		return historyVerts;
+	}
+
 	//Renders a ray that has length of acceleration
 	void RenderRays(glm::mat4 view, glm::mat4 projection)
 	{
-		for (int i = 0; i < optimizedVerts.size(); i++)
-			RayUtil::renderRay(optimizedVerts[i], rayDirection, view, model, projection, rayShader);
+		RenderRays(view, projection, RenderOffset());
+	}
+	void RenderRays(glm::mat4 view, glm::mat4 projection, glm::vec3 offset)
+	{
+		glm::mat4 rayModel = glm::translate(model, offset);
+		for (int i = 0; i < spawnRayOrigins.size(); i++)
+			rayLines.AddRay(spawnRayOrigins[i], rayDirection, rayModel);
+		rayLines.Flush(rayShader, view, projection);
 	}
 
 	//Renders a ray with infinite length
 	void RenderInfiniteRays(glm::mat4 view, glm::mat4 projection)
 	{
-		for (int i = 0; i < optimizedVerts.size(); i++)
-			RayUtil::renderRay(optimizedVerts[i], rayDirection * 1000000.0f, view, model, projection, rayShader);
+		RenderInfiniteRays(view, projection, RenderOffset());
+	}
+	void RenderInfiniteRays(glm::mat4 view, glm::mat4 projection, glm::vec3 offset)
+	{
+		glm::mat4 rayModel = glm::translate(model, offset);
+		for (int i = 0; i < spawnRayOrigins.size(); i++)
+			rayLines.AddRay(spawnRayOrigins[i], rayDirection * 1000000.0f, rayModel);
+		rayLines.Flush(rayShader, view, projection);
 	}
 
 	Model projectileMesh;
@@ -370,10 +586,66 @@ public:
 	glm::vec3 acceleration;
 	glm::vec3 rayDirection;
 	bool isDone = false; //is the sim over?
+	float timeOfImpact = -1.0f; //earliest contact in the last step, as a fraction of the step (-1 if none)
+	float contactRemainder = 0.0f; //share of the last step left over after it stopped at first contact, added to the next one
+	glm::vec3 travelled = glm::vec3(0.0f); //total displacement since spawn
+	glm::vec3 lastStep = glm::vec3(0.0f); //displacement of the latest step
+	SimPhaseTimes phaseTimes;
+	RelaxationSettings relaxSettings; //off by default, the dent is the plain falloff then
+	int lastRelaxIterations = 0; //relaxation iterations the latest step ran, fewer than the maximum only with a time budget
 
 	float boundingBoxSize;
 	glm::vec3 boundingBoxCenter;
 private:
+	//Bounds and per vertex state, shared by the constructors
+	void Init()
+	{
+		rayDirection = acceleration;
+		speed = acceleration;
+
+		float minX, minY, minZ, maxX, maxY, maxZ;
+		minX = projectileMesh.meshes[0].vertices[0].Position.x; maxX = minX;
+		minY = projectileMesh.meshes[0].vertices[0].Position.y; maxY = minY;
+		minZ = projectileMesh.meshes[0].vertices[0].Position.z; maxZ = minZ;
+		for (int i = 1; i < projectileMesh.meshes[0].vertices.size(); i++)
+		{
+			if (projectileMesh.meshes[0].vertices[i].Position.x <= minX)
+				minX = projectileMesh.meshes[0].vertices[i].Position.x;
+			if (projectileMesh.meshes[0].vertices[i].Position.x >= maxX)
+				maxX = projectileMesh.meshes[0].vertices[i].Position.x;
+
+			if (projectileMesh.meshes[0].vertices[i].Position.y <= minY)
+				minY = projectileMesh.meshes[0].vertices[i].Position.y;
+			if (projectileMesh.meshes[0].vertices[i].Position.y >= maxY)
+				maxY = projectileMesh.meshes[0].vertices[i].Position.y;
+
+			if (projectileMesh.meshes[0].vertices[i].Position.z <= minZ)
+				minZ = projectileMesh.meshes[0].vertices[i].Position.z;
+			if (projectileMesh.meshes[0].vertices[i].Position.z >= maxZ)
+				maxZ = projectileMesh.meshes[0].vertices[i].Position.z;
+
+		}
+		LOG_DEBUG("min/max X: " << minX << " " << maxX << ", min/max Y: " << minY << " " << maxY <<
+			", min/max Z: " << minZ << " " << maxZ);
+		boundingBoxSize = fmaxf(fmaxf(maxX - minX, maxY - minY), maxZ - minZ);
+		boundingBoxCenter = glm::vec3((maxX + minX) / 2, (maxY + minY) / 2, (maxZ + minZ) / 2);
+		LOG_DEBUG("bounding box size: " << boundingBoxSize << ", center: " << boundingBoxCenter.x << " " << boundingBoxCenter.y << " " << boundingBoxCenter.z);
+		
+		boundingBoxCenterOffset = boundingBoxCenter;
+		/*
+		for (int i = 0; i < projectileMesh.meshes[0].vertices.size(); i++)
+		{
+			projectileMesh.meshes[0].vertices[i].Position += glm::vec3(0, 3.0f, 0); //Change position of all vertices
+			projectileMesh.meshes[0].UpdateBufferVertexDirect(i);
+		}*/
+
+		OptimizeVertices();
+		spawnRayOrigins = optimizedVerts;
+		LOG_INFO("Successfully constructed projectile, optimized verts size: " << optimizedVerts.size());
+
+		//std::cout << projectileMesh.meshes[0].vertices.size();//.vertices.size();
+	}
+
 	void OptimizeVertices()
 	{
 		for (int i = 0; i < projectileMesh.meshes[0].vertices.size(); i++)
@@ -397,10 +669,17 @@ private:
 	glm::vec3 nearestOrigin; //the position of the origin targeting the nearest vert
 	glm::vec3 boundingBoxCenterOffset;
 	std::vector<glm::vec3> optimizedVerts;
+	std::vector<glm::vec3> spawnRayOrigins; //ray origins as they were at spawn, rays are drawn moved along like the mesh
 	std::vector<std::pair<int, float>> affectedVertices;
 	std::set<int> affectedVerts;
+	std::vector<int> dentVerts; //affectedVerts in a plain array, for OctreeTarget::Deform
+	SurfaceRelaxation relaxation; //rest lengths from the undeformed target, see SetupRelaxation
+	std::vector<int> pinnedVerts, relaxedVerts;
+	std::vector<int> historyVerts; //target vertices moved this step, for OctreeTarget::RecordFrame
 	std::vector<std::pair<glm::vec3, float>> hitPoints; //keeps track of hitpoints and their distances from the projectile
 	Shader rayShader;
+	DebugLines rayLines; //all of the rays go out in one draw
+	UniformHandle modelUniform{ "model" }, diffuseUniform{ "material.diffuse" }, specularUniform{ "material.specular" }, shininessUniform{ "material.shininess" };
 };
 
 //----------------------------------------------------------------------------------------
@@ -417,7 +696,7 @@ public:
 		rayShader("../OpenGL_DeformProj/ray.vert", "../OpenGL_DeformProj/ray.frag"), rayDirection(acceleration)
 	{
 		speed = acceleration;
-		std::cout << "Successfuly constructed point projectile\n";
+		LOG_INFO("Successfully constructed point projectile");
 	}
 
 	//Casts a single ray on a given triangle of a target (transformed using a model matrix)
@@ -433,10 +712,9 @@ public:
 				{
 					for (int i = 0; i < targetOctant->tris->size(); i++)
 					{
-						glm::vec3 vert0 = tree.model.meshes[0].vertices[(*targetOctant->tris)[i].index0].Position;
-						glm::vec3 vert1 = tree.model.meshes[0].vertices[(*targetOctant->tris)[i].index1].Position;
-						glm::vec3 vert2 = tree.model.meshes[0].vertices[(*targetOctant->tris)[i].index2].Position;
-						bool rayResult = RayUtil::MTRayCheck(vert0, vert1, vert2, projectilePosition, glm::normalize(rayDirection), hitDistance);
+						glm::vec3 corners[3];
+						tree.LeafTriangle(targetOctant, i, corners);
+						bool rayResult = RayUtil::MTRayCheck(corners[0], corners[1], corners[2], projectilePosition, glm::normalize(rayDirection), hitDistance);
 						if (rayResult && (hitDistance < glm::length(speed))) // there's gonna be a hit next frame
 						{
 							//odmah ovde dentuj da ne bi radio pretragu bezveze
@@ -447,7 +725,7 @@ public:
 
 							collision = true;
 							hitPoint = projectilePosition + hitDistance * glm::normalize(rayDirection);
-							CalcLocalFalloff(tree, target, targetOctant);
+							CalcLocalFalloff(tree, target);
 							return true;
 						}
 					}
@@ -471,275 +749,28 @@ public:
 		RayUtil::renderRay(projectilePosition, rayDirection * 1000000.0f, view, model, projection, rayShader);
 	}
 
-	void CalcLocalFalloff(Octree& tree, OctreeTarget& target, OctreeNode* targetOctant)
+	//Sets the hit intensity of every target vertex within falloff range of the hit point
+	void CalcLocalFalloff(Octree& tree, OctreeTarget& target)
 	{
-		OctreeNode* falloffCenter = tree.FindFalloffCenterNode(hitPoint, target.falloff);
-		//FindAdjacentToData(tree, target, falloffCenter, hitPoint, target.falloff);
-		int indexX = tree.calcNodeIndexX(targetOctant);
-		int indexY = tree.calcNodeIndexY(targetOctant);
-		int indexZ = tree.calcNodeIndexZ(targetOctant);
-		//std::cout << indexX << indexY << indexZ << "\n";
-		AffectLeafFalloff(indexX, indexY, indexZ, tree, target);
-	}
-
-	void AffectFalloffRecursive(OctreeNode* node, OctreeTarget& target)
-	{
-		//affect all subnodes
-		if (node->XpYpZp == nullptr)
-		{
-			//it's a leaf
-			if (node->tris != nullptr)
-			{
-				for (int i = 0; i < node->tris->size(); i++)
-				{
-					target.vertInfo[(*node->tris)[i].index0].hitIntensity =
-						target.falloffFunc(glm::length(target.targetModel.meshes[0].vertices[(*node->tris)[i].index0].Position - hitPoint));
-					if (target.vertInfo[(*node->tris)[i].index0].hitIntensity > 0.0f)
-						affectedVerts.insert((*node->tris)[i].index0);
-
-					target.vertInfo[(*node->tris)[i].index1].hitIntensity =
-						target.falloffFunc(glm::length(target.targetModel.meshes[0].vertices[(*node->tris)[i].index1].Position - hitPoint));
-					if (target.vertInfo[(*node->tris)[i].index1].hitIntensity > 0.0f)
-						affectedVerts.insert((*node->tris)[i].index1);
-
-					target.vertInfo[(*node->tris)[i].index2].hitIntensity =
-						target.falloffFunc(glm::length(target.targetModel.meshes[0].vertices[(*node->tris)[i].index2].Position - hitPoint));
-					if (target.vertInfo[(*node->tris)[i].index2].hitIntensity > 0.0f)
-						affectedVerts.insert((*node->tris)[i].index2);
-				}
-			}
-		}
-		else
-		{
-			AffectFalloffRecursive(node->XpYpZp, target);
-			AffectFalloffRecursive(node->XpYpZn, target);
-			AffectFalloffRecursive(node->XpYnZp, target);
-			AffectFalloffRecursive(node->XpYnZn, target);
-			AffectFalloffRecursive(node->XnYpZp, target);
-			AffectFalloffRecursive(node->XnYpZn, target);
-			AffectFalloffRecursive(node->XnYnZp, target);
-			AffectFalloffRecursive(node->XnYnZn, target);
-		}
-	}
-
-	void AffectFalloff(OctreeNode* node, OctreeTarget& target)
-	{
-		//if there are triangles
-		if (node->tris != nullptr && node->tris->size() > 0)
-		{
-			for (int i = 0; i < node->tris->size(); i++)
-			{
-				target.vertInfo[(*node->tris)[i].index0].hitIntensity =
-					target.falloffFunc(glm::length(target.targetModel.meshes[0].vertices[(*node->tris)[i].index0].Position - hitPoint));
-				if (target.vertInfo[(*node->tris)[i].index0].hitIntensity > 0.0f)
-					affectedVerts.insert((*node->tris)[i].index0);
-
-				target.vertInfo[(*node->tris)[i].index1].hitIntensity =
-					target.falloffFunc(glm::length(target.targetModel.meshes[0].vertices[(*node->tris)[i].index1].Position - hitPoint));
-				if (target.vertInfo[(*node->tris)[i].index1].hitIntensity > 0.0f)
-					affectedVerts.insert((*node->tris)[i].index1);
-
-				target.vertInfo[(*node->tris)[i].index2].hitIntensity =
-					target.falloffFunc(glm::length(target.targetModel.meshes[0].vertices[(*node->tris)[i].index2].Position - hitPoint));
-				if (target.vertInfo[(*node->tris)[i].index2].hitIntensity > 0.0f)
-					affectedVerts.insert((*node->tris)[i].index2);
-			}
-		}
-	}
-
-	void AffectLeafFalloff(int indexX, int indexY, int indexZ, Octree& tree, OctreeTarget& target)
-	{
-		//in a leaf
-		float leafSize = tree.size / 8; //todo change to dynamic
-		int radiusXP = ceil((tree.arrayRepresentation[indexX][indexY][indexZ]->position.x - hitPoint.x + target.falloff) / leafSize); //= target.falloff / (tree.size / 8);
-		int radiusXN = ceil(fabs((tree.arrayRepresentation[indexX][indexY][indexZ]->position.x - hitPoint.x - target.falloff) / leafSize));
-		int radiusYP = ceil((tree.arrayRepresentation[indexX][indexY][indexZ]->position.y - hitPoint.y + target.falloff) / leafSize); //= target.falloff / (tree.size / 8);
-		int radiusYN = ceil(fabs((tree.arrayRepresentation[indexX][indexY][indexZ]->position.y - hitPoint.y - target.falloff) / leafSize));
-		int radiusZP = ceil((tree.arrayRepresentation[indexX][indexY][indexZ]->position.z - hitPoint.z + target.falloff) / leafSize); //= target.falloff / (tree.size / 8);
-		int radiusZN = ceil(fabs((tree.arrayRepresentation[indexX][indexY][indexZ]->position.z - hitPoint.z - target.falloff) / leafSize));
-		radiusXP = min(radiusXP, 7 - indexX); radiusYP = min(radiusYP, 7 - indexY); radiusZP = min(radiusZP, 7 - indexZ);
-		radiusXN = min(radiusXN, indexX); radiusYN = min(radiusYN, indexY); radiusZN = min(radiusXN, indexZ);
-		//std::cout << radiusXP << radiusXN << radiusYP << radiusYN << radiusZP << radiusZN << "\n";
-
-		for (int i = -radiusXN; i <= radiusXP; i++)
-		{
-			for (int j = -radiusYN; j <= radiusYP; j++)
-			{
-				for (int k = -radiusZN; k <= radiusZP; k++)
-				{
-					AffectFalloff(tree.arrayRepresentation[indexX + i][indexY + j][indexZ + k], target);
-				}
-			}
-		}
-	}
-
-	void FindAdjacentToData(Octree& tree, OctreeTarget& target, OctreeNode* node, glm::vec3 data, float minSize)
-	{
-		int answer = 0b000000;
-		if (data.x + minSize > node->position.x + node->size / 2) //if we get out 
-			answer |= 0b000001; //need to check x+
-		else if (data.x - minSize < node->position.x - node->size / 2)
-			answer |= 0b001000; //need to check x-
-		if (data.y + minSize > node->position.y + node->size / 2)
-			answer |= 0b000010; //need to check y+
-		else if (data.y - minSize < node->position.y - node->size / 2)
-			answer |= 0b010000; //need to check y-
-		if (data.z + minSize > node->position.z + node->size / 2)
-			answer |= 0b000100; //need to check z+
-		else if (data.z + minSize > node->position.z + node->size / 2)
-			answer |= 0b100000; //need to check z-
-
-		if ((answer & 0b000001) == 0b000001)
-		{
-			//x+
-			glm::vec3 temp = glm::vec3(data.x + minSize, data.y, data.z);
-			AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-			if ((answer & 0b000010) == 0b000010)
-			{
-				//y+
-				temp = glm::vec3(data.x, data.y + minSize, data.z);
-				AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-				temp.x += minSize; //x+y+
-				AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-				if ((answer & 0b000100) == 0b000100)
-				{
-					//z+
-					temp = glm::vec3(data.x, data.y, data.z + minSize);
-					AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-					temp.x += minSize;//x+z+
-					AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-					temp = glm::vec3(data.x, data.y + minSize, data.z + minSize);//y+z+
-					AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-					temp.x += minSize; //x+y+z+
-					AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-				}
-				else if ((answer & 0b100000) == 0b100000)
-				{
-					//z-
-					temp = glm::vec3(data.x, data.y, data.z - minSize);
-					AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-					temp.x += minSize;//x+z-
-					AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-					temp = glm::vec3(data.x, data.y + minSize, data.z - minSize);//y+z-
-					AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-					temp.x += minSize; //x+y+z-
-					AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-				}
-			}
-			else if ((answer & 0b010000) == 0b010000)
-			{
-				//y-
-				glm::vec3 temp = glm::vec3(data.x, data.y - minSize, data.z);
-				AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-				temp.x += minSize; //x+y-
-				AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-				if ((answer & 0b000100) == 0b000100)
-				{
-					//z+
-					temp = glm::vec3(data.x, data.y, data.z + minSize);
-					AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-					temp.x += minSize;//x+z+
-					AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-					temp = glm::vec3(data.x, data.y - minSize, data.z + minSize);//y-z+
-					AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-					temp.x += minSize; //x+y-z+
-					AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-				}
-				else if ((answer & 0b100000) == 0b100000)
-				{
-					//z-
-					temp = glm::vec3(data.x, data.y, data.z - minSize);
-					AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-					temp.x += minSize;//x+z-
-					AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-					temp = glm::vec3(data.x, data.y - minSize, data.z - minSize);//y-z-
-					AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-					temp.x += minSize; //x+y-z-
-					AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-				}
-			}
-		}
-		else if ((answer & 0b001000) == 0b001000)
+		tree.QuerySphere(hitPoint, target.falloff, [&](int index, float distance)
 		{
-			//x-
-			glm::vec3 temp = glm::vec3(data.x - minSize, data.y, data.z); 
-			AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-			if ((answer & 0b000010) == 0b000010)
-			{
-				//y+
-				temp = glm::vec3(data.x, data.y + minSize, data.z);
-				AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-				temp.x -= minSize; //x-y+
-				AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-				if ((answer & 0b000100) == 0b000100)
-				{
-					//z+
-					temp = glm::vec3(data.x, data.y, data.z + minSize);
-					AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-					temp.x -= minSize;//x-z+
-					AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-					temp = glm::vec3(data.x, data.y + minSize, data.z + minSize);//y+z+
-					AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-					temp.x -= minSize; //x-y+z+
-					AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-				}
-				else if ((answer & 0b100000) == 0b100000)
-				{
-					//z-
-					temp = glm::vec3(data.x, data.y, data.z - minSize);
-					AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-					temp.x -= minSize;//x-z-
-					AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-					temp = glm::vec3(data.x, data.y + minSize, data.z - minSize);//y+z-
-					AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-					temp.x -= minSize; //x-y+z-
-					AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-				}
-			}
-			else if ((answer & 0b010000) == 0b010000)
-			{
-				//y-
-				glm::vec3 temp = glm::vec3(data.x, data.y - minSize, data.z);
-				AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-				temp.x -= minSize; //x-y-
-				AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-				if ((answer & 0b000100) == 0b000100)
-				{
-					//z+
-					temp = glm::vec3(data.x, data.y, data.z + minSize);
-					AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-					temp.x -= minSize;//x-z+
-					AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-					temp = glm::vec3(data.x, data.y - minSize, data.z + minSize);//y-z+
-					AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-					temp.x -= minSize; //x-y-z+
-					AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-				}
-				else if ((answer & 0b100000) == 0b100000)
-				{
-					//z-
-					temp = glm::vec3(data.x, data.y, data.z - minSize);
-					AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-					temp.x += minSize;//x-z-
-					AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-					temp = glm::vec3(data.x, data.y - minSize, data.z - minSize);//y-z-
-					AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-					temp.x += minSize; //x-y-z-
-					AffectFalloff(tree.FindFalloffCenterNode(temp, minSize), target);
-				}
-			}
-		}
+			target.vertInfo[index].hitIntensity = target.falloffFunc(distance);
+			if (target.vertInfo[index].hitIntensity > 0.0f)
+				affectedVerts.insert(index);
+		});
 	}
 
 	void Update(Octree& tree, OctreeTarget& target, float time, glm::mat4 model)
 	{
 		if (collision)
 		{
-			for (auto vert : affectedVerts)
-			{
-				tree.model.meshes[0].vertices[vert].Position += speed * target.vertInfo[vert].hitIntensity;
+			dentVerts.assign(affectedVerts.begin(), affectedVerts.end());
+			float contactShare = target.Deform(dentVerts, speed, time);
+			tree.VerticesMoved(dentVerts);
+			for (int vert : dentVerts)
 				tree.model.meshes[0].UpdateBufferVertexDirect(vert);
-			}
+			if (!dentVerts.empty())
+				speed *= contactShare; //the projectile only gets as far as the surface it pushes on moves
 		}
 		else
 		{
@@ -764,6 +795,7 @@ public:
 	glm::vec3 acceleration; //Acceleration of body
 	glm::vec3 rayDirection; //Direction of the actual ray
 	std::set<int> affectedVerts;
+	std::vector<int> dentVerts; //affectedVerts in a plain array, for OctreeTarget::Deform
 	bool isDone = false;
 private:
 	bool collision = false;
@@ -15,6 +15,9 @@
 #include "model.h"
 #include "rayUtil.h"
 #include "triangleOctree.h"
+#include "meshRefinement.h"
+#include "deformationHistory.h"
+#include "logger.h"
 
 /*
 struct VertInfo
@@ -29,48 +32,61 @@ struct VertInfo
 	float hitIntensity = 0.0f;
 };*/
 
-class OctreeTarget
+//Per vertex material, stored as a structure of arrays next to vertInfo so the per step loops run over plain floats.
+//The stress on a vertex is how fast it's pushed (its hit intensity times the projectile speed, per second) times its
+//stiffness. Only the part of the stress over the yield strength deforms it for good, the rest springs back, so a
+//dent stops spreading where the stress drops below yield. Every unit of plastic strain (distance moved for good)
+//raises the yield strength by hardening, deeper dents get harder to push further
+struct MaterialState
 {
-public:
-	OctreeTarget(const char* modelPath, float falloff, float roughness, float threshold) :
-		targetModel(modelPath, true), falloff(falloff), roughness(roughness), threshold(threshold)
+	std::vector<float> yieldStrength;
+	std::vector<float> plasticStrain;
+	std::vector<float> stiffness;
+	std::vector<float> lastShare; //part of the last push the vertex moved by, the ones that took most of it stay pinned while relaxing
+	float hardening = 0.0f;
+
+	void Reset(size_t vertexCount, float yield, float vertexStiffness)
 	{
-		VertInfo vi;
-		std::vector<VertInfo> vInfo(targetModel.meshes[0].vertices.size(), vi);
-		vertInfo = vInfo;
+		yieldStrength.assign(vertexCount, yield);
+		plasticStrain.assign(vertexCount, 0.0f);
+		stiffness.assign(vertexCount, vertexStiffness);
+		lastShare.assign(vertexCount, 0.0f);
+	}
 
-		model = glm::mat4(1.0f);
-		std::cout << "Loaded model info, setting up vertices...\n";
-		//OptimizeVertices();
+	//Forgets the deformation, yield and stiffness stay as they were set
+	void ClearStrain()
+	{
+		std::fill(plasticStrain.begin(), plasticStrain.end(), 0.0f);
+		std::fill(lastShare.begin(), lastShare.end(), 0.0f);
+	}
 
-		std::cout << "Successfully set up target\n";
-		float minX, minY, minZ, maxX, maxY, maxZ;
-		minX = targetModel.meshes[0].vertices[0].Position.x; maxX = minX;
-		minY = targetModel.meshes[0].vertices[0].Position.y; maxY = minY;
-		minZ = targetModel.meshes[0].vertices[0].Position.z; maxZ = minZ;
-		for (int i = 1; i < targetModel.meshes[0].vertices.size(); i++)
+	//Appends the state of vertices added in the middle of an edge, halfway between the edge's two vertices
+	void AddMidpoints(const std::vector<std::pair<int, int>>& parents)
+	{
+		for (const std::pair<int, int>& edge : parents)
 		{
-			if (targetModel.meshes[0].vertices[i].Position.x <= minX)
-				minX = targetModel.meshes[0].vertices[i].Position.x;
-			if (targetModel.meshes[0].vertices[i].Position.x >= maxX)
-				maxX = targetModel.meshes[0].vertices[i].Position.x;
-			
-			if (targetModel.meshes[0].vertices[i].Position.y <= minY)
-				minY = targetModel.meshes[0].vertices[i].Position.y;
-			if (targetModel.meshes[0].vertices[i].Position.y >= maxY)
-				maxY = targetModel.meshes[0].vertices[i].Position.y;
-			
-			if (targetModel.meshes[0].vertices[i].Position.z <= minZ)
-				minZ = targetModel.meshes[0].vertices[i].Position.z;
-			if (targetModel.meshes[0].vertices[i].Position.z >= maxZ)
-				maxZ = targetModel.meshes[0].vertices[i].Position.z;
-
+			yieldStrength.push_back((yieldStrength[edge.first] + yieldStrength[edge.second]) * 0.5f);
+			plasticStrain.push_back((plasticStrain[edge.first] + plasticStrain[edge.second]) * 0.5f);
+			stiffness.push_back((stiffness[edge.first] + stiffness[edge.second]) * 0.5f);
+			lastShare.push_back(0.0f);
 		}
-		std::cout << "min/max X: " << minX << " " << maxX << "\nmin/max Y: " << minY << " " << maxY <<
-			"\nmin/max Z: " << minZ << " " << maxZ << "\n";
-		boundingBoxSize = fmaxf(fmaxf(maxX - minX, maxY - minY), maxZ - minZ);
-		boundingBoxCenter = glm::vec3((maxX + minX) / 2, (maxY + minY) / 2, (maxZ + minZ) / 2);
-		std::cout << "bounding box size: " << boundingBoxSize << "\n";
+	}
+};
+
+class OctreeTarget
+{
+public:
+	OctreeTarget(const char* modelPath, float falloff, float roughness, float threshold) :
+		targetModel(modelPath, true), falloff(falloff), roughness(roughness), threshold(threshold)
+	{
+		Init();
+	}
+	//Target from a model built in code (procedural geometry), needs no GL context if the model has no buffers
+	//Takes the model by value, pass a temporary or std::move it so the vertex data isn't copied
+	OctreeTarget(Model model, float falloff, float roughness, float threshold) :
+		targetModel(std::move(model)), falloff(falloff), roughness(roughness), threshold(threshold)
+	{
+		Init();
 	}
 
 	void SetupTree(Octree& tree)
@@ -88,15 +104,138 @@ public:
 	void Draw(Shader& shader)
 	{
 		//this convention is assumed
-		shader.setMat4("model", model);
+		shader.setMat4(modelUniform.get(shader), model);
 
-		shader.setVec3("material.diffuse", targetModel.material.diffuse);
-		shader.setVec3("material.specular", targetModel.material.specular);
-		shader.setFloat("material.shininess", 32.0f);
+		shader.setVec3(diffuseUniform.get(shader), targetModel.material.diffuse);
+		shader.setVec3(specularUniform.get(shader), targetModel.material.specular);
+		shader.setFloat(shininessUniform.get(shader), 32.0f);
 
 		targetModel.Draw(shader);
 	}
 
+	//Refines the mesh where a dent is going to be (see meshRefinement.h), so a low poly target still dents smoothly
+	//Meant for before the simulation starts denting it, nothing else may hold on to vertex counts or indices meanwhile
+	//New vertices get the material state of the edge they split, the tree and the GPU buffers are updated in place
+	//Returns how many triangles were split
+	int RefineAround(Octree& tree, glm::vec3 center, float radius, float maxEdge, int maxNewTriangles)
+	{
+		Mesh& mesh = targetModel.meshes[0];
+		MeshRefinement refinement(mesh, tree);
+		RefinementResult result = refinement.RefineAround(center, radius, maxEdge, maxNewTriangles);
+		vertInfo.resize(mesh.vertices.size());
+		materialState.AddMidpoints(result.parents);
+		if (result.firstChangedIndex != INT_MAX)
+			mesh.UpdateBufferGrowth(result.firstNewVertex, result.firstChangedIndex);
+		LOG_INFO("Refined the target around the impact: " << result.splits << " splits, " << result.parents.size() << " new vertices, "
+			<< mesh.indices.size() / 3 << " triangles" << (result.reachedBudget ? " (triangle budget reached)" : ""));
+		return result.splits;
+	}
+
+	//Starts recording the deformation, with the mesh as it is now as the pristine one (see DeformationHistory)
+	//Call it after any refinement, the vertex count mustn't change while recording
+	void BeginHistory(size_t memoryCap, int keyframeInterval)
+	{
+		history.Begin(targetModel.meshes[0].vertices, memoryCap, keyframeInterval);
+	}
+
+	//Records a simulation step, moved lists the vertices it moved, does nothing until BeginHistory
+	void RecordFrame(const std::vector<int>& moved)
+	{
+		history.Record(targetModel.meshes[0].vertices, moved);
+	}
+
+	//Puts the mesh into the state of a recorded step, first and last get the vertices to upload
+	//The vertices it moves are passed to the tree (see Octree::VerticesMoved), so it can be queried afterwards
+	bool SeekFrame(Octree& tree, int frame, int& first, int& last)
+	{
+		if (!history.Seek(targetModel.meshes[0].vertices, frame, first, last))
+			return false;
+		tree.VerticesMoved(history.TouchedVerts());
+		return true;
+	}
+
+	//Puts the mesh and its material back the way they were at BeginHistory and starts a new history, so the
+	//target can be hit again without reloading it. first and last get the vertices to upload
+	bool ResetDeformation(Octree& tree, int& first, int& last)
+	{
+		if (!history.RestorePristine(targetModel.meshes[0].vertices, first, last))
+			return false;
+		tree.VerticesMoved(history.TouchedVerts()); //before the restart forgets which ones they were
+		materialState.ClearStrain();
+		std::fill(vertInfo.begin(), vertInfo.end(), VertInfo());
+		history.Restart(targetModel.meshes[0].vertices);
+		return true;
+	}
+
+	//The same yield strength and stiffness for every vertex, the constructor starts them at threshold and 1
+	//Clears the plastic strain, meant for before the simulation
+	void SetMaterial(float yield, float vertexStiffness)
+	{
+		materialState.Reset(targetModel.meshes[0].vertices.size(), yield, vertexStiffness);
+	}
+
+	//Yield strength and stiffness per vertex, in mesh order, so parts of the target can give way more easily than others
+	//Set it before refining, the vertices refinement adds take the average of their edge's two
+	//Returns false, and changes nothing, if either doesn't have a value for every vertex
+	bool SetMaterial(const std::vector<float>& yield, const std::vector<float>& vertexStiffness)
+	{
+		size_t vertexCount = targetModel.meshes[0].vertices.size();
+		if (yield.size() != vertexCount || vertexStiffness.size() != vertexCount)
+			return false;
+		materialState.Reset(vertexCount, 0.0f, 0.0f);
+		materialState.yieldStrength = yield;
+		materialState.stiffness = vertexStiffness;
+		return true;
+	}
+
+	//Dents the given vertices by the plastic part of push (the projectile's displacement this step) scaled by their hit
+	//intensity, time is the length of the step in seconds. The state of the vertices is gathered into contiguous arrays
+	//first, so the stress loop has no branches or indirection and vectorises, and only the listed vertices are touched
+	//Returns the largest part of the push any of them moved by, that's how far the projectile gets
+	float Deform(const std::vector<int>& verts, glm::vec3 push, float time)
+	{
+		int count = (int)verts.size();
+		float pushLength = glm::length(push);
+		if (count == 0 || pushLength <= 0.0f || time <= 0.0f)
+			return 0.0f;
+
+		intensityScratch.resize(count);
+		yieldScratch.resize(count);
+		stiffnessScratch.resize(count);
+		shareScratch.resize(count);
+		for (int k = 0; k < count; k++)
+		{
+			int vert = verts[k];
+			intensityScratch[k] = vertInfo[vert].hitIntensity;
+			yieldScratch[k] = materialState.yieldStrength[vert] + materialState.hardening * materialState.plasticStrain[vert];
+			stiffnessScratch[k] = materialState.stiffness[vert];
+		}
+
+		float velocity = pushLength / time;
+		const float* intensity = intensityScratch.data();
+		const float* yield = yieldScratch.data();
+		const float* stiffness = stiffnessScratch.data();
+		float* share = shareScratch.data();
+		for (int k = 0; k < count; k++)
+		{
+			float stress = stiffness[k] * intensity[k] * velocity;
+			float plastic = fmaxf(stress - yield[k], 0.0f) / fmaxf(stress, FLT_MIN);
+			share[k] = intensity[k] * plastic;
+		}
+
+		float largestShare = 0.0f;
+		std::vector<Vertex>& vertices = targetModel.meshes[0].vertices;
+		for (int k = 0; k < count; k++)
+		{
+			int vert = verts[k];
+			vertices[vert].Position += push * share[k];
+			materialState.plasticStrain[vert] += share[k] * pushLength;
+			materialState.lastShare[vert] = share[k];
+			largestShare = fmaxf(largestShare, share[k]);
+		}
+		return largestShare;
+	}
+
 	//Calculates ray falloff given the material parameters, returns intensity in % of original force, or direct 0 if greater than falloff
 	float falloffFunc(float input)
 	{
@@ -112,10 +251,54 @@ public:
 	glm::mat4 model;
 	std::vector<glm::vec3> optimizedVerts;
 	std::vector<VertInfo> vertInfo;
+	MaterialState materialState; //yield strength starts at threshold, stiffness at 1, see SetMaterial
+	DeformationHistory history;
 	float boundingBoxSize;
 	glm::vec3 boundingBoxCenter;
 	float falloff;
 private:
+	//Bounds and per vertex state, shared by the constructors
+	void Init()
+	{
+		VertInfo vi;
+		std::vector<VertInfo> vInfo(targetModel.meshes[0].vertices.size(), vi);
+		vertInfo = vInfo;
+		materialState.Reset(targetModel.meshes[0].vertices.size(), threshold, 1.0f);
+
+		model = glm::mat4(1.0f);
+		LOG_INFO("Loaded model info, setting up vertices...");
+		//OptimizeVertices();
+
+		LOG_INFO("Successfully set up target");
+		float minX, minY, minZ, maxX, maxY, maxZ;
+		minX = targetModel.meshes[0].vertices[0].Position.x; maxX = minX;
+		minY = targetModel.meshes[0].vertices[0].Position.y; maxY = minY;
+		minZ = targetModel.meshes[0].vertices[0].Position.z; maxZ = minZ;
+		for (int i = 1; i < targetModel.meshes[0].vertices.size(); i++)
+		{
+			if (targetModel.meshes[0].vertices[i].Position.x <= minX)
+				minX = targetModel.meshes[0].vertices[i].Position.x;
+			if (targetModel.meshes[0].vertices[i].Position.x >= maxX)
+				maxX = targetModel.meshes[0].vertices[i].Position.x;
+			
+			if (targetModel.meshes[0].vertices[i].Position.y <= minY)
+				minY = targetModel.meshes[0].vertices[i].Position.y;
+			if (targetModel.meshes[0].vertices[i].Position.y >= maxY)
+				maxY = targetModel.meshes[0].vertices[i].Position.y;
+			
+			if (targetModel.meshes[0].vertices[i].Position.z <= minZ)
+				minZ = targetModel.meshes[0].vertices[i].Position.z;
+			if (targetModel.meshes[0].vertices[i].Position.z >= maxZ)
+				maxZ = targetModel.meshes[0].vertices[i].Position.z;
+
+		}
+		LOG_DEBUG("min/max X: " << minX << " " << maxX << ", min/max Y: " << minY << " " << maxY <<
+			", min/max Z: " << minZ << " " << maxZ);
+		boundingBoxSize = fmaxf(fmaxf(maxX - minX, maxY - minY), maxZ - minZ);
+		boundingBoxCenter = glm::vec3((maxX + minX) / 2, (maxY + minY) / 2, (maxZ + minZ) / 2);
+		LOG_DEBUG("bounding box size: " << boundingBoxSize);
+	}
+
 	void OptimizeVertices()
 	{
 		for (int i = 0; i < targetModel.meshes[0].vertices.size(); i++)
@@ -129,15 +312,14 @@ private:
 			if (!found)
 				optimizedVerts.push_back(targetModel.meshes[0].vertices[i].Position);
 			if (!(i % 250))
-			{
-				system("CLS");
-				std::cout << "optimizing: " << float(i) * 100.0f / targetModel.meshes[0].vertices.size() << "%\n";
-
-			}
+				LOG_DEBUG("optimizing: " << float(i) * 100.0f / targetModel.meshes[0].vertices.size() << "%");
 		}
 	}
 	float roughness;
 	float threshold;
+	//Deform's gathered vertex state, kept between steps so they aren't reallocated
+	std::vector<float> intensityScratch, yieldScratch, stiffnessScratch, shareScratch;
+	UniformHandle modelUniform{ "model" }, diffuseUniform{ "material.diffuse" }, specularUniform{ "material.specular" }, shininessUniform{ "material.shininess" };
 };
 
 #endif
\ No newline at end of file
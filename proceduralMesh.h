@@ -0,0 +1,155 @@
+#ifndef PROCEDURAL_MESH_H
+#define PROCEDURAL_MESH_H
+//-------------------------------------------------------------------------------------
+// Procedurally generated models (tessellated planes, spheres, noisy terrain), so test
+// scenes of any size can be built without assets. All of them are centered on the
+// origin and fit in a box of the given size, with front faces facing outwards/up.
+// Without createBuffers the models stay CPU only and need no GL context.
+//-------------------------------------------------------------------------------------
+
+#include<glm\glm.hpp>
+#include<glm\gtc\constants.hpp>
+
+#include<vector>
+#include<random>
+#include<math.h>
+#include "model.h"
+
+namespace ProceduralMesh
+{
+	Model MakeModel(std::vector<Vertex> vertices, std::vector<unsigned int> indices, bool createBuffers)
+	{
+		std::vector<Mesh> meshes;
+		meshes.push_back(Mesh(std::move(vertices), std::move(indices), std::vector<Texture>(), true, createBuffers));
+		Model model(std::move(meshes));
+		model.material.diffuse = glm::vec3(0.8f);
+		model.material.specular = glm::vec3(0.5f);
+		model.material.ambient = glm::vec3(0.1f);
+		model.material.shininess = 32.0f;
+		return model;
+	}
+
+	//Grid of quadsPerSide x quadsPerSide quads on the XZ plane with the given heights (row major, (quadsPerSide + 1)^2 of them)
+	Model HeightGrid(int quadsPerSide, float size, const std::vector<float>& heights, bool createBuffers)
+	{
+		int side = quadsPerSide + 1;
+		float spacing = size / quadsPerSide;
+		std::vector<Vertex> vertices(side * side);
+		for (int z = 0; z < side; z++)
+		{
+			for (int x = 0; x < side; x++)
+			{
+				Vertex& vertex = vertices[z * side + x];
+				vertex.Position = glm::vec3(x * spacing - size * 0.5f, heights[z * side + x], z * spacing - size * 0.5f);
+				//normal from the neighbouring heights (central differences, one sided on the border)
+				float left = heights[z * side + max(x - 1, 0)], right = heights[z * side + min(x + 1, side - 1)];
+				float back = heights[max(z - 1, 0) * side + x], front = heights[min(z + 1, side - 1) * side + x];
+				vertex.Normal = glm::normalize(glm::vec3(left - right, 2.0f * spacing, back - front));
+				vertex.TexCoords = glm::vec2((float)x / quadsPerSide, (float)z / quadsPerSide);
+				vertex.Tangent = glm::vec3(1.0f, 0.0f, 0.0f);
+				vertex.Bitangent = glm::vec3(0.0f, 0.0f, 1.0f);
+			}
+		}
+
+		std::vector<unsigned int> indices;
+		indices.reserve(quadsPerSide * quadsPerSide * 6);
+		for (int z = 0; z < quadsPerSide; z++)
+		{
+			for (int x = 0; x < quadsPerSide; x++)
+			{
+				unsigned int i00 = z * side + x, i10 = i00 + 1, i01 = i00 + side, i11 = i01 + 1;
+				//counter clockwise seen from above
+				indices.insert(indices.end(), { i00, i01, i10 });
+				indices.insert(indices.end(), { i10, i01, i11 });
+			}
+		}
+		return MakeModel(std::move(vertices), std::move(indices), createBuffers);
+	}
+
+	//Flat plane, 2 * quadsPerSide^2 triangles
+	Model Plane(int quadsPerSide, float size, bool createBuffers = true)
+	{
+		return HeightGrid(quadsPerSide, size, std::vector<float>((quadsPerSide + 1) * (quadsPerSide + 1), 0.0f), createBuffers);
+	}
+
+	//Plane with fractal value noise heights up to amplitude, 2 * quadsPerSide^2 triangles, same seed gives the same terrain
+	Model Terrain(int quadsPerSide, float size, float amplitude, unsigned int seed, bool createBuffers = true)
+	{
+		const int latticeSize = 64;
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::vector<float> lattice(latticeSize * latticeSize);
+		for (float& value : lattice)
+			value = unit(random);
+
+		//bilinearly interpolated lattice values, wrapping around
+		auto noise = [&](float x, float z)
+		{
+			int x0 = (int)floorf(x), z0 = (int)floorf(z);
+			float fx = x - x0, fz = z - z0;
+			fx = fx * fx * (3.0f - 2.0f * fx); //smoothstep, hides the lattice
+			fz = fz * fz * (3.0f - 2.0f * fz);
+			auto at = [&](int lx, int lz) { return lattice[(lz & (latticeSize - 1)) * latticeSize + (lx & (latticeSize - 1))]; };
+			float top = at(x0, z0) + (at(x0 + 1, z0) - at(x0, z0)) * fx;
+			float bottom = at(x0, z0 + 1) + (at(x0 + 1, z0 + 1) - at(x0, z0 + 1)) * fx;
+			return top + (bottom - top) * fz;
+		};
+
+		int side = quadsPerSide + 1;
+		std::vector<float> heights(side * side);
+		for (int z = 0; z < side; z++)
+		{
+			for (int x = 0; x < side; x++)
+			{
+				float height = 0.0f, octaveAmplitude = 0.5f, frequency = 4.0f / quadsPerSide;
+				for (int octave = 0; octave < 4; octave++)
+				{
+					height += octaveAmplitude * noise(x * frequency, z * frequency);
+					octaveAmplitude *= 0.5f;
+					frequency *= 2.0f;
+				}
+				heights[z * side + x] = height * amplitude;
+			}
+		}
+		return HeightGrid(quadsPerSide, size, heights, createBuffers);
+	}
+
+	//UV sphere, rings from pole to pole, 2 * rings * segments - 2 * segments triangles (the poles only get one per segment)
+	Model Sphere(int rings, int segments, float radius, bool createBuffers = true)
+	{
+		std::vector<Vertex> vertices;
+		vertices.reserve((rings + 1) * (segments + 1));
+		for (int r = 0; r <= rings; r++)
+		{
+			float theta = glm::pi<float>() * r / rings;
+			for (int s = 0; s <= segments; s++)
+			{
+				float phi = 2.0f * glm::pi<float>() * s / segments;
+				Vertex vertex;
+				vertex.Normal = glm::vec3(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+				vertex.Position = vertex.Normal * radius;
+				vertex.TexCoords = glm::vec2((float)s / segments, (float)r / rings);
+				vertex.Tangent = glm::vec3(-sinf(phi), 0.0f, cosf(phi));
+				vertex.Bitangent = glm::cross(vertex.Normal, vertex.Tangent);
+				vertices.push_back(vertex);
+			}
+		}
+
+		std::vector<unsigned int> indices;
+		for (int r = 0; r < rings; r++)
+		{
+			for (int s = 0; s < segments; s++)
+			{
+				unsigned int i00 = r * (segments + 1) + s, i01 = i00 + 1, i10 = i00 + segments + 1, i11 = i10 + 1;
+				//counter clockwise seen from outside, skipping the zero area ones at the poles
+				if (r != 0)
+					indices.insert(indices.end(), { i00, i01, i10 });
+				if (r != rings - 1)
+					indices.insert(indices.end(), { i01, i11, i10 });
+			}
+		}
+		return MakeModel(std::move(vertices), std::move(indices), createBuffers);
+	}
+}
+
+#endif
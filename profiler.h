@@ -0,0 +1,241 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+//-------------------------------------------------------------------------------------
+// Scoped timing zones and per frame telemetry. PROFILE_ZONE("name") times the rest of
+// the enclosing scope, zones nest, and every thread records into its own buffer.
+// PROFILE_FRAME() marks where a frame starts, zones from all threads are grouped into
+// the frame they started in. Results can be exported as a Chrome trace (open it in
+// chrome://tracing or Perfetto) or as a CSV with per frame totals of every zone.
+// Build with DEFORM_PROFILING defined as 0 to compile all of it out of the hot paths.
+//-------------------------------------------------------------------------------------
+
+#ifndef DEFORM_PROFILING
+#define DEFORM_PROFILING 1
+#endif
+
+#include<chrono>
+#include<vector>
+#include<string>
+#include<mutex>
+#include<memory>
+#include<fstream>
+#include<map>
+#include<algorithm>
+#include<iostream>
+#include "logger.h"
+
+struct ProfileEvent
+{
+	const char* name; //zone names have to be string literals, only the pointer is kept
+	long long start; //ns since the profiler started
+	long long duration; //ns
+	int depth; //nesting level on its thread, 0 is the outermost zone
+};
+
+class Profiler
+{
+public:
+	static Profiler& Get()
+	{
+		static Profiler profiler;
+		return profiler;
+	}
+
+	//Nanoseconds since the profiler started
+	long long Now() const
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+	}
+
+	void Record(const char* name, long long start, long long duration, int depth)
+	{
+		ThreadBuffer& buffer = CurrentBuffer();
+		std::lock_guard<std::mutex> lock(buffer.mutex); //only ever contended while exporting
+		if (buffer.events.size() >= maxEventsPerThread)
+		{
+			buffer.dropped++;
+			return;
+		}
+		buffer.events.push_back(ProfileEvent{ name, start, duration, depth });
+	}
+
+	//Marks the start of a new frame, call it from the render loop
+	void BeginFrame()
+	{
+		long long now = Now();
+		std::lock_guard<std::mutex> lock(framesMutex);
+		frameStarts.push_back(now);
+	}
+
+	//Zone nesting level of the calling thread
+	static int& Depth()
+	{
+		static thread_local int depth = 0;
+		return depth;
+	}
+
+	//Timing hook for the job system, shows every job as a zone on the thread that ran it
+	//The job system calls it on that thread, so the zone lands on its track without the worker index
+	static void RecordJob(const char* name, int /*worker*/, double seconds)
+	{
+		long long end = Get().Now();
+		long long duration = (long long)(seconds * 1e9);
+		Get().Record(name, end - duration, duration, Depth());
+	}
+
+	//Every recorded zone as a complete event ("ph":"X") plus an instant event for every frame start
+	bool WriteChromeTrace(const std::string& path)
+	{
+		std::ofstream out(path);
+		if (!out)
+		{
+			LOG_ERROR("Couldn't open " << path << " for writing the trace");
+			return false;
+		}
+		out << "{\"traceEvents\":[\n";
+		bool first = true;
+		{
+			std::lock_guard<std::mutex> lock(framesMutex);
+			for (size_t i = 0; i < frameStarts.size(); i++)
+			{
+				out << (first ? "" : ",\n") << "{\"name\":\"frame " << i << "\",\"ph\":\"i\",\"s\":\"g\",\"pid\":0,\"tid\":0,\"ts\":" << frameStarts[i] / 1000.0 << "}";
+				first = false;
+			}
+		}
+		std::lock_guard<std::mutex> registryLock(registryMutex);
+		for (auto& buffer : threads)
+		{
+			std::lock_guard<std::mutex> lock(buffer->mutex);
+			for (const ProfileEvent& event : buffer->events)
+			{
+				out << (first ? "" : ",\n") << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->threadId
+					<< ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << event.duration / 1000.0 << "}";
+				first = false;
+			}
+			if (buffer->dropped > 0)
+				LOG_WARN("Profiler: thread " << buffer->threadId << " dropped " << buffer->dropped << " zones, its buffer was full");
+		}
+		out << "\n]}\n";
+		return true;
+	}
+
+	//One row per frame and zone: how many times the zone ran in that frame, its total and its longest time
+	//Zones started before the first frame go into frame -1
+	bool WriteFrameCsv(const std::string& path)
+	{
+		std::ofstream out(path);
+		if (!out)
+		{
+			LOG_ERROR("Couldn't open " << path << " for writing the frame records");
+			return false;
+		}
+		std::vector<long long> starts;
+		{
+			std::lock_guard<std::mutex> lock(framesMutex);
+			starts = frameStarts;
+		}
+
+		struct ZoneTotal
+		{
+			int calls = 0;
+			long long total = 0;
+			long long longest = 0;
+		};
+		std::map<int, std::map<std::string, ZoneTotal>> frames;
+		{
+			std::lock_guard<std::mutex> registryLock(registryMutex);
+			for (auto& buffer : threads)
+			{
+				std::lock_guard<std::mutex> lock(buffer->mutex);
+				for (const ProfileEvent& event : buffer->events)
+				{
+					int frame = (int)(std::upper_bound(starts.begin(), starts.end(), event.start) - starts.begin()) - 1;
+					ZoneTotal& zone = frames[frame][event.name];
+					zone.calls++;
+					zone.total += event.duration;
+					zone.longest = std::max(zone.longest, event.duration);
+				}
+			}
+		}
+
+		out << "frame,frameMs,zone,calls,totalMs,longestMs\n";
+		for (auto& frame : frames)
+		{
+			double frameMs = 0.0;
+			if (frame.first >= 0 && (size_t)frame.first + 1 < starts.size())
+				frameMs = (starts[frame.first + 1] - starts[frame.first]) / 1e6;
+			for (auto& zone : frame.second)
+			{
+				out << frame.first << "," << frameMs << "," << zone.first << "," << zone.second.calls << ","
+					<< zone.second.total / 1e6 << "," << zone.second.longest / 1e6 << "\n";
+			}
+		}
+		return true;
+	}
+
+private:
+	Profiler() : epoch(std::chrono::steady_clock::now())
+	{
+	}
+
+	struct ThreadBuffer
+	{
+		std::mutex mutex;
+		std::vector<ProfileEvent> events;
+		int threadId;
+		long long dropped = 0;
+	};
+
+	ThreadBuffer& CurrentBuffer()
+	{
+		static thread_local ThreadBuffer* buffer = nullptr;
+		if (buffer == nullptr)
+		{
+			std::lock_guard<std::mutex> lock(registryMutex);
+			threads.push_back(std::unique_ptr<ThreadBuffer>(new ThreadBuffer()));
+			buffer = threads.back().get();
+			buffer->threadId = (int)threads.size() - 1;
+			buffer->events.reserve(4096);
+		}
+		return *buffer;
+	}
+
+	static const size_t maxEventsPerThread = 1 << 20; //~32MB per thread, zones past it are counted and dropped
+
+	std::chrono::steady_clock::time_point epoch;
+	std::mutex registryMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> threads;
+	std::mutex framesMutex;
+	std::vector<long long> frameStarts;
+};
+
+//Times its own lifetime, use it through PROFILE_ZONE so it can be compiled out
+class ProfileZone
+{
+public:
+	ProfileZone(const char* name) : name(name), start(Profiler::Get().Now())
+	{
+		Profiler::Depth()++;
+	}
+	~ProfileZone()
+	{
+		int depth = --Profiler::Depth();
+		Profiler::Get().Record(name, start, Profiler::Get().Now() - start, depth);
+	}
+
+private:
+	const char* name;
+	long long start;
+};
+
+#if DEFORM_PROFILING
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FRAME() Profiler::Get().BeginFrame()
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_FRAME()
+#endif
+
+#endif
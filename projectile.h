@@ -3,7 +3,12 @@
 //-------------------------------------------------------------------------------------
 // Projectile class, contains 2 classes: Projectile (with a mesh), and PointProjectile.
 // Both classes are ray casters, PointProjectile casts a single ray, Projectile casts
-// a ray per vertex
+// a ray per vertex. Projectile is the reference the octree version is checked against,
+// it tests the same things, but finds the candidate triangles and falloff neighbours
+// through spatial hash grids instead of trying every pair. Update dents with its own
+// model (the rays are cast once, the falloff spreads from the collided vertices),
+// StepLikeOctree dents like OctreeProjectile::Update, so the two can be compared
+// vertex by vertex.
 //-------------------------------------------------------------------------------------
 
 #include<GLAD\glad.h>
@@ -17,10 +22,13 @@
 #include<string>
 #include<fstream>
 #include<utility>
+#include<set>
 #include "target.h"
 #include "shader.h"
 #include "model.h"
 #include "rayUtil.h"
+#include "logger.h"
+#include "spatialHash.h"
 
 class Projectile
 {
@@ -29,13 +37,13 @@ public:
 		projectileMesh(meshPath.c_str(), true), acceleration(accel), 
 		rayShader("../OpenGL_DeformProj/ray.vert", "../OpenGL_DeformProj/ray.frag")
 	{
-		rayDirection = acceleration;
-		speed = acceleration;
-		std::cout << "Successfully constructed projectile ";
-		OptimizeVertices();
-		std::cout << "optimized verts size: " << optimizedVerts.size() << "\n";
-
-		//std::cout << projectileMesh.meshes[0].vertices.size();//.vertices.size();
+		Init();
+	}
+	//Projectile from a model built in code (procedural geometry), for headless runs, its rays can't be rendered
+	Projectile(Model mesh, glm::vec3 accel) :
+		projectileMesh(std::move(mesh)), model(1.0f), acceleration(accel)
+	{
+		Init();
 	}
 
 	//Casts a single ray on a given triangle of a target, given the ray origin (transformed using a model matrix)
@@ -57,12 +65,20 @@ public:
 
 	void ProcessRays(Target& target, glm::mat4 model)
 	{
+		SetupRayPlane();
+		if (rayDirection == glm::vec3(0.0f))
+			return; //rays without a direction can't hit anything
+
 		//cast rays from projectile onto target
+		SpatialHash targetTris;
+		BuildRayGrid(targetTris, target.targetModel.meshes[0], model);
 		for (auto vertexPos : optimizedVerts)
 		{
-			//for every single vertex in the mesh, cast a ray on every triangle of the target
-			for (int i = 0; i < target.targetModel.meshes[0].indices.size(); i += 3)
+			//for every single vertex in the mesh, cast a ray on the target triangles in the grid cell the ray goes through
+			//(in increasing order, so the first hit on a vertex is the same one as when trying every triangle)
+			targetTris.Query(RayPlanePoint(this->model * glm::vec4(vertexPos, 1.0f)), [&](int tri)
 			{
+				int i = tri * 3;
 				float hitDistance = 0.0f;
 				bool rayResult = CastRay(target, i, i + 1, i + 2, vertexPos, model, hitDistance);
 				if (rayResult)
@@ -75,13 +91,16 @@ public:
 						target.vertInfo[target.targetModel.meshes[0].indices[i]].hitIntensity = 1.0f;
 					}
 				}
-			}
+			});
 		}
 		//cast rays from target onto projectile (inverse)
+		SpatialHash projectileTris;
+		BuildRayGrid(projectileTris, projectileMesh.meshes[0], this->model);
 		for (int i = 0; i < target.targetModel.meshes[0].vertices.size(); i++)
 		{
-			for (int j = 0; j < projectileMesh.meshes[0].indices.size(); j += 3)
+			projectileTris.Query(RayPlanePoint(model * glm::vec4(target.targetModel.meshes[0].vertices[i].Position, 1.0f)), [&](int tri)
 			{
+				int j = tri * 3;
 				float hitDistance = 0.0f;
 				bool rayResult = CastInverseRay(j, j + 1, j + 2, target.targetModel.meshes[0].vertices[i].Position, model, hitDistance);
 				if (rayResult)
@@ -96,7 +115,7 @@ public:
 					}
 					//std::cout << hitDistance << "\n"; todo delete
 				}
-			}
+			});
 		}
 	}
 
@@ -105,29 +124,29 @@ public:
 	{
 		if (collision) //If (at least one) ray has intersected with the target
 		{
+			//the vertices hit by rays spread their intensity over the rest
+			std::vector<int> hitVerts;
 			for (int i = 0; i < target.targetModel.meshes[0].vertices.size(); i++)
 			{
-				if (!target.vertInfo[i].isInitialized)
-				{
-					float maxIntensity = 0.0f;
-					for (int j = 0; j < target.targetModel.meshes[0].vertices.size(); j++)
-					{
-						float dist = glm::length(target.targetModel.meshes[0].vertices[i].Position - target.targetModel.meshes[0].vertices[j].Position);
-						float currIntensity = target.falloffFunc(dist);
-						if ((dist < target.falloff) && (target.vertInfo[j].isInitialized) && currIntensity > maxIntensity)
-						{
-							maxIntensity = currIntensity;
-							target.vertInfo[i].isColliding = true;
-						}
-					}
-
-					target.vertInfo[i].hitIntensity = maxIntensity;
-				}
+				if (target.vertInfo[i].isInitialized)
+					hitVerts.push_back(i);
+				else
+					target.vertInfo[i].hitIntensity = 0.0f;
 			}
+
+			ForEachNearest(target, hitVerts, [&](int i, float distance)
+			{
+				if (target.vertInfo[i].isInitialized)
+					return;
+				float maxIntensity = target.falloffFunc(distance);
+				if (maxIntensity > 0.0f)
+					target.vertInfo[i].isColliding = true;
+				target.vertInfo[i].hitIntensity = maxIntensity;
+			});
 		}
 	}
 
-	void Draw(Shader shader)
+	void Draw(Shader& shader)
 	{
 		shader.use();
 
@@ -142,7 +161,8 @@ public:
 	{
 		target.targetModel.TranslateVertex(0, index, speed * target.vertInfo[index].hitIntensity);
 		//Update the deformed vertices in the vertex buffer
-		target.targetModel.meshes[0].UpdateBufferVertexDirect(index);
+		if (target.targetModel.meshes[0].VAO != 0)
+			target.targetModel.meshes[0].UpdateBufferVertexDirect(index);
 	}
 
 	void Update(Target& target, float time, glm::mat4 model)
@@ -156,10 +176,12 @@ public:
 			for (int i = 0; i < projectileMesh.meshes[0].vertices.size(); i++)
 			{
 				projectileMesh.meshes[0].vertices[i].Position += speed; //Change position of all vertices according to current speed
-				projectileMesh.meshes[0].UpdateBufferVertexDirect(i);
+				if (projectileMesh.meshes[0].VAO != 0)
+					projectileMesh.meshes[0].UpdateBufferVertexDirect(i);
 			}
 			
 			//Update distances to impact on vertices
+			collidedVerts.clear();
 			for (int i = 0; i < target.targetModel.meshes[0].vertices.size(); i++)
 			{
 				if (target.vertInfo[i].isInitialized)
@@ -170,20 +192,12 @@ public:
 						//the given vertex is colliding
 						target.vertInfo[i].isColliding = true;
 						acceleration = -rayDirection; //reverse acceleration direction on hit (start slowing down)
-
-						// calculate the falloff around the collided vertex
-						for (int j = 0; j < target.targetModel.meshes[0].vertices.size(); j++)
-						{
-							float falloff = target.falloffFunc(glm::length(target.targetModel.meshes[0].vertices[i].Position - target.targetModel.meshes[0].vertices[j].Position));
-							if (falloff > target.vertInfo[j].hitIntensity)
-							{
-								target.vertInfo[j].hitIntensity = falloff;
-								target.vertInfo[j].isColliding = true;
-							}
-						}
+						collidedVerts.push_back(i);
 					}
 				}
 			}
+			// calculate the falloff around the collided vertices
+			SpreadFalloff(target, collidedVerts);
 
 			for (int i = 0; i < target.targetModel.meshes[0].vertices.size(); i++)
 			{
@@ -206,18 +220,76 @@ public:
 		}
 	}
 
+	//Advances by one fixed step the way OctreeProjectile::Update does, with the same dent model: the vertices hit so far
+	//are pushed by the step scaled by their hit intensity, then the projectile's triangles are swept over the next step
+	//and the rays are cast again over the distance it covers, and the falloff spreads from the points they hit.
+	//The target has no yield model, it takes all of every push like an octree target with a threshold of 0 does.
+	//Don't mix it with ProcessRays and Update on the same projectile
+	void StepLikeOctree(Target& target, float time)
+	{
+		std::vector<Vertex>& targetVerts = target.targetModel.meshes[0].vertices;
+		//the step that first touched the target ended at the surface, the rest of it is pushed into the target now
+		glm::vec3 step = speed * (1.0f + contactRemainder);
+		float stepTime = time * (1.0f + contactRemainder);
+		contactRemainder = 0.0f;
+		if (collision && !affectedVerts.empty())
+		{
+			//the projectile keeps the part of the push that the vertex giving way the most took
+			float largestShare = 0.0f;
+			if (glm::length(step) > 0.0f && stepTime > 0.0f)
+			{
+				for (int vert : affectedVerts)
+				{
+					targetVerts[vert].Position += step * target.vertInfo[vert].hitIntensity;
+					largestShare = fmaxf(largestShare, target.vertInfo[vert].hitIntensity);
+					if (target.targetModel.meshes[0].VAO != 0)
+						target.targetModel.meshes[0].UpdateBufferVertexDirect(vert);
+				}
+			}
+			speed *= largestShare;
+			step *= largestShare;
+		}
+
+		bool touching = collision;
+		CastStep(target, step);
+		//the step that first reaches the target stops where the sweep touched it
+		if (!touching && timeOfImpact >= 0.0f)
+		{
+			contactRemainder = 1.0f - timeOfImpact;
+			step *= timeOfImpact;
+		}
+		for (int i = 0; i < optimizedVerts.size(); i++)
+			optimizedVerts[i] += step;
+		for (int i = 0; i < projectileMesh.meshes[0].vertices.size(); i++)
+		{
+			projectileMesh.meshes[0].vertices[i].Position += step;
+			if (projectileMesh.meshes[0].VAO != 0)
+				projectileMesh.meshes[0].UpdateBufferVertexDirect(i);
+		}
+
+		if (glm::dot(speed, rayDirection) < __EPSILON)
+		{
+			speed = glm::vec3(0, 0, 0);
+			isDone = true;
+		}
+		else
+			speed += acceleration * time;
+	}
+
 	//Renders a ray that has length of acceleration
 	void RenderRays(glm::mat4 view, glm::mat4 projection)
 	{
 		for(int i = 0; i < optimizedVerts.size(); i++)
-			RayUtil::renderRay(optimizedVerts[i], rayDirection, view, model, projection, rayShader);
+			rayLines.AddRay(optimizedVerts[i], rayDirection, model);
+		rayLines.Flush(rayShader, view, projection);
 	}
 
 	//Renders a ray with infinite length
 	void RenderInfiniteRays(glm::mat4 view, glm::mat4 projection)
 	{
 		for (int i = 0; i < optimizedVerts.size(); i++)
-			RayUtil::renderRay(optimizedVerts[i], rayDirection * 1000000.0f, view, model, projection, rayShader);
+			rayLines.AddRay(optimizedVerts[i], rayDirection * 1000000.0f, model);
+		rayLines.Flush(rayShader, view, projection);
 	}
 
 	Model projectileMesh;
@@ -226,20 +298,268 @@ public:
 	glm::vec3 rayDirection;
 	bool isDone = false; //is the sim over?
 private:
+	void Init()
+	{
+		rayDirection = acceleration;
+		speed = acceleration;
+		OptimizeVertices();
+		LOG_INFO("Successfully constructed projectile, optimized verts size: " << optimizedVerts.size());
+	}
+
 	void OptimizeVertices()
 	{
-		for (int i = 0; i < projectileMesh.meshes[0].vertices.size(); i++)
+		std::vector<glm::vec3> positions;
+		positions.reserve(projectileMesh.meshes[0].vertices.size());
+		for (const Vertex& vertex : projectileMesh.meshes[0].vertices)
+			positions.push_back(vertex.Position);
+		optimizedVerts = SpatialHash::UniquePoints(positions);
+	}
+
+	//All rays are parallel, so a ray hits a triangle only if its origin lands in the triangle once both are flattened
+	//along the ray direction. The ray grids are built on that plane, u and v span it
+	void SetupRayPlane()
+	{
+		glm::vec3 direction = glm::normalize(rayDirection);
+		glm::vec3 helper = fabsf(direction.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+		rayPlaneU = glm::normalize(glm::cross(direction, helper));
+		rayPlaneV = glm::cross(direction, rayPlaneU);
+	}
+
+	glm::vec3 RayPlanePoint(glm::vec3 point) const
+	{
+		return glm::vec3(glm::dot(point, rayPlaneU), glm::dot(point, rayPlaneV), 0.0f);
+	}
+
+	//Grid over the triangles of mesh (transformed by model) flattened onto the ray plane, cells about the size of
+	//an average triangle. The boxes are padded a bit so rays grazing an edge still find the triangle
+	void BuildRayGrid(SpatialHash& grid, const Mesh& mesh, const glm::mat4& model)
+	{
+		int triCount = (int)mesh.indices.size() / 3;
+		std::vector<glm::vec3> mins(triCount), maxs(triCount);
+		float sizeSum = 0.0f;
+		for (int t = 0; t < triCount; t++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				glm::vec3 point = RayPlanePoint(model * glm::vec4(mesh.vertices[mesh.indices[t * 3 + k]].Position, 1.0f));
+				mins[t] = k == 0 ? point : glm::min(mins[t], point);
+				maxs[t] = k == 0 ? point : glm::max(maxs[t], point);
+			}
+			sizeSum += fmaxf(maxs[t].x - mins[t].x, maxs[t].y - mins[t].y);
+		}
+		float cellSize = triCount > 0 && sizeSum > 0.0f ? sizeSum / triCount : 1.0f;
+		glm::vec3 padding = glm::vec3(cellSize * 0.001f, cellSize * 0.001f, 0.0f);
+		for (int t = 0; t < triCount; t++)
+		{
+			mins[t] -= padding;
+			maxs[t] += padding;
+		}
+		grid.Build(mins, maxs, cellSize);
+	}
+
+	//Finds what the projectile runs into if it moves by step, like OctreeProjectile::ProcessRays: the first contact of
+	//the swept triangles, the rays from the projectile onto the target and back that hit within the step. The vertices
+	//of whatever got hit go to full intensity, and the falloff spreads from the hit points
+	void CastStep(Target& target, glm::vec3 step)
+	{
+		const Mesh& targetMesh = target.targetModel.meshes[0];
+		const Mesh& projMesh = projectileMesh.meshes[0];
+		SetupRayPlane();
+		glm::vec3 direction = glm::normalize(rayDirection);
+		float stepLength = glm::length(step);
+		std::vector<glm::vec3> hits;
+		auto hitTriangle = [&](int tri)
+		{
+			acceleration = -rayDirection;
+			collision = true;
+			for (int k = 0; k < 3; k++)
+			{
+				int vert = targetMesh.indices[tri * 3 + k];
+				target.vertInfo[vert].hitIntensity = 1.0f;
+				affectedVerts.insert(vert);
+			}
+		};
+
+		int sweptTri;
+		glm::vec3 contactPoint;
+		timeOfImpact = SweepTimeOfImpact(targetMesh, step, sweptTri, contactPoint);
+		if (timeOfImpact >= 0.0f)
+		{
+			hitTriangle(sweptTri);
+			hits.push_back(contactPoint);
+		}
+
+		//rays from the projectile onto the target
+		SpatialHash targetTris;
+		BuildRayGrid(targetTris, targetMesh, glm::mat4(1.0f));
+		for (const glm::vec3& origin : optimizedVerts)
+		{
+			targetTris.Query(RayPlanePoint(origin), [&](int tri)
+			{
+				float hitDistance = FLT_MAX;
+				if (RayUtil::MTRayCheck(targetMesh.vertices[targetMesh.indices[tri * 3]].Position, targetMesh.vertices[targetMesh.indices[tri * 3 + 1]].Position,
+					targetMesh.vertices[targetMesh.indices[tri * 3 + 2]].Position, origin, direction, hitDistance) && hitDistance < stepLength)
+				{
+					hitTriangle(tri);
+					hits.push_back(origin + hitDistance * direction);
+				}
+			});
+		}
+
+		//rays from the target onto the projectile, they don't make it a collision on their own
+		SpatialHash projectileTris;
+		BuildRayGrid(projectileTris, projMesh, glm::mat4(1.0f));
+		for (int i = 0; i < targetMesh.vertices.size(); i++)
+		{
+			glm::vec3 origin = targetMesh.vertices[i].Position;
+			projectileTris.Query(RayPlanePoint(origin), [&](int tri)
+			{
+				float hitDistance;
+				if (RayUtil::MTRayCheck(projMesh.vertices[projMesh.indices[tri * 3]].Position, projMesh.vertices[projMesh.indices[tri * 3 + 1]].Position,
+					projMesh.vertices[projMesh.indices[tri * 3 + 2]].Position, origin, -direction, hitDistance) && hitDistance < stepLength)
+				{
+					target.vertInfo[i].hitIntensity = 1.0f;
+					affectedVerts.insert(i);
+					hits.push_back(origin + hitDistance * direction);
+				}
+			});
+		}
+
+		//the falloff only drops with distance, so the nearest hit point gives a vertex its strongest intensity
+		ForEachNearest(target, hits, [&](int j, float distance)
+		{
+			float intensity = target.falloffFunc(distance);
+			if (intensity > target.vertInfo[j].hitIntensity)
+			{
+				target.vertInfo[j].hitIntensity = intensity;
+				affectedVerts.insert(j);
+			}
+		});
+	}
+
+	//Earliest time of impact (fraction of displacement, 0 to 1) of the projectile's triangles swept over displacement
+	//against the target's, -1 if nothing gets hit. Target triangles outside the swept bounds of the whole projectile
+	//are skipped, the rest go in mesh order, so ties end on the same triangle as an octree with a single leaf
+	float SweepTimeOfImpact(const Mesh& targetMesh, glm::vec3 displacement, int& hitTri, glm::vec3& contactPoint)
+	{
+		const std::vector<Vertex>& projVerts = projectileMesh.meshes[0].vertices;
+		const std::vector<unsigned int>& projIndices = projectileMesh.meshes[0].indices;
+		std::vector<glm::vec3> sweptMin(projIndices.size() / 3), sweptMax(projIndices.size() / 3);
+		glm::vec3 boxMin = glm::vec3(FLT_MAX), boxMax = glm::vec3(-FLT_MAX);
+		for (int i = 0; i < projIndices.size(); i += 3)
+		{
+			glm::vec3 triMin = projVerts[projIndices[i]].Position, triMax = triMin;
+			for (int k = 1; k < 3; k++)
+			{
+				triMin = glm::min(triMin, projVerts[projIndices[i + k]].Position);
+				triMax = glm::max(triMax, projVerts[projIndices[i + k]].Position);
+			}
+			sweptMin[i / 3] = glm::min(triMin, triMin + displacement);
+			sweptMax[i / 3] = glm::max(triMax, triMax + displacement);
+			boxMin = glm::min(boxMin, sweptMin[i / 3]);
+			boxMax = glm::max(boxMax, sweptMax[i / 3]);
+		}
+
+		float earliest = FLT_MAX;
+		for (int t = 0; t < targetMesh.indices.size(); t += 3)
+		{
+			const glm::vec3& b0 = targetMesh.vertices[targetMesh.indices[t]].Position;
+			const glm::vec3& b1 = targetMesh.vertices[targetMesh.indices[t + 1]].Position;
+			const glm::vec3& b2 = targetMesh.vertices[targetMesh.indices[t + 2]].Position;
+			glm::vec3 targetMin = glm::min(glm::min(b0, b1), b2);
+			glm::vec3 targetMax = glm::max(glm::max(b0, b1), b2);
+			if (boxMin.x > targetMax.x || boxMax.x < targetMin.x || boxMin.y > targetMax.y || boxMax.y < targetMin.y ||
+				boxMin.z > targetMax.z || boxMax.z < targetMin.z)
+				continue;
+			for (int i = 0; i < projIndices.size(); i += 3)
+			{
+				const glm::vec3& triMin = sweptMin[i / 3];
+				const glm::vec3& triMax = sweptMax[i / 3];
+				if (triMin.x > targetMax.x || triMax.x < targetMin.x || triMin.y > targetMax.y || triMax.y < targetMin.y ||
+					triMin.z > targetMax.z || triMax.z < targetMin.z)
+					continue;
+				float toi;
+				glm::vec3 contact;
+				if (RayUtil::SweptTriangleCheck(projVerts[projIndices[i]].Position, projVerts[projIndices[i + 1]].Position,
+					projVerts[projIndices[i + 2]].Position, b0, b1, b2, displacement, toi, contact) && toi < earliest)
+				{
+					earliest = toi;
+					hitTri = t / 3;
+					contactPoint = contact;
+				}
+			}
+		}
+		return earliest == FLT_MAX ? -1.0f : earliest;
+	}
+
+	//Raises the intensity of every vertex within falloff of a collided one
+	void SpreadFalloff(Target& target, const std::vector<int>& collided)
+	{
+		ForEachNearest(target, collided, [&](int j, float distance)
 		{
-			bool found = false;
-			for (int j = 0; j < optimizedVerts.size(); j++)
+			float falloff = target.falloffFunc(distance);
+			if (falloff > target.vertInfo[j].hitIntensity)
 			{
-				if (projectileMesh.meshes[0].vertices[i].Position == optimizedVerts[j])
-					found = true;
+				target.vertInfo[j].hitIntensity = falloff;
+				target.vertInfo[j].isColliding = true;
 			}
-			if(!found)
-				optimizedVerts.push_back(projectileMesh.meshes[0].vertices[i].Position);
+		});
+	}
+
+	//Calls found(vertex, distance) for every target vertex closer than falloff to any of sources, with the distance
+	//to the nearest one. The falloff only drops with distance, so that's the strongest intensity the vertex can get
+	//from them and the falloff function runs once per vertex instead of once per pair. The sources go into a grid,
+	//a vertex looks at the cells around it ring by ring, out to falloff, and stops once the nearest source it found
+	//is closer than anything in the next ring could be
+	template<typename Found>
+	void ForEachNearest(Target& target, const std::vector<int>& sources, Found found)
+	{
+		std::vector<glm::vec3> positions;
+		for (int index : sources)
+			positions.push_back(target.targetModel.meshes[0].vertices[index].Position);
+		ForEachNearest(target, positions, found);
+	}
+
+	//The same for sources anywhere, not only on target vertices (e.g. ray hit points)
+	template<typename Found>
+	void ForEachNearest(Target& target, const std::vector<glm::vec3>& positions, Found found)
+	{
+		const std::vector<Vertex>& targetVerts = target.targetModel.meshes[0].vertices;
+		if (positions.empty() || target.falloff <= 0.0f)
+			return;
+
+		SpatialHash sourceGrid;
+		sourceGrid.Build(positions, target.falloff * 0.25f);
+		glm::vec3 allMin = positions[0], allMax = positions[0];
+		for (const glm::vec3& position : positions)
+		{
+			allMin = glm::min(allMin, position);
+			allMax = glm::max(allMax, position);
+		}
+
+		for (int j = 0; j < targetVerts.size(); j++)
+		{
+			glm::vec3 position = targetVerts[j].Position;
+			if (sqrtf(BoxDistance(position, allMin, allMax)) >= target.falloff)
+				continue;
+			float nearest = sourceGrid.NearestSquared(position, target.falloff, allMin, allMax, [&](int k)
+			{
+				glm::vec3 offset = positions[k] - position;
+				return glm::dot(offset, offset);
+			});
+			float distance = sqrtf(nearest);
+			if (distance < target.falloff)
+				found(j, distance);
 		}
 	}
+
+	//Squared distance from a point to a box, never more than the one to any point inside it
+	static float BoxDistance(glm::vec3 point, glm::vec3 min, glm::vec3 max)
+	{
+		glm::vec3 offset = glm::max(glm::max(min - point, point - max), glm::vec3(0.0f));
+		return glm::dot(offset, offset);
+	}
+
 	bool collision = false; //is there going to be a collision? (has any ray hit the target?
 	bool isColliding = false; //is it colliding right now?
 	bool hasProcessed = false; //has the model been processed
@@ -250,7 +570,13 @@ private:
 	std::vector<glm::vec3> optimizedVerts;
 	std::vector<std::pair<int, float>> affectedVertices;
 	std::vector<std::pair<glm::vec3, float>> hitPoints; //keeps track of hitpoints and their distances from the projectile
+	glm::vec3 rayPlaneU, rayPlaneV; //plane perpendicular to the rays, see SetupRayPlane
+	std::vector<int> collidedVerts; //target vertices that reached the projectile this step
+	std::set<int> affectedVerts; //target vertices hit so far, StepLikeOctree dents them
+	float timeOfImpact = -1.0f; //earliest contact in the last step, as a fraction of the step (-1 if none)
+	float contactRemainder = 0.0f; //share of the last step left over after it stopped at first contact, added to the next one
 	Shader rayShader;
+	DebugLines rayLines; //all of the rays go out in one draw
 };
 
 
@@ -270,7 +596,7 @@ public:
 		rayShader("../OpenGL_DeformProj/ray.vert", "../OpenGL_DeformProj/ray.frag"), rayDirection(acceleration)
 	{
 		speed = acceleration;
-		std::cout << "Successfuly constructed point projectile\n";
+		LOG_INFO("Successfully constructed point projectile");
 	}
 
 	//Casts a single ray on a given triangle of a target (transformed using a model matrix)
@@ -283,9 +609,9 @@ public:
 		bool rayResult = RayUtil::MTRayCheck(vert0, vert1, vert2, projectilePosition, glm::normalize(rayDirection), hitDistance);
 		if (rayResult)
 		{
-			std::cout << "ray hit at " << indexv0 << " " << indexv1 << " " << indexv2 << 
-				"\n accel: " << acceleration.x << acceleration.y << acceleration.z <<
-				"\n speed: " << speed.x << speed.y << speed.z << "\n";
+			LOG_TRACE("ray hit at " << indexv0 << " " << indexv1 << " " << indexv2 <<
+				", accel: " << acceleration.x << " " << acceleration.y << " " << acceleration.z <<
+				", speed: " << speed.x << " " << speed.y << " " << speed.z);
 			return true;
 		}
 		return false;
@@ -301,8 +627,8 @@ public:
 			if (rayResult) //If we get a collision, push the vertices into those that need to be deformed
 			{
 				hitPoint = projectilePosition + hitDistance * glm::normalize(rayDirection);
-				std::cout << "hit distance: " << hitDistance << "\nhitpoint: x: " << hitPoint.x << " y: " << hitPoint.y << " z: " << hitPoint.z << "\n";
-				std::cout << "pushed " << i << " " << i + 1 << " " << i + 2 << " indices\n";
+				LOG_TRACE("hit distance: " << hitDistance << ", hitpoint: x: " << hitPoint.x << " y: " << hitPoint.y << " z: " << hitPoint.z <<
+					", pushed " << i << " " << i + 1 << " " << i + 2 << " indices");
 				collision = true;
 			}
 		}
@@ -360,7 +686,7 @@ public:
 			{
 				isColliding = true;
 				acceleration = -rayDirection; //reverse acceleration direction on hit (start slowing down)
-				std::cout << "we hit the mesh\n";
+				LOG_DEBUG("we hit the mesh");
 			}
 			if (isColliding)
 			{
@@ -12,32 +12,18 @@
 
 #include<iostream>
 #include<string>
+#include<cfloat>
 #include "shader.h"
+#include "debugLines.h"
 
 namespace RayUtil
 {
+	//Render a single ray (debug purposes), for many of them add them to a DebugLines batch and flush it once
 	void renderRay(glm::vec3 rayOrigin, glm::vec3 rayDir, glm::mat4 view, glm::mat4 model, glm::mat4 projection, Shader& shader)
 	{
-		//Render the ray (debug purposes)
-		glm::vec3 vertices[] = { rayOrigin, rayOrigin + rayDir };
-		unsigned int VAO, VBO;
-		glGenBuffers(1, &VBO);
-		glGenVertexArrays(1, &VAO);
-
-		glBindVertexArray(VAO);
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0); //position vertex attribute
-		glEnableVertexAttribArray(0);
-
-		shader.use();
-		shader.setMat4("model", model);
-		shader.setMat4("view", view);
-		shader.setMat4("projection", projection);
-		glDrawArrays(GL_LINES, 0, 2);
-
-		glBindVertexArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		static DebugLines lines; //reused by every call instead of a new VAO/VBO each time
+		lines.AddRay(rayOrigin, rayDir, model);
+		lines.Flush(shader, view, projection);
 	}
 
 	//Simple unoptimized ray checking algorithm
@@ -122,6 +108,92 @@ namespace RayUtil
 
 		return true;
 	}
+
+	//Two sided Moller-Trumbore variant, tests against corner + u * edge1 + v * edge2
+	//With isParallelogram u and v each go from 0 to 1, otherwise it's the triangle (u + v <= 1)
+	bool MTRayCheckTwoSided(glm::vec3 corner, glm::vec3 edge1, glm::vec3 edge2, glm::vec3 rayOrigin, glm::vec3 rayDir, bool isParallelogram, float& t)
+	{
+		glm::vec3 pvec = glm::cross(rayDir, edge2);
+		float det = glm::dot(edge1, pvec);
+
+		//no backface culling here, only parallel rays are rejected
+		if (fabs(det) < __EPSILON)
+			return false;
+
+		float invDet = 1 / det;
+
+		glm::vec3 tvec = rayOrigin - corner;
+		float u = glm::dot(tvec, pvec) * invDet;
+		if (u < 0 || u > 1)
+			return false;
+
+		glm::vec3 qvec = glm::cross(tvec, edge1);
+		float v = glm::dot(rayDir, qvec) * invDet;
+		if (v < 0 || (isParallelogram ? v > 1 : u + v > 1))
+			return false;
+
+		t = glm::dot(edge2, qvec) * invDet;
+		if (t < 0)
+			return false;
+
+		return true;
+	}
+
+	//Continuous collision between triangle a0a1a2 moving by displacement and the static triangle b0b1b2
+	//Covers vertex-face, face-vertex and edge-edge contacts of a pure translation
+	//toi is the earliest time of impact as a fraction of displacement (0 to 1), contactPoint lies on b0b1b2
+	bool SweptTriangleCheck(glm::vec3 a0, glm::vec3 a1, glm::vec3 a2, glm::vec3 b0, glm::vec3 b1, glm::vec3 b2,
+		glm::vec3 displacement, float& toi, glm::vec3& contactPoint)
+	{
+		glm::vec3 a[3] = { a0, a1, a2 };
+		glm::vec3 b[3] = { b0, b1, b2 };
+		bool hit = false;
+		float t;
+		toi = FLT_MAX;
+
+		for (int i = 0; i < 3; i++)
+		{
+			//vertices of a travelling into b
+			if (MTRayCheckTwoSided(b0, b1 - b0, b2 - b0, a[i], displacement, false, t) && t <= 1.0f && t < toi)
+			{
+				toi = t;
+				contactPoint = a[i] + t * displacement;
+				hit = true;
+			}
+			//vertices of b met by a (a stands still, b moves the opposite way)
+			if (MTRayCheckTwoSided(a0, a1 - a0, a2 - a0, b[i], -displacement, false, t) && t <= 1.0f && t < toi)
+			{
+				toi = t;
+				contactPoint = b[i];
+				hit = true;
+			}
+		}
+
+		//edge pairs, a's edge p0 + s * ep sweeping over b's edge q0 + u * eq:
+		//t * displacement = (q0 - p0) + u * eq - s * ep, which is a ray from the origin hitting a parallelogram
+		for (int i = 0; i < 3; i++)
+		{
+			glm::vec3 p0 = a[i];
+			glm::vec3 ep = a[(i + 1) % 3] - p0;
+			for (int j = 0; j < 3; j++)
+			{
+				glm::vec3 q0 = b[j];
+				glm::vec3 eq = b[(j + 1) % 3] - q0;
+				if (MTRayCheckTwoSided(q0 - p0, eq, -ep, glm::vec3(0.0f), displacement, true, t) && t <= 1.0f && t < toi)
+				{
+					//recover where on b's edge the contact happened
+					glm::vec3 moved = p0 + t * displacement;
+					glm::vec3 n = glm::cross(eq, ep); //can't be 0, parallel edges make a degenerate parallelogram that never gets hit
+					float u = glm::dot(glm::cross(moved - q0, ep), n) / glm::dot(n, n);
+					toi = t;
+					contactPoint = q0 + glm::clamp(u, 0.0f, 1.0f) * eq;
+					hit = true;
+				}
+			}
+		}
+
+		return hit;
+	}
 }
 
 
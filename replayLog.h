@@ -0,0 +1,372 @@
+#ifndef REPLAY_LOG_H
+#define REPLAY_LOG_H
+//-------------------------------------------------------------------------------------
+// Everything an impact simulation depends on, recorded so the run can be replayed
+// headless (benchmarks/impactReplay.cpp) and come out bit for bit the same.
+// The simulation steps at a fixed size on its own thread, so the frame rate and the
+// key presses (which only start it, or move the debug point projectile) never reach it.
+// What does reach it: the models and the target/projectile parameters, which make up
+// the setup. The surface relaxation runs a fixed number of iterations a step, unless
+// it's given a time budget, then it depends on how busy the machine was. Every step
+// records how many iterations it ran, plus a hash of the vertices it moved and where
+// the projectile got, so a replay can tell the first step it went different at.
+// The log is a small binary file: a header, the setup and 10 bytes per step, all values
+// as they are in memory (little endian, every platform this builds on).
+//-------------------------------------------------------------------------------------
+
+#include<glm\glm.hpp>
+
+#include<string>
+#include<vector>
+#include<fstream>
+#include<stdint.h>
+#include "mesh.h"
+#include "optimalTarget.h"
+#include "optimalProjectile.h"
+#include "surfaceRelaxation.h"
+#include "chunkedTarget.h"
+#include "logger.h"
+
+//FNV-1a, over the raw bytes, so any bit that differs changes it
+inline uint64_t HashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+//Hash of the positions and triangles of a mesh, to check a replay starts from the same geometry
+inline uint64_t HashGeometry(const Mesh& mesh)
+{
+	uint64_t hash = HashBytes(nullptr, 0);
+	for (const Vertex& vertex : mesh.vertices)
+		hash = HashBytes(&vertex.Position, sizeof(glm::vec3), hash);
+	if (!mesh.indices.empty())
+		hash = HashBytes(&mesh.indices[0], mesh.indices.size() * sizeof(unsigned int), hash);
+	return hash;
+}
+
+//How the app sets up an impact, main.cpp builds its scene from one of these and the replay builds the same one
+struct ImpactSetup
+{
+	std::string targetPath;
+	std::string projectilePath;
+	//out of core mode (see chunkedTarget.h) if set, the chunk file gets built from targetPath if it isn't there yet
+	std::string chunkedTargetPath;
+	int chunkDepth = 5;
+	uint64_t residentBudget = 256ull << 20; //bytes of target geometry in the window, loading fails if the projectile can reach more
+	float falloff = 0.5f;
+	float roughness = 3.0f;
+	float threshold = 1.0f; //yield strength of every vertex, unless the material map gives them their own
+	float stiffness = 1.0f;
+	float hardening = 0.0f;
+	//optional per vertex material, a text file with a "yield stiffness" line for every target vertex, in the order
+	//the whole target loads in (not out of core) before refinement
+	std::string materialMapPath;
+	glm::vec3 acceleration = glm::vec3(0.0f, -0.03f, 0.0f);
+	double stepSize = 0.0167;
+	int treeMaxVerts = 3, treeMaxTris = 3, treeDepth = 3; //both octrees
+	//refinement around the predicted impact (see meshRefinement.h), the radius grows by the falloff
+	bool refine = true;
+	float refineEdgeShare = 0.1f; //longest edge left in the refined region, a share of the falloff
+	int refineMaxTriangles = 200000;
+	bool collisionMirror = true; //the target tree's quantised copy of the positions (see collisionMirror.h)
+	RelaxationSettings relaxSettings;
+
+	//What the setup came out as when it was recorded, checked before replaying
+	glm::vec3 rayDirection = glm::vec3(0.0f);
+	uint64_t targetHash = 0; //after refinement
+	uint64_t projectileHash = 0;
+	uint64_t materialHash = 0; //yield strength and stiffness of every vertex, after refinement
+	int targetVertices = 0, targetTriangles = 0;
+
+	//Loads the target, whole or in out of core mode only the chunks the projectile can reach
+	//Returns an empty model (no meshes) if it can't be loaded
+	Model TargetModel(ChunkedTarget& chunked, const OctreeProjectile& projectile, bool createBuffers) const
+	{
+		if (chunkedTargetPath.empty())
+			return Model(targetPath, true, false, createBuffers);
+		if (!chunked.IsOpen() && !chunked.Open(chunkedTargetPath))
+		{
+			LOG_INFO("No chunk file at " << chunkedTargetPath << ", building it from " << targetPath);
+			Model whole(targetPath, true, false, false);
+			if (whole.meshes.empty() || !ChunkedTarget::Build(whole, chunkedTargetPath, chunkDepth) || !chunked.Open(chunkedTargetPath))
+				return Model(std::vector<Mesh>());
+		}
+		//no further than it gets after its first hit, or the whole path if it misses
+		float contact, reach = FLT_MAX;
+		if (chunked.FirstHit(projectile.projectileMesh.meshes[0], projectile.rayDirection, contact))
+			reach = projectile.MaxTravel(contact, (float)stepSize);
+		//hits spread the falloff from points that can sit up to about a falloff off the path themselves
+		return chunked.LoadWindow(projectile.boundingBoxCenter, projectile.boundingBoxSize * 0.5f, projectile.rayDirection, 2.0f * falloff, reach,
+			residentBudget, createBuffers);
+	}
+
+	//Gives the target its yield strength, stiffness and hardening, per vertex if there's a material map
+	//Call it before PrepareTarget, so refinement carries the material over to the vertices it adds
+	//Returns false if the map can't be read or doesn't fit the target, which then has the uniform material
+	bool ApplyMaterial(OctreeTarget& target) const
+	{
+		target.materialState.hardening = hardening;
+		target.SetMaterial(threshold, stiffness);
+		if (materialMapPath.empty())
+			return true;
+		std::ifstream in(materialMapPath);
+		if (!in)
+		{
+			LOG_ERROR("Couldn't open the material map " << materialMapPath);
+			return false;
+		}
+		std::vector<float> yield, vertexStiffness;
+		float vertexYield, vertexStiff;
+		while (in >> vertexYield >> vertexStiff)
+		{
+			yield.push_back(vertexYield);
+			vertexStiffness.push_back(vertexStiff);
+		}
+		if (!in.eof())
+		{
+			LOG_ERROR("The material map " << materialMapPath << " has a line that isn't a yield strength and a stiffness");
+			return false;
+		}
+		if (!target.SetMaterial(yield, vertexStiffness))
+		{
+			LOG_ERROR("The material map " << materialMapPath << " has " << yield.size() << " vertices, the target "
+				<< target.targetModel.meshes[0].vertices.size());
+			return false;
+		}
+		return true;
+	}
+
+	//Refines the target and packs its collision mirror like the app does, before the trees are used for anything else
+	void PrepareTarget(OctreeTarget& target, OctreeProjectile& projectile, Octree& targetTree) const
+	{
+		glm::vec3 impactCenter;
+		float impactRadius;
+		if (refine && projectile.PredictImpact(targetTree, impactCenter, impactRadius))
+			target.RefineAround(targetTree, impactCenter, impactRadius + falloff, falloff * refineEdgeShare, refineMaxTriangles);
+		if (collisionMirror)
+			targetTree.BuildCollisionMirror();
+		projectile.SetupRelaxation(target.targetModel.meshes[0]);
+	}
+
+	//Takes the validation values from a scene set up from this
+	void Capture(const OctreeTarget& target, const OctreeProjectile& projectile)
+	{
+		const Mesh& targetMesh = target.targetModel.meshes[0];
+		rayDirection = projectile.rayDirection;
+		targetHash = HashGeometry(targetMesh);
+		projectileHash = HashGeometry(projectile.projectileMesh.meshes[0]);
+		const MaterialState& material = target.materialState;
+		materialHash = HashBytes(material.yieldStrength.data(), material.yieldStrength.size() * sizeof(float));
+		materialHash = HashBytes(material.stiffness.data(), material.stiffness.size() * sizeof(float), materialHash);
+		targetVertices = (int)targetMesh.vertices.size();
+		targetTriangles = (int)targetMesh.indices.size() / 3;
+	}
+};
+
+//One simulation step
+struct ReplayStep
+{
+	uint16_t relaxIterations; //what ran while recording, maxIterations unless a time budget cut it short
+	uint64_t hash; //of the moved vertices and the projectile state after the step
+};
+
+class ImpactLog
+{
+public:
+	ImpactSetup setup;
+	std::vector<ReplayStep> steps;
+
+	//Hash of what a step changed: the positions of the vertices it moved, how far the projectile got and its last step
+	static uint64_t StepHash(const OctreeProjectile& projectile, const OctreeTarget& target)
+	{
+		const std::vector<Vertex>& vertices = target.targetModel.meshes[0].vertices;
+		uint64_t hash = HashBytes(nullptr, 0);
+		for (int vert : projectile.MovedVerts())
+		{
+			hash = HashBytes(&vert, sizeof(int), hash);
+			hash = HashBytes(&vertices[vert].Position, sizeof(glm::vec3), hash);
+		}
+		hash = HashBytes(&projectile.travelled, sizeof(glm::vec3), hash);
+		hash = HashBytes(&projectile.lastStep, sizeof(glm::vec3), hash);
+		return HashBytes(&projectile.isDone, sizeof(bool), hash);
+	}
+
+	//Called by the simulation after every step
+	void RecordStep(const OctreeProjectile& projectile, const OctreeTarget& target)
+	{
+		steps.push_back(ReplayStep{ (uint16_t)projectile.lastRelaxIterations, StepHash(projectile, target) });
+	}
+
+	bool Write(const std::string& path) const
+	{
+		std::ofstream out(path, std::ios::binary);
+		if (!out)
+		{
+			LOG_ERROR("Couldn't open " << path << " for writing the replay log");
+			return false;
+		}
+		uint32_t fileVersion = version;
+		out.write(magic, 4);
+		Put(out, fileVersion);
+		PutString(out, setup.targetPath);
+		PutString(out, setup.projectilePath);
+		PutString(out, setup.chunkedTargetPath);
+		Put(out, setup.chunkDepth);
+		Put(out, setup.residentBudget);
+		Put(out, setup.falloff);
+		Put(out, setup.roughness);
+		Put(out, setup.threshold);
+		Put(out, setup.stiffness);
+		Put(out, setup.hardening);
+		PutString(out, setup.materialMapPath);
+		Put(out, setup.acceleration);
+		Put(out, setup.stepSize);
+		Put(out, setup.treeMaxVerts);
+		Put(out, setup.treeMaxTris);
+		Put(out, setup.treeDepth);
+		Put(out, setup.refine);
+		Put(out, setup.refineEdgeShare);
+		Put(out, setup.refineMaxTriangles);
+		Put(out, setup.collisionMirror);
+		Put(out, setup.relaxSettings.enabled);
+		Put(out, setup.relaxSettings.rings);
+		Put(out, setup.relaxSettings.maxIterations);
+		Put(out, setup.relaxSettings.timeBudget);
+		Put(out, setup.relaxSettings.maxStretch);
+		Put(out, setup.relaxSettings.stiffness);
+		Put(out, setup.relaxSettings.pinShare);
+		Put(out, setup.rayDirection);
+		Put(out, setup.targetHash);
+		Put(out, setup.projectileHash);
+		Put(out, setup.materialHash);
+		Put(out, setup.targetVertices);
+		Put(out, setup.targetTriangles);
+		uint32_t stepCount = (uint32_t)steps.size();
+		Put(out, stepCount);
+		for (const ReplayStep& step : steps)
+		{
+			Put(out, step.relaxIterations);
+			Put(out, step.hash);
+		}
+		if (!out)
+		{
+			LOG_ERROR("Writing the replay log " << path << " failed");
+			return false;
+		}
+		LOG_INFO("Replay log written to " << path << ": " << steps.size() << " steps");
+		return true;
+	}
+
+	bool Read(const std::string& path)
+	{
+		std::ifstream in(path, std::ios::binary);
+		if (!in)
+		{
+			LOG_ERROR("Couldn't open the replay log " << path);
+			return false;
+		}
+		char fileMagic[4] = {};
+		uint32_t fileVersion = 0;
+		in.read(fileMagic, 4);
+		Get(in, fileVersion);
+		if (!in || std::string(fileMagic, 4) != std::string(magic, 4) || fileVersion != version)
+		{
+			LOG_ERROR(path << " isn't a replay log of this version");
+			return false;
+		}
+		GetString(in, setup.targetPath);
+		GetString(in, setup.projectilePath);
+		GetString(in, setup.chunkedTargetPath);
+		Get(in, setup.chunkDepth);
+		Get(in, setup.residentBudget);
+		Get(in, setup.falloff);
+		Get(in, setup.roughness);
+		Get(in, setup.threshold);
+		Get(in, setup.stiffness);
+		Get(in, setup.hardening);
+		GetString(in, setup.materialMapPath);
+		Get(in, setup.acceleration);
+		Get(in, setup.stepSize);
+		Get(in, setup.treeMaxVerts);
+		Get(in, setup.treeMaxTris);
+		Get(in, setup.treeDepth);
+		Get(in, setup.refine);
+		Get(in, setup.refineEdgeShare);
+		Get(in, setup.refineMaxTriangles);
+		Get(in, setup.collisionMirror);
+		Get(in, setup.relaxSettings.enabled);
+		Get(in, setup.relaxSettings.rings);
+		Get(in, setup.relaxSettings.maxIterations);
+		Get(in, setup.relaxSettings.timeBudget);
+		Get(in, setup.relaxSettings.maxStretch);
+		Get(in, setup.relaxSettings.stiffness);
+		Get(in, setup.relaxSettings.pinShare);
+		Get(in, setup.rayDirection);
+		Get(in, setup.targetHash);
+		Get(in, setup.projectileHash);
+		Get(in, setup.materialHash);
+		Get(in, setup.targetVertices);
+		Get(in, setup.targetTriangles);
+		uint32_t stepCount = 0;
+		Get(in, stepCount);
+		steps.clear();
+		for (uint32_t i = 0; i < stepCount && in; i++)
+		{
+			ReplayStep step;
+			Get(in, step.relaxIterations);
+			Get(in, step.hash);
+			steps.push_back(step);
+		}
+		if (!in)
+		{
+			LOG_ERROR("The replay log " << path << " is cut short");
+			return false;
+		}
+		return true;
+	}
+
+private:
+	static constexpr const char* magic = "DIRL";
+	static const uint32_t version = 4;
+
+	template<typename T>
+	static void Put(std::ostream& out, const T& value)
+	{
+		out.write((const char*)&value, sizeof(T));
+	}
+
+	template<typename T>
+	static void Get(std::istream& in, T& value)
+	{
+		in.read((char*)&value, sizeof(T));
+	}
+
+	static void PutString(std::ostream& out, const std::string& value)
+	{
+		uint32_t length = (uint32_t)value.size();
+		Put(out, length);
+		out.write(value.data(), length);
+	}
+
+	static void GetString(std::istream& in, std::string& value)
+	{
+		uint32_t length = 0;
+		Get(in, length);
+		if (!in || length > (1u << 16)) //paths, anything longer is a broken file
+		{
+			in.setstate(std::ios::failbit);
+			return;
+		}
+		value.resize(length);
+		if (length > 0)
+			in.read(&value[0], length);
+	}
+};
+
+#endif
@@ -7,11 +7,20 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <unordered_map>
+#include "logger.h"
+#include "uniformBlocks.h"
 
 class Shader
 {
 public:
 	unsigned int ID;
+	// empty shader, for objects that never render (headless runs), nothing is compiled
+	// ------------------------------------------------------------------------
+	Shader() : ID(0)
+	{
+	}
 	// constructor generates the shader on the fly
 	// ------------------------------------------------------------------------
 	Shader(const char* vertexPath, const char* fragmentPath)
@@ -42,7 +51,7 @@ public:
 		}
 		catch (std::ifstream::failure e)
 		{
-			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+			LOG_ERROR("ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ");
 		}
 		const char* vShaderCode = vertexCode.c_str();
 		const char * fShaderCode = fragmentCode.c_str();
@@ -64,6 +73,8 @@ public:
 		glAttachShader(ID, fragment);
 		glLinkProgram(ID);
 		checkCompileErrors(ID, "PROGRAM");
+		cacheUniformLocations();
+		bindUniformBlocks();
 		// delete the shaders as they're linked into our program now and no longer necessary
 		glDeleteShader(vertex);
 		glDeleteShader(fragment);
@@ -78,59 +89,75 @@ public:
 	// ------------------------------------------------------------------------
 	void setBool(const std::string &name, bool value) const
 	{
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+		glUniform1i(location(name), (int)value);
 	}
 	// ------------------------------------------------------------------------
 	void setInt(const std::string &name, int value) const
 	{
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+		setInt(location(name), value);
+	}
+	void setInt(GLint location, int value) const
+	{
+		glUniform1i(location, value);
 	}
 	// ------------------------------------------------------------------------
 	void setFloat(const std::string &name, float value) const
 	{
-		glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+		setFloat(location(name), value);
+	}
+	void setFloat(GLint location, float value) const
+	{
+		glUniform1f(location, value);
 	}
 	// ------------------------------------------------------------------------
 	void setVec2(const std::string &name, const glm::vec2 &value) const
 	{
-		glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+		glUniform2fv(location(name), 1, &value[0]);
 	}
 	void setVec2(const std::string &name, float x, float y) const
 	{
-		glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+		glUniform2f(location(name), x, y);
 	}
 	// ------------------------------------------------------------------------
 	void setVec3(const std::string &name, const glm::vec3 &value) const
 	{
-		glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+		setVec3(location(name), value);
+	}
+	void setVec3(GLint location, const glm::vec3 &value) const
+	{
+		glUniform3fv(location, 1, &value[0]);
 	}
 	void setVec3(const std::string &name, float x, float y, float z) const
 	{
-		glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+		glUniform3f(location(name), x, y, z);
 	}
 	// ------------------------------------------------------------------------
 	void setVec4(const std::string &name, const glm::vec4 &value) const
 	{
-		glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+		glUniform4fv(location(name), 1, &value[0]);
 	}
 	void setVec4(const std::string &name, float x, float y, float z, float w) const
 	{
-		glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+		glUniform4f(location(name), x, y, z, w);
 	}
 	// ------------------------------------------------------------------------
 	void setMat2(const std::string &name, const glm::mat2 &mat) const
 	{
-		glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		glUniformMatrix2fv(location(name), 1, GL_FALSE, &mat[0][0]);
 	}
 	// ------------------------------------------------------------------------
 	void setMat3(const std::string &name, const glm::mat3 &mat) const
 	{
-		glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		glUniformMatrix3fv(location(name), 1, GL_FALSE, &mat[0][0]);
 	}
 	// ------------------------------------------------------------------------
 	void setMat4(const std::string &name, const glm::mat4 &mat) const
 	{
-		glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		setMat4(location(name), mat);
+	}
+	void setMat4(GLint location, const glm::mat4 &mat) const
+	{
+		glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
 	}
 	// ------------------------------------------------------------------------
 	void setPointLight(const std::string& name, glm::vec3 pos, glm::vec3 color, float linear, float quadratic)
@@ -175,7 +202,55 @@ public:
 		this->setVec3(name + ".specular", 0.5f, 0.5f, 0.5f);
 		this->setFloat(name + ".shininess", 32.0f);
 	}
+	// location of a uniform, -1 if the program doesn't have it (setting it is then a no-op, like in GL)
+	// ------------------------------------------------------------------------
+	GLint location(const std::string &name) const
+	{
+		auto found = uniformLocations.find(name);
+		if (found != uniformLocations.end())
+			return found->second;
+		//not among the active uniforms under this name, asked for once and remembered either way
+		GLint result = glGetUniformLocation(ID, name.c_str());
+		uniformLocations[name] = result;
+		return result;
+	}
 private:
+	// every active uniform's location, read once after linking so the setters never have to ask GL
+	// ------------------------------------------------------------------------
+	void cacheUniformLocations()
+	{
+		GLint count = 0, maxLength = 0;
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+		std::vector<GLchar> nameBuffer(maxLength + 1);
+		for (GLint i = 0; i < count; i++)
+		{
+			GLsizei length = 0;
+			GLint size = 0;
+			GLenum type = 0;
+			glGetActiveUniform(ID, (GLuint)i, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+			std::string name(nameBuffer.data(), length);
+			GLint uniformLocation = glGetUniformLocation(ID, name.c_str());
+			if (uniformLocation < 0) //members of uniform blocks are active uniforms too, without a location
+				continue;
+			uniformLocations[name] = uniformLocation;
+			//arrays of basic types are listed as "name[0]", they can be set by their plain name too
+			if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+				uniformLocations[name.substr(0, name.size() - 3)] = uniformLocation;
+		}
+	}
+	// points the shared uniform blocks the program declares at their buffers
+	// ------------------------------------------------------------------------
+	void bindUniformBlocks()
+	{
+		for (int binding = 0; binding < UniformBlocks::Count; binding++)
+		{
+			GLuint index = glGetUniformBlockIndex(ID, UniformBlocks::blockNames[binding]);
+			if (index != GL_INVALID_INDEX)
+				glUniformBlockBinding(ID, index, binding);
+		}
+	}
+	mutable std::unordered_map<std::string, GLint> uniformLocations;
 	// utility function for checking shader compilation/linking errors.
 	// ------------------------------------------------------------------------
 	void checkCompileErrors(unsigned int shader, std::string type)
@@ -188,7 +263,7 @@ private:
 			if (!success)
 			{
 				glGetShaderInfoLog(shader, 1024, NULL, infoLog);
-				std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+				LOG_ERROR("ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- ");
 			}
 		}
 		else
@@ -197,9 +272,35 @@ private:
 			if (!success)
 			{
 				glGetProgramInfoLog(shader, 1024, NULL, infoLog);
-				std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+				LOG_ERROR("ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- ");
 			}
 		}
 	}
 };
+
+// location of one uniform for the draw calls that set it every frame, looked up by name once per program
+// instead of hashing a std::string built from a literal on every call
+// ------------------------------------------------------------------------
+class UniformHandle
+{
+public:
+	explicit UniformHandle(const char* name) : name(name), program(0), cached(-1), resolved(false)
+	{
+	}
+	GLint get(const Shader& shader)
+	{
+		if (!resolved || shader.ID != program)
+		{
+			cached = shader.location(name);
+			program = shader.ID;
+			resolved = true;
+		}
+		return cached;
+	}
+private:
+	const char* name;
+	unsigned int program;
+	GLint cached;
+	bool resolved;
+};
 #endif
\ No newline at end of file
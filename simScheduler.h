@@ -0,0 +1,65 @@
+#ifndef SIM_SCHEDULER_H
+#define SIM_SCHEDULER_H
+//-------------------------------------------------------------------------------------
+// Fixed timestep scheduler, decouples the deformation simulation from the frame rate.
+// Real frame time goes into an accumulator, which is drained in whole simulation steps,
+// so the simulation always advances by the same step no matter how long a frame took.
+// The leftover time is used to interpolate between the last two simulated states.
+//-------------------------------------------------------------------------------------
+
+class SimScheduler
+{
+public:
+	//stepSize is the simulated time per step, maxSubsteps caps the steps taken in one frame,
+	//so a long stall doesn't snowball into even longer frames
+	SimScheduler(double stepSize, int maxSubsteps) : stepSize(stepSize), maxSubsteps(maxSubsteps)
+	{
+	}
+
+	//Adds the real time of a frame, returns how many simulation steps need to be run for it
+	int Advance(double frameTime)
+	{
+		accumulator += frameTime;
+		int steps = (int)(accumulator / stepSize);
+		if (steps > maxSubsteps)
+		{
+			//we can't keep up, drop the time we're not going to simulate instead of carrying it over
+			steps = maxSubsteps;
+			accumulator = steps * stepSize;
+		}
+		accumulator -= steps * stepSize;
+		stepCount += steps;
+		return steps;
+	}
+
+	//How far the render time is between the previous and the latest simulated state (0 to 1)
+	float Alpha() const
+	{
+		return (float)(accumulator / stepSize);
+	}
+
+	float StepSize() const
+	{
+		return (float)stepSize;
+	}
+
+	//Total simulation steps taken so far
+	unsigned long long StepCount() const
+	{
+		return stepCount;
+	}
+
+	void Reset()
+	{
+		accumulator = 0.0;
+		stepCount = 0;
+	}
+
+private:
+	double stepSize;
+	int maxSubsteps;
+	double accumulator = 0.0;
+	unsigned long long stepCount = 0;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,251 @@
+#ifndef SIM_THREAD_H
+#define SIM_THREAD_H
+//-------------------------------------------------------------------------------------
+// Runs the deformation simulation on its own thread, at a fixed step in real time.
+// After every batch of steps the target's vertex positions are published through a
+// triple buffer, the render thread picks up the latest one and uploads only the positions
+// of the vertices that moved since the last snapshot it took. The simulation never waits
+// on the renderer or the GPU.
+//-------------------------------------------------------------------------------------
+
+#include<glm\glm.hpp>
+
+#include<thread>
+#include<atomic>
+#include<chrono>
+#include<vector>
+#include<deque>
+#include<algorithm>
+#include<iterator>
+#include "optimalProjectile.h"
+#include "optimalTarget.h"
+#include "triangleOctree.h"
+#include "simScheduler.h"
+#include "tripleBuffer.h"
+#include "replayLog.h"
+#include "exportThread.h"
+#include "profiler.h"
+
+struct SimSnapshot
+{
+	std::vector<glm::vec3> targetPositions;
+	std::vector<int> movedVerts; //target vertices moved since the last snapshot the renderer took, sorted
+	glm::vec3 travelled = glm::vec3(0.0f); //projectile displacement since spawn
+	glm::vec3 lastStep = glm::vec3(0.0f); //projectile displacement of the latest step
+	unsigned long long sequence = 0; //publish counter
+	std::chrono::steady_clock::time_point publishTime;
+	bool isDone = false;
+};
+
+class SimThread
+{
+public:
+	//Everything passed in belongs to the simulation thread while it runs, only the GPU side of
+	//the meshes may still be used by the render thread
+	SimThread(OctreeProjectile& projectile, OctreeTarget& target, Octree& targetTree, Octree& projectileTree, double stepSize, int maxSubsteps) :
+		projectile(projectile), target(target), targetTree(targetTree), projectileTree(projectileTree),
+		stepSize(stepSize), maxSubsteps(maxSubsteps), snapshots(InitialSnapshot(target)),
+		movedStamp(target.targetModel.meshes[0].vertices.size(), 0)
+	{
+		worker = std::thread(&SimThread::Run, this);
+	}
+	~SimThread()
+	{
+		stopRequested = true;
+		worker.join();
+	}
+
+	//Starts stepping the simulation, real time counts from here, calls after the first one do nothing
+	void Start()
+	{
+		if (hasStarted)
+			return;
+		hasStarted = true;
+		running = true;
+	}
+
+	//Every step gets recorded into the log (see replayLog.h), set it before Start
+	//The log belongs to the simulation thread until the snapshot it publishes says it's done
+	void Record(ImpactLog* log)
+	{
+		replayLog = log;
+	}
+
+	//Every step gets captured into the exporter's displacement stream, set it before Start
+	void Export(ExportThread* exporter)
+	{
+		this->exporter = exporter;
+	}
+
+	bool IsRunning() const
+	{
+		return running;
+	}
+
+	//Render thread, takes the latest snapshot (if there's a new one) and uploads the positions it changed
+	//Returns the snapshot that should be drawn
+	const SimSnapshot& Consume(Mesh& targetMesh)
+	{
+		if (snapshots.Acquire())
+		{
+			const SimSnapshot& latest = snapshots.Front();
+			consumedSequence.store(latest.sequence, std::memory_order_release);
+			if (!latest.movedVerts.empty())
+			{
+				PROFILE_ZONE("GPU upload");
+				targetMesh.UpdateBufferPositions(latest.movedVerts, latest.targetPositions.data());
+			}
+		}
+		return snapshots.Front();
+	}
+
+	//Where to draw the projectile for the given snapshot, interpolated between its last two steps by the time since it was published
+	glm::vec3 RenderOffset(const SimSnapshot& snapshot)
+	{
+		if (snapshot.isDone)
+			return snapshot.travelled;
+		double sinceLatest = std::chrono::duration<double>(std::chrono::steady_clock::now() - snapshot.publishTime).count();
+		float alpha = (float)fmin(sinceLatest / stepSize, 1.0);
+		return snapshot.travelled - (1.0f - alpha) * snapshot.lastStep;
+	}
+
+private:
+	static SimSnapshot InitialSnapshot(OctreeTarget& target)
+	{
+		SimSnapshot snapshot;
+		const std::vector<Vertex>& vertices = target.targetModel.meshes[0].vertices;
+		snapshot.targetPositions.resize(vertices.size());
+		for (int i = 0; i < vertices.size(); i++)
+			snapshot.targetPositions[i] = vertices[i].Position;
+		snapshot.publishTime = std::chrono::steady_clock::now();
+		return snapshot;
+	}
+
+	void Run()
+	{
+		SimScheduler scheduler(stepSize, maxSubsteps);
+		std::chrono::steady_clock::time_point lastTime = std::chrono::steady_clock::now();
+		while (!stopRequested)
+		{
+			if (!running)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				lastTime = std::chrono::steady_clock::now();
+				continue;
+			}
+
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			int steps = scheduler.Advance(std::chrono::duration<double>(now - lastTime).count());
+			lastTime = now;
+
+			for (int i = 0; i < steps && !projectile.isDone; i++)
+			{
+				projectile.Update(targetTree, projectileTree, target, scheduler.StepSize(), glm::mat4(1.0f));
+				CollectMoved();
+				if (replayLog)
+					replayLog->RecordStep(projectile, target);
+				if (exporter)
+					exporter->CaptureFrame(target.targetModel.meshes[0].vertices, projectile.MovedVerts());
+			}
+			if (steps > 0)
+				PublishSnapshot();
+			if (projectile.isDone)
+			{
+				running = false;
+				continue;
+			}
+
+			//sleep until the next step is due
+			double untilNextStep = (1.0 - scheduler.Alpha()) * stepSize;
+			std::this_thread::sleep_for(std::chrono::duration<double>(untilNextStep));
+		}
+	}
+
+	//Adds the vertices the latest step moved to the ones the next snapshot publishes, each of them once
+	void CollectMoved()
+	{
+		for (int vert : projectile.MovedVerts())
+		{
+			if (movedStamp[vert] == publishedSequence + 1)
+				continue;
+			movedStamp[vert] = publishedSequence + 1;
+			movedSincePublish.push_back(vert);
+		}
+	}
+
+	//Merges the sorted verts into the sorted into, leaving out the ones it already has
+	void MergeMoved(std::vector<int>& into, const std::vector<int>& verts)
+	{
+		mergeScratch.clear();
+		std::set_union(into.begin(), into.end(), verts.begin(), verts.end(), std::back_inserter(mergeScratch));
+		into.swap(mergeScratch);
+	}
+
+	void PublishSnapshot()
+	{
+		PROFILE_ZONE("publish snapshot");
+		publishedSequence++;
+		if (!movedSincePublish.empty())
+		{
+			std::sort(movedSincePublish.begin(), movedSincePublish.end());
+			for (int i = 0; i < 3; i++) //every buffer has to catch up on these vertices once
+				MergeMoved(pendingVerts[i], movedSincePublish);
+			movedHistory.push_back(MovedBatch{ publishedSequence, std::vector<int>() });
+			movedHistory.back().verts.swap(movedSincePublish);
+		}
+
+		//forget batches the renderer has already uploaded
+		unsigned long long consumed = consumedSequence.load(std::memory_order_acquire);
+		while (!movedHistory.empty() && movedHistory.front().sequence <= consumed)
+			movedHistory.pop_front();
+
+		int backIndex = snapshots.BackIndex();
+		SimSnapshot& snapshot = snapshots.Back();
+		const std::vector<Vertex>& vertices = target.targetModel.meshes[0].vertices;
+		for (int vert : pendingVerts[backIndex])
+			snapshot.targetPositions[vert] = vertices[vert].Position;
+		pendingVerts[backIndex].clear();
+
+		//everything moved since the last snapshot the renderer took, in case it skips some
+		snapshot.movedVerts.clear();
+		for (const MovedBatch& batch : movedHistory)
+			MergeMoved(snapshot.movedVerts, batch.verts);
+		snapshot.travelled = projectile.travelled;
+		snapshot.lastStep = projectile.lastStep;
+		snapshot.sequence = publishedSequence;
+		snapshot.publishTime = std::chrono::steady_clock::now();
+		snapshot.isDone = projectile.isDone;
+		snapshots.Publish();
+	}
+
+	struct MovedBatch
+	{
+		unsigned long long sequence;
+		std::vector<int> verts; //sorted
+	};
+
+	OctreeProjectile& projectile;
+	OctreeTarget& target;
+	Octree& targetTree;
+	Octree& projectileTree;
+	double stepSize;
+	int maxSubsteps;
+	ImpactLog* replayLog = nullptr;
+	ExportThread* exporter = nullptr;
+
+	TripleBuffer<SimSnapshot> snapshots;
+	std::vector<unsigned long long> movedStamp; //per target vertex, the sequence of the snapshot it's going out with
+	std::vector<int> movedSincePublish; //vertices moved since the last snapshot was published, each once
+	std::vector<int> pendingVerts[3]; //per buffer, sorted vertices it's missing since it was last filled
+	std::deque<MovedBatch> movedHistory; //published vertices the renderer may not have seen yet
+	std::vector<int> mergeScratch;
+	unsigned long long publishedSequence = 0;
+	std::atomic<unsigned long long> consumedSequence{ 0 };
+
+	bool hasStarted = false;
+	std::atomic<bool> running{ false };
+	std::atomic<bool> stopRequested{ false };
+	std::thread worker;
+};
+
+#endif
\ No newline at end of file
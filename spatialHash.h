@@ -0,0 +1,207 @@
+#ifndef SPATIAL_HASH_H
+#define SPATIAL_HASH_H
+//-------------------------------------------------------------------------------------
+// Uniform grid over an unbounded space, stored as a hash table of cells. Items are
+// boxes (or points), each one goes into every cell its box touches. Built in one go,
+// counting sort style: the entries of every bucket sit next to each other in one array,
+// in increasing item order. Cells that hash to the same bucket share it, so queries
+// return a superset of the items in the cells (and items spanning several cells can
+// come up more than once), callers do the exact test themselves.
+//-------------------------------------------------------------------------------------
+
+#include<glm\glm.hpp>
+
+#include<vector>
+#include<algorithm>
+#include<stdlib.h>
+#include<math.h>
+#include<float.h>
+
+class SpatialHash
+{
+public:
+	SpatialHash() : cellSize(1.0f), inverseCellSize(1.0f), bucketMask(0)
+	{
+	}
+
+	//Puts item i into every cell the box from mins[i] to maxs[i] touches
+	void Build(const std::vector<glm::vec3>& mins, const std::vector<glm::vec3>& maxs, float cellSize)
+	{
+		this->cellSize = cellSize;
+		inverseCellSize = 1.0f / cellSize;
+
+		size_t entryCount = 0;
+		for (size_t i = 0; i < mins.size(); i++)
+		{
+			glm::ivec3 extent = Cell(maxs[i]) - Cell(mins[i]) + glm::ivec3(1);
+			entryCount += (size_t)extent.x * extent.y * extent.z;
+		}
+		size_t bucketCount = 16;
+		while (bucketCount < entryCount * 2)
+			bucketCount *= 2;
+		bucketMask = bucketCount - 1;
+
+		//count the entries of every bucket, then turn the counts into where each bucket starts
+		bucketStart.assign(bucketCount + 1, 0);
+		for (size_t i = 0; i < mins.size(); i++)
+			ForEachCell(mins[i], maxs[i], [this](glm::ivec3 cell) { bucketStart[Bucket(cell) + 1]++; });
+		for (size_t b = 0; b < bucketCount; b++)
+			bucketStart[b + 1] += bucketStart[b];
+
+		entries.resize(entryCount);
+		bucketMin.assign(bucketCount, glm::vec3(FLT_MAX));
+		bucketMax.assign(bucketCount, glm::vec3(-FLT_MAX));
+		std::vector<int> fill(bucketStart.begin(), bucketStart.end() - 1);
+		for (size_t i = 0; i < mins.size(); i++)
+		{
+			ForEachCell(mins[i], maxs[i], [&](glm::ivec3 cell)
+			{
+				size_t bucket = Bucket(cell);
+				entries[fill[bucket]++] = (int)i;
+				bucketMin[bucket] = glm::min(bucketMin[bucket], mins[i]);
+				bucketMax[bucket] = glm::max(bucketMax[bucket], maxs[i]);
+			});
+		}
+	}
+
+	//Points are boxes of no size, every one goes into a single cell
+	void Build(const std::vector<glm::vec3>& points, float cellSize)
+	{
+		Build(points, points, cellSize);
+	}
+
+	//Calls visit(item) for every item in the buckets of the cells the box touches, within a cell in increasing order
+	template<typename Visitor>
+	void Query(glm::vec3 min, glm::vec3 max, Visitor visit) const
+	{
+		if (entries.empty())
+			return;
+		ForEachCell(min, max, [&](glm::ivec3 cell)
+		{
+			size_t bucket = Bucket(cell);
+			for (int e = bucketStart[bucket]; e < bucketStart[bucket + 1]; e++)
+				visit(entries[e]);
+		});
+	}
+
+	template<typename Visitor>
+	void Query(glm::vec3 point, Visitor visit) const
+	{
+		Query(point, point, visit);
+	}
+
+	//Smallest squared distance to the point over the items within radius of it, FLT_MAX if there are none. distance(item)
+	//gives an item's squared distance (never less than the one to its box), min and max bound all of the items. Goes
+	//through the cells ring by ring outwards from the point's one, skipping the ones outside the bounds and the buckets
+	//whose items are all further than the nearest one found so far, and stops once a ring can't have anything nearer
+	//(whatever is r + 1 cells out is at least r cell sizes away)
+	template<typename Distance>
+	float NearestSquared(glm::vec3 point, float radius, glm::vec3 min, glm::vec3 max, Distance distance) const
+	{
+		float nearest = FLT_MAX;
+		if (entries.empty())
+			return nearest;
+		glm::ivec3 center = Cell(point), boundsFrom = Cell(min), boundsTo = Cell(max);
+		float reach = radius * radius;
+		for (int ring = 0; ring == 0 || (ring - 1) * cellSize * (ring - 1) * cellSize < fminf(nearest, reach); ring++)
+		{
+			glm::ivec3 from = glm::max(center - glm::ivec3(ring), boundsFrom), to = glm::min(center + glm::ivec3(ring), boundsTo);
+			auto visitCell = [&](int x, int y, int z)
+			{
+				size_t bucket = Bucket(glm::ivec3(x, y, z));
+				glm::vec3 offset = glm::max(glm::max(bucketMin[bucket] - point, point - bucketMax[bucket]), glm::vec3(0.0f));
+				if (glm::dot(offset, offset) >= fminf(nearest, reach))
+					return; //empty buckets have inside out bounds, they never get here
+				for (int e = bucketStart[bucket]; e < bucketStart[bucket + 1]; e++)
+					nearest = fminf(nearest, distance(entries[e]));
+			};
+			for (int x = from.x; x <= to.x; x++)
+				for (int y = from.y; y <= to.y; y++)
+				{
+					if (abs(x - center.x) == ring || abs(y - center.y) == ring)
+					{
+						for (int z = from.z; z <= to.z; z++)
+							visitCell(x, y, z);
+						continue;
+					}
+					//inside the shell along x and y, only its two faces along z are on it
+					if (center.z - ring >= from.z && center.z - ring <= to.z)
+						visitCell(x, y, center.z - ring);
+					if (center.z + ring >= from.z && center.z + ring <= to.z)
+						visitCell(x, y, center.z + ring);
+				}
+			if (from == boundsFrom && to == boundsTo)
+				break; //every cell of the bounds has been looked at
+		}
+		return nearest;
+	}
+
+	//Cell size that puts about one point in a cell when the points lie on a surface, which is what meshes are
+	static float SurfaceCellSize(const std::vector<glm::vec3>& points)
+	{
+		if (points.empty())
+			return 1.0f;
+		glm::vec3 min = points[0], max = points[0];
+		for (const glm::vec3& point : points)
+		{
+			min = glm::min(min, point);
+			max = glm::max(max, point);
+		}
+		float extent = std::max(std::max(max.x - min.x, max.y - min.y), max.z - min.z);
+		float size = extent / sqrtf((float)points.size());
+		return size > FLT_EPSILON ? size : 1.0f;
+	}
+
+	//The points with duplicates removed, in the order they first show up
+	static std::vector<glm::vec3> UniquePoints(const std::vector<glm::vec3>& points)
+	{
+		SpatialHash hash;
+		hash.Build(points, SurfaceCellSize(points));
+		std::vector<glm::vec3> unique;
+		for (int i = 0; i < points.size(); i++)
+		{
+			bool found = false;
+			hash.Query(points[i], [&](int j) { found = found || (j < i && points[j] == points[i]); });
+			if (!found)
+				unique.push_back(points[i]);
+		}
+		return unique;
+	}
+
+	size_t EntryCount() const { return entries.size(); }
+	float CellSize() const { return cellSize; }
+
+private:
+	//Cell coordinates are clamped so points far outside any sensible grid don't overflow
+	glm::ivec3 Cell(glm::vec3 point) const
+	{
+		const float cellLimit = (float)(1 << 30);
+		glm::vec3 cell = glm::clamp(glm::floor(point * inverseCellSize), glm::vec3(-cellLimit), glm::vec3(cellLimit));
+		return glm::ivec3(cell);
+	}
+
+	size_t Bucket(glm::ivec3 cell) const
+	{
+		//the usual large primes for hashing grid cells
+		return (((unsigned int)cell.x * 73856093u) ^ ((unsigned int)cell.y * 19349663u) ^ ((unsigned int)cell.z * 83492791u)) & bucketMask;
+	}
+
+	template<typename Function>
+	void ForEachCell(glm::vec3 min, glm::vec3 max, Function function) const
+	{
+		glm::ivec3 from = Cell(min), to = Cell(max);
+		for (int x = from.x; x <= to.x; x++)
+			for (int y = from.y; y <= to.y; y++)
+				for (int z = from.z; z <= to.z; z++)
+					function(glm::ivec3(x, y, z));
+	}
+
+	float cellSize;
+	float inverseCellSize;
+	size_t bucketMask;
+	std::vector<int> bucketStart; //entries of bucket b are entries[bucketStart[b]] to entries[bucketStart[b + 1] - 1]
+	std::vector<int> entries; //item indices
+	std::vector<glm::vec3> bucketMin, bucketMax; //bounds of the items in every bucket
+};
+
+#endif
@@ -0,0 +1,261 @@
+#ifndef SURFACE_RELAXATION_H
+#define SURFACE_RELAXATION_H
+//-------------------------------------------------------------------------------------
+// Post impact relaxation of a dented surface, position based (PBD) over the mesh edges.
+// Dents are a radial falloff, so a big impact stretches the edges along its rim into a
+// crease. Every edge stretched past maxStretch times its rest length is pulled back to
+// that length, which drags the vertices around the dent along with it and spreads the
+// crease out. Only the vertices of a region (the dent and a few rings of edges around
+// it) move, pinned vertices (the ones right under the projectile) and everything outside
+// the region hold still, so the dent keeps its depth and untouched parts stay as they are.
+// Jacobi iterations: every vertex works out its correction from the previous iteration's
+// positions, so the vertices of an iteration go in parallel, and the corrections of a
+// chunk of them run over plain arrays.
+// Vertices at the same position (seams of split normals/uvs) are welded into one node,
+// so relaxing never tears the mesh open.
+//-------------------------------------------------------------------------------------
+
+#include<glm\glm.hpp>
+
+#include<vector>
+#include<algorithm>
+#include<chrono>
+#include<math.h>
+#include "mesh.h"
+#include "spatialHash.h"
+#include "jobSystem.h"
+#include "profiler.h"
+
+struct RelaxationSettings
+{
+	bool enabled = false;
+	int rings = 2; //how many edges out from the dented vertices the region reaches
+	int maxIterations = 8; //per simulation step, the budget that keeps the relaxation deterministic
+	//seconds per step, 0 for none. Iterations stop early once they go over it, which makes the dent depend on how
+	//busy the machine is and on its core count, so runs with it are no longer reproducible
+	double timeBudget = 0.0;
+	float maxStretch = 1.1f; //edges longer than this times their rest length get pulled back
+	float stiffness = 1.0f; //how much of the correction an iteration applies, 0 to 1
+	float pinShare = 0.99f; //vertices pushed by at least this part of the deepest push of the step are held in place
+};
+
+class SurfaceRelaxation
+{
+public:
+	//Welds the mesh vertices and builds the edge lists with the current edge lengths as rest lengths
+	void Setup(const Mesh& mesh)
+	{
+		PROFILE_ZONE("relaxation setup");
+		const std::vector<Vertex>& vertices = mesh.vertices;
+		int vertexCount = (int)vertices.size();
+		std::vector<glm::vec3> positions(vertexCount);
+		for (int i = 0; i < vertexCount; i++)
+			positions[i] = vertices[i].Position;
+
+		//the first vertex at a position is the node, later ones are its copies
+		SpatialHash hash;
+		hash.Build(positions, SpatialHash::SurfaceCellSize(positions));
+		nodeOf.assign(vertexCount, -1);
+		nodeVertex.clear();
+		for (int i = 0; i < vertexCount; i++)
+		{
+			int same = -1;
+			hash.Query(positions[i], [&](int j) { if (same < 0 && j < i && positions[j] == positions[i]) same = j; });
+			if (same < 0)
+			{
+				nodeOf[i] = (int)nodeVertex.size();
+				nodeVertex.push_back(i);
+			}
+			else
+				nodeOf[i] = nodeOf[same];
+		}
+		int nodeCount = (int)nodeVertex.size();
+
+		//copies of every node, counting sort like the hash
+		copyStart.assign(nodeCount + 1, 0);
+		for (int i = 0; i < vertexCount; i++)
+			copyStart[nodeOf[i] + 1]++;
+		for (int n = 0; n < nodeCount; n++)
+			copyStart[n + 1] += copyStart[n];
+		copies.resize(vertexCount);
+		std::vector<int> fill(copyStart.begin(), copyStart.end() - 1);
+		for (int i = 0; i < vertexCount; i++)
+			copies[fill[nodeOf[i]]++] = i;
+
+		//every triangle edge in both directions, then sorted and deduplicated per node
+		std::vector<std::vector<int>> adjacent(nodeCount);
+		const std::vector<unsigned int>& indices = mesh.indices;
+		for (size_t t = 0; t + 2 < indices.size(); t += 3)
+		{
+			for (int e = 0; e < 3; e++)
+			{
+				int a = nodeOf[indices[t + e]], b = nodeOf[indices[t + (e + 1) % 3]];
+				if (a == b)
+					continue;
+				adjacent[a].push_back(b);
+				adjacent[b].push_back(a);
+			}
+		}
+		edgeStart.assign(nodeCount + 1, 0);
+		edgeTarget.clear();
+		restLength.clear();
+		for (int n = 0; n < nodeCount; n++)
+		{
+			std::sort(adjacent[n].begin(), adjacent[n].end());
+			adjacent[n].erase(std::unique(adjacent[n].begin(), adjacent[n].end()), adjacent[n].end());
+			for (int other : adjacent[n])
+			{
+				edgeTarget.push_back(other);
+				restLength.push_back(glm::length(positions[nodeVertex[other]] - positions[nodeVertex[n]]));
+			}
+			edgeStart[n + 1] = (int)edgeTarget.size();
+		}
+		regionStamp.assign(nodeCount, 0);
+		pinStamp.assign(nodeCount, 0);
+		stamp = 0;
+	}
+
+	bool IsSetUp() const { return !nodeVertex.empty(); }
+
+	//Relaxes the region around the seed vertices, pinned ones don't move (both are vertex indices)
+	//Runs maxIterations iterations, fewer if a time budget is set and they go over it, returns how many it ran
+	//Every vertex it moved ends up in moved (copies included), in no particular order
+	int Relax(std::vector<Vertex>& vertices, const std::vector<int>& seeds, const std::vector<int>& pinned,
+		const RelaxationSettings& settings, std::vector<int>& moved)
+	{
+		PROFILE_ZONE("relaxation");
+		moved.clear();
+		if (!IsSetUp() || seeds.empty() || settings.maxIterations <= 0)
+			return 0;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		BuildRegion(seeds, pinned, settings.rings);
+		int count = (int)region.size();
+		if (count == 0)
+			return 0;
+
+		//positions of the nodes in the region, the rest are read from the mesh and never change here
+		current.resize(count);
+		next.resize(count);
+		for (int k = 0; k < count; k++)
+			current[k] = vertices[nodeVertex[region[k]]].Position;
+
+		int iterations = 0;
+		while (iterations < settings.maxIterations)
+		{
+			Jobs().ParallelForRange("relaxation", 0, count, 256, [&](int first, int last)
+			{
+				for (int k = first; k < last; k++)
+					next[k] = Corrected(k, vertices, settings);
+			});
+			current.swap(next);
+			iterations++;
+			if (settings.timeBudget > 0.0 && std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() > settings.timeBudget)
+				break;
+		}
+
+		for (int k = 0; k < count; k++)
+		{
+			int node = region[k];
+			if (vertices[nodeVertex[node]].Position == current[k])
+				continue;
+			for (int c = copyStart[node]; c < copyStart[node + 1]; c++)
+			{
+				vertices[copies[c]].Position = current[k];
+				moved.push_back(copies[c]);
+			}
+		}
+		return iterations;
+	}
+
+private:
+	//Nodes within rings edges of the seeds, minus the pinned ones, each one once
+	void BuildRegion(const std::vector<int>& seeds, const std::vector<int>& pinned, int rings)
+	{
+		stamp++;
+		for (int vert : pinned)
+			pinStamp[nodeOf[vert]] = stamp;
+		region.clear();
+		regionIndex.resize(nodeVertex.size());
+		std::vector<int>& frontier = ringScratch;
+		frontier.clear();
+		for (int vert : seeds)
+		{
+			int node = nodeOf[vert];
+			if (regionStamp[node] != stamp)
+			{
+				regionStamp[node] = stamp;
+				frontier.push_back(node);
+			}
+		}
+		//breadth first, a ring at a time
+		size_t ringBegin = 0;
+		for (int ring = 0; ring < rings; ring++)
+		{
+			size_t ringEnd = frontier.size();
+			for (size_t f = ringBegin; f < ringEnd; f++)
+			{
+				int node = frontier[f];
+				for (int e = edgeStart[node]; e < edgeStart[node + 1]; e++)
+				{
+					if (regionStamp[edgeTarget[e]] != stamp)
+					{
+						regionStamp[edgeTarget[e]] = stamp;
+						frontier.push_back(edgeTarget[e]);
+					}
+				}
+			}
+			ringBegin = ringEnd;
+		}
+		for (int node : frontier)
+		{
+			if (pinStamp[node] == stamp)
+				continue;
+			regionIndex[node] = (int)region.size();
+			region.push_back(node);
+		}
+	}
+
+	//Where the k-th region node goes this iteration, the average of the corrections of its overstretched edges
+	glm::vec3 Corrected(int k, const std::vector<Vertex>& vertices, const RelaxationSettings& settings) const
+	{
+		int node = region[k];
+		glm::vec3 position = current[k];
+		glm::vec3 correction(0.0f);
+		int constraints = 0;
+		for (int e = edgeStart[node]; e < edgeStart[node + 1]; e++)
+		{
+			int other = edgeTarget[e];
+			bool otherMoves = regionStamp[other] == stamp && pinStamp[other] != stamp;
+			glm::vec3 otherPosition = otherMoves ? current[regionIndex[other]] : vertices[nodeVertex[other]].Position;
+			glm::vec3 edge = otherPosition - position;
+			float length = glm::length(edge);
+			float limit = restLength[e] * settings.maxStretch;
+			if (length <= limit || length <= 0.0f)
+				continue;
+			//a moving neighbour takes half of the correction, a fixed one none of it
+			float share = otherMoves ? 0.5f : 1.0f;
+			correction += edge * ((length - limit) / length * share);
+			constraints++;
+		}
+		if (constraints == 0)
+			return position;
+		return position + correction * (settings.stiffness / constraints);
+	}
+
+	//Welding
+	std::vector<int> nodeOf; //per vertex
+	std::vector<int> nodeVertex; //per node, the vertex its position is read from
+	std::vector<int> copyStart, copies; //vertices of node n are copies[copyStart[n]] to copies[copyStart[n + 1] - 1]
+	//Edges of node n are edgeTarget[edgeStart[n]] to edgeTarget[edgeStart[n + 1] - 1]
+	std::vector<int> edgeStart, edgeTarget;
+	std::vector<float> restLength; //per edge
+
+	//Region of the current Relax, marked by stamp so nothing has to be cleared between calls
+	unsigned int stamp = 0;
+	std::vector<unsigned int> regionStamp, pinStamp; //per node
+	std::vector<int> regionIndex; //per node, its place in region (valid while regionStamp matches)
+	std::vector<int> region, ringScratch;
+	std::vector<glm::vec3> current, next;
+};
+
+#endif
@@ -14,6 +14,8 @@
 #include "shader.h"
 #include "model.h"
 #include "rayUtil.h"
+#include "logger.h"
+#include "spatialHash.h"
 
 
 struct VertInfo
@@ -34,14 +36,13 @@ public:
 	Target(const char* modelPath, float falloff, float roughness, float threshold):
 		targetModel(modelPath, true), falloff(falloff), roughness(roughness), threshold(threshold)
 	{
-		VertInfo vi;
-		std::vector<VertInfo> vInfo(targetModel.meshes[0].vertices.size(), vi);
-		vertInfo = vInfo;
-
-		model = glm::mat4(1.0f);
-		std::cout << "Loaded model info, setting up vertices...\n";
-		OptimizeVertices();
-		std::cout << "Successfully set up target\n";
+		Init();
+	}
+	//Target from a model built in code (procedural geometry), needs no GL context if the model has no buffers
+	Target(Model model, float falloff, float roughness, float threshold) :
+		targetModel(std::move(model)), falloff(falloff), roughness(roughness), threshold(threshold)
+	{
+		Init();
 	}
 
 	void Draw(Shader& shader)
@@ -73,25 +74,26 @@ public:
 	std::vector<VertInfo> vertInfo;
 	float falloff;
 private:
-	void OptimizeVertices()
+	void Init()
 	{
-		for (int i = 0; i < targetModel.meshes[0].vertices.size(); i++)
-		{
-			bool found = false;
-			for (int j = 0; j < optimizedVerts.size(); j++)
-			{
-				if (targetModel.meshes[0].vertices[i].Position == optimizedVerts[j])
-					found = true;
-			}
-			if (!found)
-				optimizedVerts.push_back(targetModel.meshes[0].vertices[i].Position);
-			if (!(i % 250))
-			{
-				system("CLS");
-				std::cout << "optimizing: " << float(i) * 100.0f / targetModel.meshes[0].vertices.size() << "%\n";
+		VertInfo vi;
+		std::vector<VertInfo> vInfo(targetModel.meshes[0].vertices.size(), vi);
+		vertInfo = vInfo;
 
-			}
-		}
+		model = glm::mat4(1.0f);
+		LOG_INFO("Loaded model info, setting up vertices...");
+		OptimizeVertices();
+		LOG_INFO("Successfully set up target");
+	}
+
+	void OptimizeVertices()
+	{
+		std::vector<glm::vec3> positions;
+		positions.reserve(targetModel.meshes[0].vertices.size());
+		for (const Vertex& vertex : targetModel.meshes[0].vertices)
+			positions.push_back(vertex.Position);
+		optimizedVerts = SpatialHash::UniquePoints(positions);
+		LOG_DEBUG("optimized " << positions.size() << " verts down to " << optimizedVerts.size());
 	}
 	float roughness;
 	float threshold;
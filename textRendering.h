@@ -12,11 +12,15 @@
 #include<iostream>
 #include<string>
 #include<map>
+#include<vector>
+#include<algorithm>
+#include<string.h>
 #include "shader.h"
+#include "logger.h"
 
 struct Character
 {
-	GLuint TextureID; //id of glyph texture
+	glm::vec2 UVMin, UVMax; //where the glyph is in the atlas
 	glm::ivec2 Size;
 	glm::ivec2 Bearing; //offset from baseline
 	GLuint Advance;
@@ -29,106 +33,210 @@ public:
 	{
 		//Loading the text library, returns non-0 if there's an error
 		if (FT_Init_FreeType(&ft))
-			std::cout << "ERROR: Failed to initialize FreeType Library" << std::endl;
+			LOG_ERROR("Failed to initialize FreeType Library");
 		//Loading the typeface
 		if (FT_New_Face(ft, fontPath, 0, &face))
-			std::cout << "ERROR: Failed to load font" << std::endl;
+			LOG_ERROR("Failed to load font " << fontPath);
 		//Setting font size
 		FT_Set_Pixel_Sizes(face, index, size);
 		
 		this->color = color;
-
-		//Text geometry setup
-		glGenVertexArrays(1, &VAO);
-		glGenBuffers(1, &VBO);
-		glBindVertexArray(VAO);
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
-		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), 0);
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindVertexArray(0);
-
 		generateTypeFace();
 	}
 
-	void renderText(Shader& s, std::string text, GLfloat x, GLfloat y, GLfloat scale, glm::mat4 projection)
+	//Draws the whole string with one call, strings drawn recently keep their geometry on the GPU and aren't rebuilt
+	void renderText(Shader& s, const std::string& text, GLfloat x, GLfloat y, GLfloat scale, glm::mat4 projection)
 	{
+		TextLayout& layout = findLayout(text);
+		if (layout.vertexCount == 0)
+			return;
+
+		//layouts start at the origin at scale 1, position and scale go into the transform
+		glm::mat4 placement = glm::translate(glm::mat4(1.0f), glm::vec3(x, y, 0.0f));
+		placement = glm::scale(placement, glm::vec3(scale, scale, 1.0f));
 		s.use();
-		s.setVec3("textColor", color);
-		s.setMat4("projection", projection);
+		s.setVec3(colorUniform.get(s), color);
+		s.setMat4(projectionUniform.get(s), projection * placement);
 		glActiveTexture(GL_TEXTURE0);
-		glBindVertexArray(VAO);
+		glBindTexture(GL_TEXTURE_2D, atlasTexture);
+		glBindVertexArray(layout.VAO);
+		glDrawArrays(GL_TRIANGLES, 0, layout.vertexCount);
+		glBindVertexArray(0);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
 
-		std::string::const_iterator c;
-		for (c = text.begin(); c != text.end(); c++)
+private:
+	struct TextLayout
+	{
+		std::string text;
+		unsigned int VAO = 0, VBO = 0;
+		GLsizei vertexCount = 0;
+		size_t capacity = 0; //in floats
+		unsigned long long lastUsed = 0;
+	};
+
+	//The cached layout of the string, the least recently used one gets rebuilt for it if there's none
+	TextLayout& findLayout(const std::string& text)
+	{
+		useCounter++;
+		TextLayout* oldest = nullptr;
+		for (TextLayout& layout : layouts)
 		{
-			Character ch = Characters[*c];
-
-			GLfloat xpos = x + ch.Bearing.x * scale;
-			GLfloat ypos = y - (ch.Size.y - ch.Bearing.y) * scale;
+			if (layout.text == text)
+			{
+				layout.lastUsed = useCounter;
+				return layout;
+			}
+			if (oldest == nullptr || layout.lastUsed < oldest->lastUsed)
+				oldest = &layout;
+		}
+		if (layouts.size() < maxCachedLayouts)
+		{
+			layouts.push_back(TextLayout());
+			oldest = &layouts.back();
+			glGenVertexArrays(1, &oldest->VAO);
+			glGenBuffers(1, &oldest->VBO);
+			glBindVertexArray(oldest->VAO);
+			glBindBuffer(GL_ARRAY_BUFFER, oldest->VBO);
+			glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), 0);
+			glEnableVertexAttribArray(0);
+			glBindVertexArray(0);
+		}
+		buildLayout(*oldest, text);
+		oldest->lastUsed = useCounter;
+		return *oldest;
+	}
 
-			GLfloat w = ch.Size.x * scale;
-			GLfloat h = ch.Size.y * scale;
+	void buildLayout(TextLayout& layout, const std::string& text)
+	{
+		std::vector<GLfloat> vertices;
+		vertices.reserve(text.size() * 6 * 4);
+		GLfloat x = 0.0f;
+		for (char c : text)
+		{
+			auto found = Characters.find(c);
+			if (found == Characters.end())
+				continue;
+			const Character& ch = found->second;
+
+			GLfloat xpos = x + ch.Bearing.x;
+			GLfloat ypos = -(GLfloat)(ch.Size.y - ch.Bearing.y);
+			GLfloat w = (GLfloat)ch.Size.x;
+			GLfloat h = (GLfloat)ch.Size.y;
+			x += ch.Advance >> 6; //because advance 1/64 of a pixel
+			if (ch.Size.x == 0 || ch.Size.y == 0) //spaces only move the pen
+				continue;
 
-			GLfloat vertices[6][4] = {
-				{xpos, ypos + h,		0.0, 0.0},
-				{xpos, ypos,			0.0, 1.0},
-				{xpos + w, ypos,		1.0, 1.0},
+			GLfloat quad[6][4] = {
+				{xpos, ypos + h,		ch.UVMin.x, ch.UVMin.y},
+				{xpos, ypos,			ch.UVMin.x, ch.UVMax.y},
+				{xpos + w, ypos,		ch.UVMax.x, ch.UVMax.y},
 
-				{xpos, ypos + h,		0.0, 0.0},
-				{xpos + w, ypos,		1.0, 1.0},
-				{xpos + w, ypos + h,	1.0, 0.0}
+				{xpos, ypos + h,		ch.UVMin.x, ch.UVMin.y},
+				{xpos + w, ypos,		ch.UVMax.x, ch.UVMax.y},
+				{xpos + w, ypos + h,	ch.UVMax.x, ch.UVMin.y}
 			};
-			glBindTexture(GL_TEXTURE_2D, ch.TextureID);
-			glBindBuffer(GL_ARRAY_BUFFER, VBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			vertices.insert(vertices.end(), &quad[0][0], &quad[0][0] + 6 * 4);
+		}
 
-			glDrawArrays(GL_TRIANGLES, 0, 6);
-			x += (ch.Advance >> 6) * scale; //because advance 1/64 of a pixel
+		layout.text = text;
+		layout.vertexCount = (GLsizei)(vertices.size() / 4);
+		if (vertices.empty())
+			return;
+		glBindBuffer(GL_ARRAY_BUFFER, layout.VBO);
+		if (vertices.size() > layout.capacity)
+		{
+			layout.capacity = vertices.size();
+			glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.data(), GL_DYNAMIC_DRAW);
 		}
-		glBindVertexArray(0);
-		glBindTexture(GL_TEXTURE_2D, 0);
+		else
+			glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(GLfloat), vertices.data());
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
 	}
 
-private:
+	//Packs the first 128 glyphs into rows of one atlas texture
 	void generateTypeFace()
 	{
-		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		struct GlyphBitmap
+		{
+			GLubyte c;
+			int width, rows, x, y;
+			std::vector<unsigned char> pixels;
+		};
+		std::vector<GlyphBitmap> glyphs;
+		const int atlasWidth = 512, padding = 1; //padding keeps the filtering from bleeding in the neighbours
+		int penX = padding, penY = padding, rowHeight = 0;
 		for (GLubyte c = 0; c < 128; c++)
 		{
 			if (FT_Load_Char(face, c, FT_LOAD_RENDER))
 			{
-				std::cout << "ERROR: Failed to load glyph " << c << std::endl;
+				LOG_ERROR("Failed to load glyph " << c);
 				continue;
 			}
-			//Texture generation based on loaded glyph
-			GLuint texture;
-			glGenTextures(1, &texture);
-			glBindTexture(GL_TEXTURE_2D, texture);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, face->glyph->bitmap.width, face->glyph->bitmap.rows, 0, GL_RED, GL_UNSIGNED_BYTE, face->glyph->bitmap.buffer);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			FT_Bitmap& bitmap = face->glyph->bitmap;
+			GlyphBitmap glyph;
+			glyph.c = c;
+			glyph.width = bitmap.width;
+			glyph.rows = bitmap.rows;
+			if (penX + glyph.width + padding > atlasWidth)
+			{
+				penX = padding;
+				penY += rowHeight + padding;
+				rowHeight = 0;
+			}
+			glyph.x = penX;
+			glyph.y = penY;
+			penX += glyph.width + padding;
+			rowHeight = std::max(rowHeight, glyph.rows);
+			glyph.pixels.resize(glyph.width * glyph.rows);
+			for (int row = 0; row < glyph.rows && glyph.width > 0; row++)
+				memcpy(&glyph.pixels[row * glyph.width], bitmap.buffer + row * bitmap.pitch, glyph.width);
+
 			Character character = {
-				texture,
-				glm::ivec2(face->glyph->bitmap.width, face->glyph->bitmap.rows),
+				glm::vec2(0.0f), glm::vec2(0.0f), //filled in once the atlas size is known
+				glm::ivec2(bitmap.width, bitmap.rows),
 				glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top),
-				face->glyph->advance.x
+				(GLuint)face->glyph->advance.x
 			};
 			Characters.insert(std::pair<GLchar, Character>(c, character));
+			glyphs.push_back(std::move(glyph));
 		}
 		FT_Done_Face(face);
 		FT_Done_FreeType(ft);
+
+		int atlasHeight = 1;
+		while (atlasHeight < penY + rowHeight + padding)
+			atlasHeight *= 2;
+		std::vector<unsigned char> atlas(atlasWidth * atlasHeight, 0);
+		for (const GlyphBitmap& glyph : glyphs)
+		{
+			for (int row = 0; row < glyph.rows && glyph.width > 0; row++)
+				memcpy(&atlas[(glyph.y + row) * atlasWidth + glyph.x], &glyph.pixels[row * glyph.width], glyph.width);
+			Character& character = Characters[glyph.c];
+			character.UVMin = glm::vec2((float)glyph.x / atlasWidth, (float)glyph.y / atlasHeight);
+			character.UVMax = glm::vec2((float)(glyph.x + glyph.width) / atlasWidth, (float)(glyph.y + glyph.rows) / atlasHeight);
+		}
+
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glGenTextures(1, &atlasTexture);
+		glBindTexture(GL_TEXTURE_2D, atlasTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, atlasWidth, atlasHeight, 0, GL_RED, GL_UNSIGNED_BYTE, atlas.data());
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glBindTexture(GL_TEXTURE_2D, 0);
 	}
 	FT_Library ft;
 	FT_Face face;
 	std::map<GLchar, Character> Characters;
+	unsigned int atlasTexture;
 
-	unsigned int VAO, VBO;
+	static const size_t maxCachedLayouts = 16;
+	std::vector<TextLayout> layouts;
+	unsigned long long useCounter = 0;
 	glm::vec3 color;
+	UniformHandle colorUniform{ "textColor" }, projectionUniform{ "projection" };
 };
 
 
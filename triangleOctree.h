@@ -2,6 +2,8 @@
 #define TRI_OCTREE_H
 
 #include<vector>
+#include<unordered_map>
+#include<algorithm>
 #include<iostream>
 #include<math.h>
 #include<glm\glm.hpp>
@@ -11,6 +13,9 @@
 
 #include"target.h"
 #include"aabbtriCollision.h"
+#include"collisionMirror.h"
+#include"jobSystem.h"
+#include"logger.h"
 
 namespace vecUtil
 {
@@ -95,8 +100,6 @@ struct Triangle
 	int index1;
 	int index2;
 
-	glm::vec3 positions[3];
-
 	Triangle(int i0, int i1, int i2)
 	{
 		index0 = i0;
@@ -131,6 +134,7 @@ struct OctreeNode
 
 	std::vector<Vertex>* vertices = NULL; //todo change to indices
 	std::vector<Triangle>* tris = NULL;
+	LeafMirror* mirror = NULL; //owned by the tree, only there once it built its collision mirror
 	glm::vec3 position;
 	float size;
 };
@@ -220,6 +224,46 @@ bool TriangleOctantIntersection(const Model& model, float octantSize, glm::vec3
 }
 
 
+//Shape of a built octree, for tuning minSize/maxTris/depth/initial size per mesh, see Octree::ComputeStats
+struct OctreeStats
+{
+	std::vector<int> nodesPerLevel; //index 0 is the root
+	int leafCount = 0;
+	int emptyLeafCount = 0; //leaves without any triangles
+	float emptyLeafRatio = 0.0f;
+	//leaves by triangle count, bucket 0 holds empty leaves, bucket i > 0 holds leaves with 2^(i-1) to 2^i - 1 triangles
+	std::vector<int> trisPerLeafHistogram;
+	int maxTrisPerLeaf = 0;
+	float meanTrisPerLeaf = 0.0f; //over the non empty leaves
+	int meshTriangles = 0;
+	int storedTriangles = 0; //sum over the leaves, triangles spanning several leaves count every time
+	float duplicationFactor = 0.0f; //storedTriangles / meshTriangles
+	size_t memoryBytes = 0; //nodes plus the leaf triangle lists and collision mirrors
+	//Estimated triangles tested by one ray, the rays test every triangle of the leaf they end up in
+	float expectedTrisPerRay = 0.0f; //rays ending on the surface, leaves picked in proportion to their triangles
+	float expectedTrisPerRayUniform = 0.0f; //rays ending anywhere in the tree, leaves picked in proportion to their volume
+
+	//Multiline summary, without a newline at the end
+	void Print(std::ostream& out) const
+	{
+		out << "Octree: " << leafCount << " leaves, nodes per level:";
+		for (int count : nodesPerLevel)
+			out << " " << count;
+		out << "\n  empty leaves: " << emptyLeafCount << " (" << emptyLeafRatio * 100.0f << "%), tris per leaf: mean " << meanTrisPerLeaf
+			<< ", max " << maxTrisPerLeaf << "\n  tris per leaf histogram:";
+		for (int i = 0; i < trisPerLeafHistogram.size(); i++)
+		{
+			if (i == 0)
+				out << " [0]=" << trisPerLeafHistogram[i];
+			else
+				out << " [" << (1 << (i - 1)) << "-" << (1 << i) - 1 << "]=" << trisPerLeafHistogram[i];
+		}
+		out << "\n  triangles: " << meshTriangles << " in the mesh, " << storedTriangles << " stored, duplication " << duplicationFactor
+			<< "\n  memory: " << memoryBytes / 1024.0 << " KB, expected tris per ray: " << expectedTrisPerRay << " (surface), "
+			<< expectedTrisPerRayUniform << " (uniform)";
+	}
+};
+
 class Octree
 {
 public:
@@ -244,7 +288,7 @@ public:
 			Insert(dataArray, root);
 		else
 		{
-			std::cout << "if i got here, you fucked something up??\n";
+			LOG_ERROR("Octree has no root, it has to be subdivided before inserting");
 			//root = newOctreeNode(data);
 		}
 	}
@@ -262,14 +306,44 @@ public:
 	void InsertTriangles(std::vector<Triangle> dataArray)
 	{
 		if (root != NULL)
+		{
 			InsertTriangles(dataArray, root);
+			if (LOG_ENABLED(LogLevel::Info)) //the stats walk the whole tree, skip them when nobody sees them
+			{
+				std::ostringstream stats;
+				ComputeStats().Print(stats);
+				LOG_INFO(stats.str());
+			}
+		}
 		else
 		{
-			std::cout << "if i got here, you fucked something up??\n";
+			LOG_ERROR("Octree has no root, it has to be subdivided before inserting");
 			//root = newOctreeNode(data);
 		}
 	}
 
+	//Walks the whole tree, meant for diagnostics rather than every frame
+	OctreeStats ComputeStats() const
+	{
+		OctreeStats stats;
+		stats.meshTriangles = (int)model.meshes[0].indices.size() / 3;
+		double squaredTris = 0.0, volumeWeightedTris = 0.0, totalVolume = (double)root->size * root->size * root->size;
+		CollectStats(root, 0, stats, squaredTris, volumeWeightedTris);
+
+		int filledLeaves = stats.leafCount - stats.emptyLeafCount;
+		if (stats.leafCount > 0)
+			stats.emptyLeafRatio = (float)stats.emptyLeafCount / stats.leafCount;
+		if (filledLeaves > 0)
+			stats.meanTrisPerLeaf = (float)stats.storedTriangles / filledLeaves;
+		if (stats.meshTriangles > 0)
+			stats.duplicationFactor = (float)stats.storedTriangles / stats.meshTriangles;
+		if (stats.storedTriangles > 0)
+			stats.expectedTrisPerRay = (float)(squaredTris / stats.storedTriangles);
+		if (totalVolume > 0.0)
+			stats.expectedTrisPerRayUniform = (float)(volumeWeightedTris / totalVolume);
+		return stats;
+	}
+
 	OctreeNode* FindOctant(glm::vec3 data)
 	{
 		if (fabs(data.x) > root->position.x + size || fabs(data.y) > root->position.y + size || fabs(data.z) > root->position.z + size)
@@ -284,11 +358,224 @@ public:
 	{
 		return Search(data, root);
 	}
+
+	//Visits every leaf that intersects the given sphere, whole subtrees outside of it are skipped
+	//The visitor is called as visitor(OctreeNode* leaf)
+	template<typename LeafVisitor>
+	void QuerySphereLeaves(glm::vec3 center, float radius, LeafVisitor visitor)
+	{
+		QuerySphereLeaves(center, radius, root, visitor);
+	}
+
+	//Visits every leaf that overlaps the given axis aligned box, used for swept volume queries
+	//The visitor is called as visitor(OctreeNode* leaf)
+	template<typename LeafVisitor>
+	void QueryBox(glm::vec3 boxMin, glm::vec3 boxMax, LeafVisitor visitor)
+	{
+		QueryBox(boxMin, boxMax, root, visitor);
+	}
+
+	//Visits every vertex within radius of center, each vertex only once per query, even if it's shared by
+	//several triangles or its triangles span several leaves. The visitor is called as visitor(int vertexIndex, float distance)
+	//Single entry point for falloff gathering and contact queries, not thread safe (the leaf and box queries are)
+	template<typename VertexVisitor>
+	void QuerySphere(glm::vec3 center, float radius, VertexVisitor visitor)
+	{
+		const std::vector<Vertex>& vertices = model.meshes[0].vertices;
+		if (vertexQueryStamp.size() != vertices.size())
+			vertexQueryStamp.assign(vertices.size(), 0);
+		if (++queryStamp == 0) //the stamp wrapped around, old marks can't be trusted anymore
+		{
+			std::fill(vertexQueryStamp.begin(), vertexQueryStamp.end(), 0);
+			queryStamp = 1;
+		}
+
+		QuerySphereLeaves(center, radius, [&](OctreeNode* leaf)
+		{
+			if (leaf->mirror != nullptr) //the mirror lists the leaf's vertices, no need to go through the triangles
+			{
+				if (leaf->mirror->vertsStale)
+					PackLeafVerts(leaf);
+				const LeafMirror& mirror = *leaf->mirror;
+				for (int v = 0; v < mirror.verts.size(); v++)
+				{
+					int index = mirror.verts[v];
+					if (vertexQueryStamp[index] == queryStamp)
+						continue; //already visited through another leaf
+					vertexQueryStamp[index] = queryStamp;
+
+					float distance = glm::length((exactVerts[index] ? vertices[index].Position : mirror.VertexPosition(v)) - center);
+					if (distance <= radius)
+						visitor(index, distance);
+				}
+				return;
+			}
+			for (const Triangle& tri : *leaf->tris)
+			{
+				const int triIndices[3] = { tri.index0, tri.index1, tri.index2 };
+				for (int index : triIndices)
+				{
+					if (vertexQueryStamp[index] == queryStamp)
+						continue; //already visited through another triangle
+					vertexQueryStamp[index] = queryStamp;
+
+					float distance = glm::length(vertices[index].Position - center);
+					if (distance <= radius)
+						visitor(index, distance);
+				}
+			}
+		});
+	}
+
+	//Packs the positions of every leaf's triangles into a collision mirror (see collisionMirror.h), the leaf triangle reads
+	//below and the queries go to it from then on. Pays off for big targets that don't fit the cache, not for trees that move
+	void BuildCollisionMirror()
+	{
+		std::vector<OctreeNode*> leaves;
+		CollectLeaves(root, leaves);
+		leafMirrors.assign(leaves.size(), LeafMirror());
+		exactVerts.assign(model.meshes[0].vertices.size(), 0);
+		Jobs().ParallelFor("collision mirror", 0, (int)leaves.size(), 1, [&](int i)
+		{
+			leaves[i]->mirror = &leafMirrors[i];
+			PackLeaf(leaves[i]);
+		});
+	}
+
+	bool HasCollisionMirror() const
+	{
+		return !leafMirrors.empty();
+	}
+
+	//The vertices moved, they're read from the mesh at full precision from now on, call it before the next query
+	void MarkExact(const std::vector<int>& verts)
+	{
+		if (leafMirrors.empty())
+			return;
+		for (int vert : verts)
+			exactVerts[vert] = 1;
+	}
+
+	//The vertices moved (dented, relaxed or put back by a seek), call it before the next query
+	//The leaves were filled with the triangles where they were then, a dent deeper than a leaf takes triangles out of
+	//theirs and the queries around where they are now wouldn't find them. Their triangles go into every leaf they
+	//overlap now as well, the leaves they left keep them, a triangle there only gets tested and rejected
+	//Which leaves a moved triangle is in is remembered, so a leaf's list is only searched the first time it comes up
+	void VerticesMoved(const std::vector<int>& verts)
+	{
+		MarkExact(verts);
+		const Mesh& mesh = model.meshes[0];
+		if (vertexTriStart.size() != mesh.vertices.size() + 1 || adjacentIndexCount != mesh.indices.size())
+			BuildVertexTriangles();
+		movedTris.clear();
+		for (int vert : verts)
+			movedTris.insert(movedTris.end(), vertexTris.begin() + vertexTriStart[vert], vertexTris.begin() + vertexTriStart[vert + 1]);
+		std::sort(movedTris.begin(), movedTris.end());
+		movedTris.erase(std::unique(movedTris.begin(), movedTris.end()), movedTris.end());
+		for (int t : movedTris)
+		{
+			Triangle tri(mesh.indices[3 * t], mesh.indices[3 * t + 1], mesh.indices[3 * t + 2]);
+			glm::vec3 corners[3];
+			TriangleCorners(tri, corners);
+			glm::vec3 boxMin, boxMax;
+			TriangleLeafBox(corners, boxMin, boxMax);
+			std::vector<OctreeNode*>& knownLeaves = movedTriLeaves[t];
+			ForEachLeafInBox(boxMin, boxMax, root, [&](OctreeNode* leaf)
+			{
+				if (std::find(knownLeaves.begin(), knownLeaves.end(), leaf) != knownLeaves.end())
+					return; //still in there
+				if (!triBoxOverlap(leaf->position, glm::vec3(leaf->size / 2), corners))
+					return;
+				knownLeaves.push_back(leaf);
+				if (leaf->tris == nullptr)
+					leaf->tris = new std::vector<Triangle>();
+				for (const Triangle& stored : *leaf->tris)
+				{
+					if (stored.index0 == tri.index0 && stored.index1 == tri.index1 && stored.index2 == tri.index2)
+						return; //filled in when the tree was built
+				}
+				leaf->tris->push_back(tri);
+				if (leaf->mirror != nullptr && !leaf->mirror->Append(corners))
+					PackLeaf(leaf);
+			});
+		}
+	}
+
+	//Position of a corner of the leaf's tri-th triangle, vertex is the corner's index in the mesh
+	glm::vec3 LeafCorner(const OctreeNode* leaf, int tri, int corner, int vertex) const
+	{
+		if (leaf->mirror == nullptr || exactVerts[vertex])
+			return model.meshes[0].vertices[vertex].Position;
+		return leaf->mirror->Corner(tri, corner);
+	}
+
+	//Corners of the leaf's tri-th triangle, what the ray checks test against
+	void LeafTriangle(const OctreeNode* leaf, int tri, glm::vec3 corners[3]) const
+	{
+		const Triangle& stored = (*leaf->tris)[tri];
+		corners[0] = LeafCorner(leaf, tri, 0, stored.index0);
+		corners[1] = LeafCorner(leaf, tri, 1, stored.index1);
+		corners[2] = LeafCorner(leaf, tri, 2, stored.index2);
+	}
 	void DestroyTree()
 	{
 		DestroyTree(root);
 	}
 
+	//Keep the leaves in step with a mesh that gets triangles split or added (see meshRefinement.h), without rebuilding
+	//The leaves stay where they are, new triangles go into the existing ones
+	//Takes tri (matched by its indices) out of every leaf, call it before the vertices of tri change
+	void RemoveTriangle(const Triangle& tri)
+	{
+		glm::vec3 corners[3];
+		TriangleCorners(tri, corners);
+		glm::vec3 boxMin, boxMax;
+		TriangleLeafBox(corners, boxMin, boxMax);
+		ForEachLeafInBox(boxMin, boxMax, root, [&](OctreeNode* leaf)
+		{
+			if (leaf->tris == nullptr)
+				return;
+			//the mirror's entries go along with the triangles
+			size_t kept = 0;
+			for (size_t i = 0; i < leaf->tris->size(); i++)
+			{
+				const Triangle& stored = (*leaf->tris)[i];
+				if (stored.index0 == tri.index0 && stored.index1 == tri.index1 && stored.index2 == tri.index2)
+					continue;
+				(*leaf->tris)[kept] = stored;
+				if (leaf->mirror != nullptr)
+					leaf->mirror->tris[kept] = leaf->mirror->tris[i];
+				kept++;
+			}
+			leaf->tris->resize(kept);
+			if (leaf->mirror != nullptr)
+			{
+				leaf->mirror->tris.resize(kept);
+				leaf->mirror->vertsStale = true;
+			}
+		});
+	}
+	//Puts tri into every leaf it overlaps, same test as building the tree
+	void AddTriangle(Triangle tri)
+	{
+		if (!leafMirrors.empty())
+			exactVerts.resize(model.meshes[0].vertices.size(), 0); //new vertices start out quantised like the rest
+		glm::vec3 corners[3];
+		TriangleCorners(tri, corners);
+		glm::vec3 boxMin, boxMax;
+		TriangleLeafBox(corners, boxMin, boxMax);
+		ForEachLeafInBox(boxMin, boxMax, root, [&](OctreeNode* leaf)
+		{
+			if (!triBoxOverlap(leaf->position, glm::vec3(leaf->size / 2), corners))
+				return;
+			if (leaf->tris == nullptr)
+				leaf->tris = new std::vector<Triangle>();
+			leaf->tris->push_back(tri);
+			if (leaf->mirror != nullptr && !leaf->mirror->Append(corners))
+				PackLeaf(leaf); //a corner outside the box the leaf was packed in, the box grows to take it
+		});
+	}
+
 	inline int calcNodeIndexX(OctreeNode* node)
 	{
 		return roundf((node->position.x + 3.5f * node->size - root->position.x) / node->size);
@@ -311,6 +598,199 @@ public:
 	int depth; //initial depth
 	OctreeNode* arrayRepresentation[8][8][8];
 private:
+	std::vector<unsigned int> vertexQueryStamp; //per vertex, the last query that visited it
+	unsigned int queryStamp = 0;
+	std::vector<LeafMirror> leafMirrors; //one per leaf once BuildCollisionMirror ran, the leaves point into it
+	//triangles (by their first index / 3) around every vertex, vertex v's are [vertexTriStart[v], vertexTriStart[v + 1])
+	std::vector<int> vertexTriStart, vertexTris, movedTris;
+	size_t adjacentIndexCount = 0; //mesh index count vertexTris was built for, refinement changes it
+	std::unordered_map<int, std::vector<OctreeNode*>> movedTriLeaves; //leaves the moved triangles are known to be in
+	std::vector<unsigned char> exactVerts; //per vertex, set once it moved and the mirror's copy is out of date
+
+	void BuildVertexTriangles()
+	{
+		const Mesh& mesh = model.meshes[0];
+		movedTriLeaves.clear(); //keyed by position in the index list, which refinement changes
+		vertexTriStart.assign(mesh.vertices.size() + 1, 0);
+		for (unsigned int index : mesh.indices)
+			vertexTriStart[index + 1]++;
+		for (size_t v = 0; v < mesh.vertices.size(); v++)
+			vertexTriStart[v + 1] += vertexTriStart[v];
+		vertexTris.resize(mesh.indices.size());
+		std::vector<int> filled(vertexTriStart.begin(), vertexTriStart.end() - 1);
+		for (size_t i = 0; i < mesh.indices.size(); i++)
+			vertexTris[filled[mesh.indices[i]]++] = (int)(i / 3);
+		adjacentIndexCount = mesh.indices.size();
+	}
+
+	void PackLeaf(OctreeNode* leaf)
+	{
+		std::vector<glm::vec3> corners;
+		if (leaf->tris != nullptr)
+		{
+			corners.resize(leaf->tris->size() * 3);
+			for (size_t t = 0; t < leaf->tris->size(); t++)
+				TriangleCorners((*leaf->tris)[t], &corners[3 * t]);
+		}
+		leaf->mirror->Pack(corners);
+		PackLeafVerts(leaf);
+	}
+
+	void PackLeafVerts(OctreeNode* leaf)
+	{
+		std::vector<int> indices;
+		if (leaf->tris != nullptr)
+		{
+			indices.reserve(leaf->tris->size() * 3);
+			for (const Triangle& tri : *leaf->tris)
+			{
+				indices.push_back(tri.index0);
+				indices.push_back(tri.index1);
+				indices.push_back(tri.index2);
+			}
+		}
+		std::sort(indices.begin(), indices.end());
+		indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+		std::vector<glm::vec3> positions(indices.size());
+		for (size_t v = 0; v < indices.size(); v++)
+			positions[v] = model.meshes[0].vertices[indices[v]].Position;
+		leaf->mirror->PackVerts(indices, positions);
+	}
+
+	void CollectStats(const OctreeNode* node, int level, OctreeStats& stats, double& squaredTris, double& volumeWeightedTris) const
+	{
+		if (stats.nodesPerLevel.size() <= level)
+			stats.nodesPerLevel.push_back(0);
+		stats.nodesPerLevel[level]++;
+		stats.memoryBytes += sizeof(OctreeNode);
+
+		if (node->XpYpZp == nullptr)
+		{
+			int tris = node->tris != nullptr ? (int)node->tris->size() : 0;
+			if (node->tris != nullptr)
+				stats.memoryBytes += sizeof(std::vector<Triangle>) + node->tris->capacity() * sizeof(Triangle);
+			if (node->mirror != nullptr)
+				stats.memoryBytes += node->mirror->Bytes();
+			stats.leafCount++;
+			if (tris == 0)
+				stats.emptyLeafCount++;
+			stats.storedTriangles += tris;
+			stats.maxTrisPerLeaf = max(stats.maxTrisPerLeaf, tris);
+			squaredTris += (double)tris * tris;
+			volumeWeightedTris += (double)node->size * node->size * node->size * tris;
+
+			int bucket = 0;
+			while ((1 << bucket) <= tris)
+				bucket++;
+			if (stats.trisPerLeafHistogram.size() <= bucket)
+				stats.trisPerLeafHistogram.resize(bucket + 1, 0);
+			stats.trisPerLeafHistogram[bucket]++;
+			return;
+		}
+
+		const OctreeNode* children[8] = { node->XpYpZp, node->XpYpZn, node->XpYnZp, node->XpYnZn,
+			node->XnYpZp, node->XnYpZn, node->XnYnZp, node->XnYnZn };
+		for (const OctreeNode* child : children)
+			CollectStats(child, level + 1, stats, squaredTris, volumeWeightedTris);
+	}
+
+	//Does the sphere touch the node's cube? (distance from the center to the closest point of the cube)
+	bool SphereOverlapsNode(glm::vec3 center, float radius, OctreeNode* node)
+	{
+		float halfSize = node->size / 2;
+		glm::vec3 closest = glm::clamp(center, node->position - glm::vec3(halfSize), node->position + glm::vec3(halfSize));
+		glm::vec3 offset = center - closest;
+		return glm::dot(offset, offset) <= radius * radius;
+	}
+
+	bool BoxOverlapsNode(glm::vec3 boxMin, glm::vec3 boxMax, OctreeNode* node)
+	{
+		float halfSize = node->size / 2;
+		glm::vec3 nodeMin = node->position - glm::vec3(halfSize);
+		glm::vec3 nodeMax = node->position + glm::vec3(halfSize);
+		return boxMin.x <= nodeMax.x && boxMax.x >= nodeMin.x &&
+			boxMin.y <= nodeMax.y && boxMax.y >= nodeMin.y &&
+			boxMin.z <= nodeMax.z && boxMax.z >= nodeMin.z;
+	}
+
+	template<typename LeafVisitor>
+	void QueryBox(glm::vec3 boxMin, glm::vec3 boxMax, OctreeNode* node, LeafVisitor& visitor)
+	{
+		if (!BoxOverlapsNode(boxMin, boxMax, node))
+			return;
+		if (node->XpYpZp == nullptr)
+		{
+			if (node->tris != nullptr && node->tris->size() > 0)
+				visitor(node);
+			return;
+		}
+		QueryBox(boxMin, boxMax, node->XpYpZp, visitor);
+		QueryBox(boxMin, boxMax, node->XpYpZn, visitor);
+		QueryBox(boxMin, boxMax, node->XpYnZp, visitor);
+		QueryBox(boxMin, boxMax, node->XpYnZn, visitor);
+		QueryBox(boxMin, boxMax, node->XnYpZp, visitor);
+		QueryBox(boxMin, boxMax, node->XnYpZn, visitor);
+		QueryBox(boxMin, boxMax, node->XnYnZp, visitor);
+		QueryBox(boxMin, boxMax, node->XnYnZn, visitor);
+	}
+
+	void TriangleCorners(const Triangle& tri, glm::vec3 corners[3]) const
+	{
+		corners[0] = model.meshes[0].vertices[tri.index0].Position;
+		corners[1] = model.meshes[0].vertices[tri.index1].Position;
+		corners[2] = model.meshes[0].vertices[tri.index2].Position;
+	}
+
+	//Bounding box of the triangle, padded a little: triBoxOverlap lets triangles a rounding error outside a leaf in
+	void TriangleLeafBox(const glm::vec3 corners[3], glm::vec3& boxMin, glm::vec3& boxMax) const
+	{
+		glm::vec3 padding(size * 1e-5f);
+		boxMin = glm::min(glm::min(corners[0], corners[1]), corners[2]) - padding;
+		boxMax = glm::max(glm::max(corners[0], corners[1]), corners[2]) + padding;
+	}
+
+	//Like QueryBox, but empty leaves are visited as well
+	template<typename LeafVisitor>
+	void ForEachLeafInBox(glm::vec3 boxMin, glm::vec3 boxMax, OctreeNode* node, const LeafVisitor& visitor)
+	{
+		if (!BoxOverlapsNode(boxMin, boxMax, node))
+			return;
+		if (node->XpYpZp == nullptr)
+		{
+			visitor(node);
+			return;
+		}
+		ForEachLeafInBox(boxMin, boxMax, node->XpYpZp, visitor);
+		ForEachLeafInBox(boxMin, boxMax, node->XpYpZn, visitor);
+		ForEachLeafInBox(boxMin, boxMax, node->XpYnZp, visitor);
+		ForEachLeafInBox(boxMin, boxMax, node->XpYnZn, visitor);
+		ForEachLeafInBox(boxMin, boxMax, node->XnYpZp, visitor);
+		ForEachLeafInBox(boxMin, boxMax, node->XnYpZn, visitor);
+		ForEachLeafInBox(boxMin, boxMax, node->XnYnZp, visitor);
+		ForEachLeafInBox(boxMin, boxMax, node->XnYnZn, visitor);
+	}
+
+	template<typename LeafVisitor>
+	void QuerySphereLeaves(glm::vec3 center, float radius, OctreeNode* node, LeafVisitor& visitor)
+	{
+		if (!SphereOverlapsNode(center, radius, node))
+			return; //nothing below this node can be in reach
+		if (node->XpYpZp == nullptr)
+		{
+			if (node->tris != nullptr && node->tris->size() > 0)
+				visitor(node);
+			return;
+		}
+		QuerySphereLeaves(center, radius, node->XpYpZp, visitor);
+		QuerySphereLeaves(center, radius, node->XpYpZn, visitor);
+		QuerySphereLeaves(center, radius, node->XpYnZp, visitor);
+		QuerySphereLeaves(center, radius, node->XpYnZn, visitor);
+		QuerySphereLeaves(center, radius, node->XnYpZp, visitor);
+		QuerySphereLeaves(center, radius, node->XnYpZn, visitor);
+		QuerySphereLeaves(center, radius, node->XnYnZp, visitor);
+		QuerySphereLeaves(center, radius, node->XnYnZn, visitor);
+	}
+
 	void DestroyTree(OctreeNode* leaf)
 	{
 		if (leaf->XpYpZp != nullptr) //checking the first child is enough, since all will exist, or none will exist
@@ -400,7 +880,6 @@ private:
 			int nodeY = roundf(nodeIndexY);
 			int nodeZ = roundf(nodeIndexZ);
 			arrayRepresentation[nodeX][nodeY][nodeZ] = node;
-			std::cout << "leef" <<  nodeX << nodeY << nodeZ <<"\n";
 		}
 
 	}
@@ -419,11 +898,9 @@ private:
 				{
 					Vertex vert;
 					vert.Position = pos;
-					std::cout << "pushing back vertex... ";
 					node->vertices->push_back(vert);
-					std::cout << "done!\n";
 				}
-				std::cout << "pushed back data of " << dataArray.size() << " verts into node sized " << node->size << "\n";
+				LOG_TRACE("pushed back data of " << dataArray.size() << " verts into node sized " << node->size);
 
 			}
 		}
@@ -550,37 +1027,48 @@ private:
 	}*/
 	void InsertTriangles(std::vector<Triangle> dataArray, OctreeNode* node)
 	{
-		if (node->XpYpZp == nullptr)
+		//every leaf tests the triangles on its own, so the leaves are filled in parallel
+		std::vector<OctreeNode*> leaves;
+		CollectLeaves(node, leaves);
+		Jobs().ParallelFor("octree build", 0, (int)leaves.size(), 1, [&](int i)
 		{
-			//onda je list, odjebi i zavrsi
+			InsertTrianglesIntoLeaf(dataArray, leaves[i]);
+		});
+	}
+
+	void InsertTrianglesIntoLeaf(const std::vector<Triangle>& dataArray, OctreeNode* node)
+	{
+		//onda je list, odjebi i zavrsi
 
-			node->tris = new std::vector<Triangle>();
-			for (int i = 0; i < dataArray.size(); i++)
+		node->tris = new std::vector<Triangle>();
+		for (int i = 0; i < dataArray.size(); i++)
+		{
+			glm::vec3 triangleVerts[3] = { model.meshes[0].vertices[dataArray[i].index0].Position,
+				model.meshes[0].vertices[dataArray[i].index1].Position, 
+				model.meshes[0].vertices[dataArray[i].index2].Position };
+			if (triBoxOverlap(node->position, glm::vec3(node->size / 2, node->size / 2, node->size / 2), triangleVerts)) //(model, node->size, node->position, dataArray[i]))
 			{
-				glm::vec3 triangleVerts[3] = { model.meshes[0].vertices[dataArray[i].index0].Position,
-					model.meshes[0].vertices[dataArray[i].index1].Position, 
-					model.meshes[0].vertices[dataArray[i].index2].Position };
-				if (triBoxOverlap(node->position, glm::vec3(node->size / 2, node->size / 2, node->size / 2), triangleVerts)) //(model, node->size, node->position, dataArray[i]))
-				{
-					dataArray[i].positions[0] = model.meshes[0].vertices[dataArray[i].index0].Position;
-					dataArray[i].positions[1] = model.meshes[0].vertices[dataArray[i].index1].Position;
-					dataArray[i].positions[2] = model.meshes[0].vertices[dataArray[i].index2].Position;
-					node->tris->push_back(dataArray[i]);
-					//std::cout << "pushed triangle into addr: " << node << "\n";
-				}
+				node->tris->push_back(dataArray[i]);
+				//std::cout << "pushed triangle into addr: " << node << "\n";
 			}
 		}
-		else
+	}
+
+	void CollectLeaves(OctreeNode* node, std::vector<OctreeNode*>& leaves)
+	{
+		if (node->XpYpZp == nullptr)
 		{
-			InsertTriangles(dataArray, node->XpYpZp);
-			InsertTriangles(dataArray, node->XpYpZn);
-			InsertTriangles(dataArray, node->XpYnZp);
-			InsertTriangles(dataArray, node->XpYnZn);
-			InsertTriangles(dataArray, node->XnYpZp);
-			InsertTriangles(dataArray, node->XnYpZn);
-			InsertTriangles(dataArray, node->XnYnZp);
-			InsertTriangles(dataArray, node->XnYnZn);
+			leaves.push_back(node);
+			return;
 		}
+		CollectLeaves(node->XpYpZp, leaves);
+		CollectLeaves(node->XpYpZn, leaves);
+		CollectLeaves(node->XpYnZp, leaves);
+		CollectLeaves(node->XpYnZn, leaves);
+		CollectLeaves(node->XnYpZp, leaves);
+		CollectLeaves(node->XnYpZn, leaves);
+		CollectLeaves(node->XnYnZp, leaves);
+		CollectLeaves(node->XnYnZn, leaves);
 	}
 
 	OctreeNode* FindFalloffCenterNode(glm::vec3 hitPoint, OctreeNode* node, float falloff)
@@ -591,21 +1079,22 @@ private:
 			return node;
 		}
 		else if (vecUtil::isXpYpZp(hitPoint, node->position)) //condition not met, search further
-			FindFalloffCenterNode(hitPoint, node->XpYpZp, falloff);
+			return FindFalloffCenterNode(hitPoint, node->XpYpZp, falloff);
 		else if (vecUtil::isXpYpZn(hitPoint, node->position))
-			FindFalloffCenterNode(hitPoint, node->XpYpZn, falloff);
+			return FindFalloffCenterNode(hitPoint, node->XpYpZn, falloff);
 		else if (vecUtil::isXpYnZp(hitPoint, node->position))
-			FindFalloffCenterNode(hitPoint, node->XpYnZp, falloff);
+			return FindFalloffCenterNode(hitPoint, node->XpYnZp, falloff);
 		else if (vecUtil::isXpYnZn(hitPoint, node->position))
-			FindFalloffCenterNode(hitPoint, node->XpYnZn, falloff);
+			return FindFalloffCenterNode(hitPoint, node->XpYnZn, falloff);
 		else if (vecUtil::isXnYpZp(hitPoint, node->position))
-			FindFalloffCenterNode(hitPoint, node->XnYpZp, falloff);
+			return FindFalloffCenterNode(hitPoint, node->XnYpZp, falloff);
 		else if (vecUtil::isXnYpZn(hitPoint, node->position))
-			FindFalloffCenterNode(hitPoint, node->XnYpZn, falloff);
+			return FindFalloffCenterNode(hitPoint, node->XnYpZn, falloff);
 		else if (vecUtil::isXnYnZp(hitPoint, node->position))
-			FindFalloffCenterNode(hitPoint, node->XnYnZp, falloff);
+			return FindFalloffCenterNode(hitPoint, node->XnYnZp, falloff);
 		else if (vecUtil::isXnYnZn(hitPoint, node->position))
-			FindFalloffCenterNode(hitPoint, node->XnYnZn, falloff);
+			return FindFalloffCenterNode(hitPoint, node->XnYnZn, falloff);
+		return nullptr;
 	}
 
 
@@ -620,21 +1109,22 @@ private:
 			return node;
 		}
 		else if (vecUtil::isXpYpZp(data, node->position)) //not a leaf
-			FindOctant(data, node->XpYpZp);
+			return FindOctant(data, node->XpYpZp);
 		else if (vecUtil::isXpYpZn(data, node->position))
-			FindOctant(data, node->XpYpZn);
+			return FindOctant(data, node->XpYpZn);
 		else if (vecUtil::isXpYnZp(data, node->position))
-			FindOctant(data, node->XpYnZp);
+			return FindOctant(data, node->XpYnZp);
 		else if (vecUtil::isXpYnZn(data, node->position))
-			FindOctant(data, node->XpYnZn);
+			return FindOctant(data, node->XpYnZn);
 		else if (vecUtil::isXnYpZp(data, node->position))
-			FindOctant(data, node->XnYpZp);
+			return FindOctant(data, node->XnYpZp);
 		else if (vecUtil::isXnYpZn(data, node->position))
-			FindOctant(data, node->XnYpZn);
+			return FindOctant(data, node->XnYpZn);
 		else if (vecUtil::isXnYnZp(data, node->position))
-			FindOctant(data, node->XnYnZp);
+			return FindOctant(data, node->XnYnZp);
 		else if (vecUtil::isXnYnZn(data, node->position))
-			FindOctant(data, node->XnYnZn);
+			return FindOctant(data, node->XnYnZn);
+		return nullptr;
 	}
 
 	OctreeNode* Search(glm::vec3 data, OctreeNode * leaf)
@@ -0,0 +1,67 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+//-------------------------------------------------------------------------------------
+// Lock free triple buffer, for handing data from one producer thread to one consumer.
+// The producer always has a back buffer to write into, the consumer always holds a
+// front buffer to read from, and the middle one is swapped between them atomically,
+// so neither side ever waits on the other. The consumer only sees the latest publish.
+//-------------------------------------------------------------------------------------
+
+#include<atomic>
+
+template<typename T>
+class TripleBuffer
+{
+public:
+	//All three buffers start out as copies of initial
+	TripleBuffer(const T& initial)
+	{
+		for (int i = 0; i < 3; i++)
+			buffers[i] = initial;
+	}
+
+	//Producer side, the buffer to fill before publishing
+	T& Back()
+	{
+		return buffers[back];
+	}
+	//Index of the back buffer (0 to 2), lets the producer keep its own per buffer bookkeeping
+	int BackIndex() const
+	{
+		return back;
+	}
+
+	//Producer side, makes the back buffer the latest one and takes over the previous middle one
+	void Publish()
+	{
+		unsigned int previous = middle.exchange(back | freshBit, std::memory_order_acq_rel);
+		back = previous & indexMask;
+	}
+
+	//Consumer side, takes the latest published buffer, returns false if nothing new was published since the last call
+	bool Acquire()
+	{
+		if ((middle.load(std::memory_order_relaxed) & freshBit) == 0)
+			return false;
+		unsigned int previous = middle.exchange(front, std::memory_order_acq_rel);
+		front = previous & indexMask;
+		return true;
+	}
+
+	//Consumer side, the buffer taken by the last successful Acquire
+	const T& Front() const
+	{
+		return buffers[front];
+	}
+
+private:
+	static const unsigned int indexMask = 3;
+	static const unsigned int freshBit = 4; //set in middle when it holds a publish the consumer hasn't taken yet
+
+	T buffers[3];
+	std::atomic<unsigned int> middle{ 1 };
+	unsigned int back = 0;
+	unsigned int front = 2;
+};
+
+#endif
\ No newline at end of file
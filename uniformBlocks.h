@@ -0,0 +1,98 @@
+#ifndef UNIFORM_BLOCKS_H
+#define UNIFORM_BLOCKS_H
+//-------------------------------------------------------------------------------------
+// Uniform data shared by every program. Camera and light data live in uniform buffers
+// bound to fixed binding points, they are uploaded once (per frame for the camera, once
+// for the static lights) instead of being set on every shader. Shaders declare them as
+// std140 blocks named like in blockNames, and Shader binds them after linking.
+// The structs mirror the std140 layout, keep them in sync with the GLSL side.
+//-------------------------------------------------------------------------------------
+
+#include<GLAD\glad.h>
+#include<glm\glm.hpp>
+
+namespace UniformBlocks
+{
+	enum Binding
+	{
+		Camera = 0,
+		Lights = 1,
+		Count
+	};
+
+	//Block names as declared in the shaders, indexed by binding
+	static const char* const blockNames[Count] = { "Camera", "Lights" };
+
+	const int PointLightCount = 4; //NR_PLIGHTS in the shaders
+}
+
+//layout (std140) uniform Camera { mat4 view; mat4 projection; vec3 viewPos; };
+struct CameraBlock
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec3 viewPos;
+	float padding;
+};
+
+//std140 packs a float into the fourth component after a vec3, structs are padded to 16 bytes
+struct PointLightData
+{
+	glm::vec3 position;
+	float constant;
+	glm::vec3 ambient;
+	float linear;
+	glm::vec3 diffuse;
+	float quadratic;
+	glm::vec3 specular;
+	float padding;
+};
+
+struct DirLightData
+{
+	glm::vec3 direction;
+	float padding0;
+	glm::vec3 ambient;
+	float padding1;
+	glm::vec3 diffuse;
+	float padding2;
+	glm::vec3 specular;
+	float padding3;
+};
+
+//layout (std140) uniform Lights { PointLight pointLights[NR_PLIGHTS]; DirLight dirLight; };
+struct LightsBlock
+{
+	PointLightData pointLights[UniformBlocks::PointLightCount];
+	DirLightData dirLight;
+};
+
+static_assert(sizeof(CameraBlock) == 144, "CameraBlock has to match the std140 layout");
+static_assert(sizeof(PointLightData) == 64 && sizeof(DirLightData) == 64, "light structs have to match the std140 layout");
+
+//One uniform buffer holding a block, bound to its binding point for all programs
+template<typename Block>
+class UniformBuffer
+{
+public:
+	UniformBuffer(UniformBlocks::Binding binding)
+	{
+		glGenBuffers(1, &UBO);
+		glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		glBindBufferBase(GL_UNIFORM_BUFFER, binding, UBO);
+	}
+
+	void Update(const Block& block)
+	{
+		glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+private:
+	unsigned int UBO;
+};
+
+#endif